@@ -0,0 +1,117 @@
+#include <iostream>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include "augmented_avl.h"
+#include "test_check.h"
+using namespace std;
+
+// Concatenates values in key order, catches combine called out of order.
+struct ConcatAggregate
+{
+  typedef string type;
+  static type identity() { return ""; }
+  static type lift(const int&, const string& value) { return value; }
+  static type combine(const type& a, const type& b) { return a + b; }
+};
+
+void testRangeSums()
+{
+  AugmentedAVLTree<int, long, SumAggregate<long> > sums;
+  AugmentedAVLTree<int, long, MinAggregate<long> > mins;
+  AugmentedAVLTree<int, long, MaxAggregate<long> > maxes;
+  map<int, long> m;
+  srand(104);
+  for(int i = 0; i < 5000; i++) {
+    int k = rand() % 1000;
+    long v = rand() % 10000 - 5000;
+    if(rand() % 4 == 0) {
+      sums.remove(k);
+      mins.remove(k);
+      maxes.remove(k);
+      m.erase(k);
+    }
+    else {
+      sums.insert(make_pair(k, v));
+      mins.insert(make_pair(k, v));
+      maxes.insert(make_pair(k, v));
+      m[k] = v;
+    }
+  }
+
+  bool sumOk = true, minOk = true, maxOk = true;
+  for(int q = 0; q < 500; q++) {
+    int lo = rand() % 1100 - 50, hi = lo + rand() % 300;
+    long sum = 0, mn = numeric_limits<long>::max(), mx = numeric_limits<long>::lowest();
+    for(map<int, long>::iterator it = m.lower_bound(lo); it != m.end() && it->first <= hi; ++it) {
+      sum += it->second;
+      mn = min(mn, it->second);
+      mx = max(mx, it->second);
+    }
+    sumOk = sumOk && sums.aggregate(lo, hi) == sum;
+    minOk = minOk && mins.aggregate(lo, hi) == mn;
+    maxOk = maxOk && maxes.aggregate(lo, hi) == mx;
+  }
+  check("Range sum", sumOk);
+  check("Range min", minOk);
+  check("Range max", maxOk);
+  check("Balanced", sums.isBalanced());
+}
+
+void testOrder()
+{
+  AugmentedAVLTree<int, string, ConcatAggregate> t;
+  const char* letters = "qwertyuiopasdfghjklzxcvbnm";
+  for(int i = 0; i < 26; i++) t.insert(make_pair(letters[i] - 'a', string(1, letters[i])));
+  check("Whole tree in key order", t.aggregate() == "abcdefghijklmnopqrstuvwxyz");
+  check("Sub range in key order", t.aggregate(3, 7) == "defgh");
+  t.remove(4);
+  t.insert(make_pair(5, string("F")));
+  check("After remove and overwrite", t.aggregate(2, 6) == "cdFg");
+  check("Empty range", t.aggregate(30, 40) == "" && t.aggregate(8, 7) == "");
+}
+
+long addLong(long a, long b)
+{
+  return a + b;
+}
+
+// upsert goes through updatePath, so the sums follow combined values.
+void testUpsert()
+{
+  AugmentedAVLTree<int, long, SumAggregate<long> > counts;
+  for(int i = 0; i < 1000; i++) counts.upsert(i % 10, 1L, addLong);
+  check("Upsert sums", counts.aggregate() == 1000 && counts.aggregate(3, 4) == 200);
+}
+
+long doubled(const int&, long value)
+{
+  return 2 * value;
+}
+
+// setValue and the parallel passes leave no stale sums behind.
+void testValueWrites()
+{
+  AugmentedAVLTree<int, long, SumAggregate<long> > t;
+  for(int i = 0; i < 5000; i++) t.insert(make_pair(i, 1L));
+  bool found = t.setValue(10, 101L);
+  bool missing = t.setValue(9000, 5L);
+  check("setValue repairs the sums", found && !missing && t.aggregate() == 5100 && t.aggregate(0, 10) == 111);
+
+  t.parallelTransformValues(doubled, 4);
+  check("parallelTransformValues recomputes", t.aggregate() == 10200 && t.aggregate(10, 10) == 202);
+
+  t.parallelForEach(100, 199, [](const int&, long& value) { value = 0; }, 4);
+  t.parallelForEach([](const int& key, long& value) { if(key >= 4000) value += 1; }, 4);
+  check("parallelForEach recomputes", t.aggregate() == 10200 - 200 + 1000 &&
+        t.aggregate(100, 199) == 0 && t.aggregate(50, 150) == 100 && t.aggregate(3999, 4000) == 5);
+}
+
+int main()
+{
+  testRangeSums();
+  testOrder();
+  testUpsert();
+  testValueWrites();
+  return failures;
+}
@@ -0,0 +1,379 @@
+#ifndef AUGMENTED_AVL_H
+#define AUGMENTED_AVL_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <limits>
+#include <algorithm>
+#include "avlbst.h"
+
+/*
+ * Aggregate policies. A policy is a monoid over the items of the tree:
+ *
+ *   typedef ... type;                        the aggregate
+ *   static type identity();                  the empty aggregate
+ *   static type lift(const Key&, const Value&);  aggregate of one item
+ *   static type combine(const type&, const type&);  must be associative
+ *
+ * combine is always called with the left operand before the right one in
+ * key order, so policies do not need to be commutative.
+ */
+
+/**
+* Sum of the values.
+*/
+template <typename Value>
+struct SumAggregate
+{
+    typedef Value type;
+    static type identity() { return Value(); }
+    template <typename Key>
+    static type lift(const Key&, const Value& value) { return value; }
+    static type combine(const type& a, const type& b) { return a + b; }
+};
+
+/**
+* Minimum of the values. Value must be a numeric type.
+*/
+template <typename Value>
+struct MinAggregate
+{
+    typedef Value type;
+    static type identity() { return std::numeric_limits<Value>::max(); }
+    template <typename Key>
+    static type lift(const Key&, const Value& value) { return value; }
+    static type combine(const type& a, const type& b) { return std::min(a, b); }
+};
+
+/**
+* Maximum of the values. Value must be a numeric type.
+*/
+template <typename Value>
+struct MaxAggregate
+{
+    typedef Value type;
+    static type identity() { return std::numeric_limits<Value>::lowest(); }
+    template <typename Key>
+    static type lift(const Key&, const Value& value) { return value; }
+    static type combine(const type& a, const type& b) { return std::max(a, b); }
+};
+
+/**
+* Number of items, so the root's aggregate is the size of the tree.
+*/
+struct CountAggregate
+{
+    typedef size_t type;
+    static type identity() { return 0; }
+    template <typename Key, typename Value>
+    static type lift(const Key&, const Value&) { return 1; }
+    static type combine(const type& a, const type& b) { return a + b; }
+};
+
+/**
+* An AVLNode that also stores the aggregate of its whole subtree.
+*/
+template <typename Key, typename Value, typename Aggregate>
+class AugmentedAVLNode : public AVLNode<Key, Value>
+{
+public:
+    AugmentedAVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+    virtual ~AugmentedAVLNode();
+
+    const typename Aggregate::type& getAggregate() const;
+    void setAggregate(const typename Aggregate::type& aggregate);
+
+protected:
+    typename Aggregate::type aggregate_;
+};
+
+/*
+  ----------------------------------------------------
+  Begin implementations for the AugmentedAVLNode class.
+  ----------------------------------------------------
+*/
+
+/**
+* A new node is a leaf, so its aggregate is that of its own item.
+*/
+template<typename Key, typename Value, typename Aggregate>
+AugmentedAVLNode<Key, Value, Aggregate>::AugmentedAVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent) :
+    AVLNode<Key, Value>(key, value, parent), aggregate_(Aggregate::lift(key, value))
+{
+
+}
+
+template<typename Key, typename Value, typename Aggregate>
+AugmentedAVLNode<Key, Value, Aggregate>::~AugmentedAVLNode()
+{
+
+}
+
+template<typename Key, typename Value, typename Aggregate>
+const typename Aggregate::type& AugmentedAVLNode<Key, Value, Aggregate>::getAggregate() const
+{
+    return aggregate_;
+}
+
+template<typename Key, typename Value, typename Aggregate>
+void AugmentedAVLNode<Key, Value, Aggregate>::setAggregate(const typename Aggregate::type& aggregate)
+{
+    aggregate_ = aggregate;
+}
+
+/*
+  --------------------------------------------------
+  End implementations for the AugmentedAVLNode class.
+  --------------------------------------------------
+*/
+
+/**
+* An AVL tree that keeps a per-subtree aggregate (sum, min, max, ...) up to
+* date through inserts, removes and rotations, so the aggregate over any
+* key range is answered in O(log n). The bookkeeping lives here, so a plain
+* AVLTree pays neither the extra field nor the upward walk.
+*
+* Values must be changed through insert, upsert or setValue, which repair
+* the aggregates above the item. A write through operator[], an iterator
+* or getOrInsert's reference bypasses them. The parallel passes recompute
+* every aggregate they may have touched once they finish.
+*/
+template <class Key, class Value, class Aggregate>
+class AugmentedAVLTree : public AVLTree<Key, Value>
+{
+public:
+    typedef typename Aggregate::type aggregate_type;
+
+    // Aggregate of every item with lo <= key <= hi.
+    aggregate_type aggregate(const Key& lo, const Key& hi) const;
+    // Aggregate of the whole tree.
+    aggregate_type aggregate() const;
+
+    // Overwrites key's value and recomputes the aggregates up to the root,
+    // O(log n). Returns false, changing nothing, if key is absent.
+    bool setValue(const Key& key, const Value& value);
+
+    // The parallel passes of AVLTree, followed by a recompute of the
+    // subtrees they visited: O(n), or O(k + log n) for the ranged one.
+    template<class Fn>
+    void parallelForEach(Fn fn, unsigned threads);
+    template<class Fn>
+    void parallelForEach(const Key& lo, const Key& hi, Fn fn, unsigned threads);
+    template<class Fn>
+    void parallelTransformValues(Fn fn, unsigned threads);
+
+protected:
+    typedef AugmentedAVLNode<Key, Value, Aggregate> AggNode;
+
+    virtual AVLNode<Key, Value>* createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+    virtual void updateAfterRotate(AVLNode<Key, Value>* lower, AVLNode<Key, Value>* upper);
+    virtual void updatePath(AVLNode<Key, Value>* node);
+    virtual void updateNode(AVLNode<Key, Value>* node);
+
+    // Add helper functions here
+    static aggregate_type subtree(Node<Key, Value>* node); // identity for an empty subtree
+    static aggregate_type single(Node<Key, Value>* node);
+    static void recompute(Node<Key, Value>* node);
+    static void recomputeRange(Node<Key, Value>* node, const Key* lo, const Key* hi); // nullptr is unbounded
+};
+
+/*
+  ----------------------------------------------------
+  Begin implementations for the AugmentedAVLTree class.
+  ----------------------------------------------------
+*/
+
+template<class Key, class Value, class Aggregate>
+AVLNode<Key, Value>* AugmentedAVLTree<Key, Value, Aggregate>::createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent)
+{
+    return new AggNode(key, value, parent);
+}
+
+/**
+* Only the two rotated nodes have new children. The lower one is fixed
+* first since the upper one now depends on it.
+*/
+template<class Key, class Value, class Aggregate>
+void AugmentedAVLTree<Key, Value, Aggregate>::updateAfterRotate(AVLNode<Key, Value>* lower, AVLNode<Key, Value>* upper)
+{
+    recompute(lower);
+    recompute(upper);
+}
+
+/**
+* Recomputes node and every ancestor, bottom up.
+*/
+template<class Key, class Value, class Aggregate>
+void AugmentedAVLTree<Key, Value, Aggregate>::updatePath(AVLNode<Key, Value>* node)
+{
+    Node<Key, Value>* current = node;
+    while(current != nullptr)
+    {
+        recompute(current);
+        current = current->getParent();
+    }
+}
+
+/**
+* Joins relink children bottom up, so only node itself needs redoing.
+*/
+template<class Key, class Value, class Aggregate>
+void AugmentedAVLTree<Key, Value, Aggregate>::updateNode(AVLNode<Key, Value>* node)
+{
+    recompute(node);
+}
+
+template<class Key, class Value, class Aggregate>
+typename AugmentedAVLTree<Key, Value, Aggregate>::aggregate_type
+AugmentedAVLTree<Key, Value, Aggregate>::subtree(Node<Key, Value>* node)
+{
+    if(node == nullptr)
+    {
+        return Aggregate::identity();
+    }
+    return static_cast<AggNode*>(node)->getAggregate();
+}
+
+template<class Key, class Value, class Aggregate>
+typename AugmentedAVLTree<Key, Value, Aggregate>::aggregate_type
+AugmentedAVLTree<Key, Value, Aggregate>::single(Node<Key, Value>* node)
+{
+    return Aggregate::lift(node->getKey(), node->getValue());
+}
+
+template<class Key, class Value, class Aggregate>
+void AugmentedAVLTree<Key, Value, Aggregate>::recompute(Node<Key, Value>* node)
+{
+    static_cast<AggNode*>(node)->setAggregate(
+        Aggregate::combine(Aggregate::combine(subtree(node->getLeft()), single(node)), subtree(node->getRight())));
+}
+
+template<class Key, class Value, class Aggregate>
+typename AugmentedAVLTree<Key, Value, Aggregate>::aggregate_type
+AugmentedAVLTree<Key, Value, Aggregate>::aggregate() const
+{
+    return subtree(this->root_);
+}
+
+template<class Key, class Value, class Aggregate>
+bool AugmentedAVLTree<Key, Value, Aggregate>::setValue(const Key& key, const Value& value)
+{
+    Node<Key, Value>* node = this->internalFind(key);
+    if(node == nullptr)
+    {
+        return false;
+    }
+    node->setValue(value);
+    this->updatePath(static_cast<AVLNode<Key, Value>*>(node));
+    return true;
+}
+
+template<class Key, class Value, class Aggregate>
+template<class Fn>
+void AugmentedAVLTree<Key, Value, Aggregate>::parallelForEach(Fn fn, unsigned threads)
+{
+    AVLTree<Key, Value>::parallelForEach(fn, threads);
+    recomputeRange(this->root_, nullptr, nullptr);
+}
+
+template<class Key, class Value, class Aggregate>
+template<class Fn>
+void AugmentedAVLTree<Key, Value, Aggregate>::parallelForEach(const Key& lo, const Key& hi, Fn fn, unsigned threads)
+{
+    AVLTree<Key, Value>::parallelForEach(lo, hi, fn, threads);
+    recomputeRange(this->root_, &lo, &hi);
+}
+
+template<class Key, class Value, class Aggregate>
+template<class Fn>
+void AugmentedAVLTree<Key, Value, Aggregate>::parallelTransformValues(Fn fn, unsigned threads)
+{
+    AVLTree<Key, Value>::parallelTransformValues(fn, threads);
+    recomputeRange(this->root_, nullptr, nullptr);
+}
+
+/**
+* Post-order over the nodes whose subtree reaches into [lo, hi]: the
+* items in the range and the two boundary paths above them.
+*/
+template<class Key, class Value, class Aggregate>
+void AugmentedAVLTree<Key, Value, Aggregate>::recomputeRange(Node<Key, Value>* node, const Key* lo, const Key* hi)
+{
+    if(node == nullptr)
+    {
+        return;
+    }
+    if(lo == nullptr || *lo < node->getKey())
+    {
+        recomputeRange(node->getLeft(), lo, hi);
+    }
+    if(hi == nullptr || node->getKey() < *hi)
+    {
+        recomputeRange(node->getRight(), lo, hi);
+    }
+    recompute(node);
+}
+
+/**
+* Descends to the first node inside [lo, hi], where the searches for lo
+* and hi split. From there one walk down the left side collects whole
+* right subtrees that are >= lo, and one walk down the right side
+* collects whole left subtrees that are <= hi. O(log n) overall.
+*/
+template<class Key, class Value, class Aggregate>
+typename AugmentedAVLTree<Key, Value, Aggregate>::aggregate_type
+AugmentedAVLTree<Key, Value, Aggregate>::aggregate(const Key& lo, const Key& hi) const
+{
+    Node<Key, Value>* split = this->root_;
+    while(split != nullptr && (split->getKey() < lo || hi < split->getKey()))
+    {
+        split = (split->getKey() < lo) ? split->getRight() : split->getLeft();
+    }
+    if(split == nullptr)
+    {
+        return Aggregate::identity();
+    }
+
+    // items >= lo in the left subtree, gathered right to left
+    aggregate_type leftPart = Aggregate::identity();
+    Node<Key, Value>* current = split->getLeft();
+    while(current != nullptr)
+    {
+        if(current->getKey() < lo)
+        {
+            current = current->getRight();
+        }
+        else
+        {
+            leftPart = Aggregate::combine(Aggregate::combine(single(current), subtree(current->getRight())), leftPart);
+            current = current->getLeft();
+        }
+    }
+
+    // items <= hi in the right subtree, gathered left to right
+    aggregate_type rightPart = Aggregate::identity();
+    current = split->getRight();
+    while(current != nullptr)
+    {
+        if(hi < current->getKey())
+        {
+            current = current->getLeft();
+        }
+        else
+        {
+            rightPart = Aggregate::combine(rightPart, Aggregate::combine(subtree(current->getLeft()), single(current)));
+            current = current->getRight();
+        }
+    }
+
+    return Aggregate::combine(Aggregate::combine(leftPart, single(split)), rightPart);
+}
+
+/*
+  --------------------------------------------------
+  End implementations for the AugmentedAVLTree class.
+  --------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,145 @@
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <string>
+#include "avl_cache.h"
+#include "test_check.h"
+using namespace std;
+
+// A clock the tests advance by hand.
+struct TestClock
+{
+  typedef chrono::milliseconds duration;
+  typedef duration::rep rep;
+  typedef duration::period period;
+  typedef chrono::time_point<TestClock> time_point;
+  static const bool is_steady = true;
+  static time_point now() { return time_point(duration(ticks)); }
+  static long ticks;
+};
+long TestClock::ticks = 0;
+
+typedef AVLCache<int, string, TestClock> Cache;
+
+void testLru()
+{
+  TestClock::ticks = 0;
+  Cache c(3, chrono::milliseconds(1000));
+  c.put(1, "a");
+  c.put(2, "b");
+  c.put(3, "c");
+  check("Get hit", c.get(1) != nullptr && *c.get(1) == "a");
+
+  c.put(4, "d"); // 2 is now the least recently used
+  check("Evicts least recently used", c.size() == 3 && c.get(2) == nullptr && c.get(1) != nullptr);
+
+  c.put(3, "C"); // overwrite marks 3 used, so 4 goes next
+  c.put(5, "e");
+  check("Overwrite refreshes", c.get(4) == nullptr && *c.get(3) == "C" && c.size() == 3);
+
+  string keys;
+  for(Cache::iterator it = c.begin(); it != c.end(); ++it) keys += to_string(it->first);
+  check("Iterates in key order", keys == "135");
+
+  c.remove(1);
+  c.remove(1);
+  check("Remove", !c.contains(1) && c.size() == 2);
+  c.clear();
+  check("Clear", c.empty() && c.begin() == c.end());
+
+  bool threw = false;
+  try {
+    Cache bad(0, chrono::milliseconds(1));
+  }
+  catch(std::invalid_argument&) {
+    threw = true;
+  }
+  check("Zero capacity throws", threw);
+}
+
+void testTtl()
+{
+  TestClock::ticks = 0;
+  Cache c(10, chrono::milliseconds(100));
+  c.put(1, "short", chrono::milliseconds(10));
+  c.put(2, "default");
+  TestClock::ticks = 50;
+  check("Lazy expiry on get", c.get(1) == nullptr && c.size() == 1 && c.get(2) != nullptr);
+
+  TestClock::ticks = 100;
+  check("Expiry is exclusive", !c.contains(2) && c.empty());
+
+  for(int i = 0; i < 10; i++) c.put(i, "x", chrono::milliseconds(i < 5 ? 10 : 1000));
+  TestClock::ticks = 200;
+  size_t dropped = 0;
+  for(int i = 0; i < 10; i++) dropped += c.purgeExpired(1);
+  check("Purge step finds every expired entry", dropped == 5 && c.size() == 5);
+
+  // puts alone reclaim expired entries, a couple of checks at a time
+  Cache d(100, chrono::milliseconds(1000));
+  for(int i = 0; i < 50; i++) d.put(i, "old", chrono::milliseconds(10));
+  TestClock::ticks = 300;
+  for(int i = 100; i < 160; i++) d.put(i, "new");
+  check("Puts purge expired entries", d.size() == 60);
+}
+
+void testBounded()
+{
+  TestClock::ticks = 0;
+  Cache c(100, chrono::milliseconds(50));
+  srand(34);
+  bool ok = true;
+  for(int i = 0; i < 100000 && ok; i++) {
+    TestClock::ticks++;
+    int k = rand() % 1000;
+    if(rand() % 4 == 0) c.get(k);
+    else c.put(k, "v", chrono::milliseconds(rand() % 100));
+    ok = c.size() <= c.capacity();
+  }
+  check("Never exceeds capacity", ok && c.isBalanced());
+
+  size_t n = 0;
+  for(Cache::iterator it = c.begin(); it != c.end(); ++it) n++;
+  check("Size matches tree", n == c.size());
+}
+
+// A value that counts its live copies, so the peak shows how many
+// entries the tree held at once.
+struct Tracked
+{
+  Tracked() { grow(); }
+  Tracked(const Tracked&) { grow(); }
+  ~Tracked() { live--; }
+  Tracked& operator=(const Tracked&) { return *this; }
+  static void grow() { if(++live > peak) peak = live; }
+  static int live;
+  static int peak;
+};
+int Tracked::live = 0;
+int Tracked::peak = 0;
+
+ostream& operator<<(ostream& out, const Tracked&)
+{
+  return out << "tracked";
+}
+
+void testEvictFirst()
+{
+  TestClock::ticks = 0;
+  AVLCache<int, Tracked, TestClock> c(4, chrono::milliseconds(1000));
+  Tracked v;
+  for(int i = 0; i < 4; i++) c.put(i, v);
+  Tracked::peak = Tracked::live;
+  for(int i = 4; i < 20; i++) c.put(i, v);
+  // the caller's copy plus a full cache; the new entry only after an eviction
+  check("Evicts before inserting a new key", Tracked::peak == 5 && c.size() == 4 && c.isBalanced());
+}
+
+int main()
+{
+  testLru();
+  testTtl();
+  testBounded();
+  testEvictFirst();
+  return failures;
+}
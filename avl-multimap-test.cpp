@@ -0,0 +1,141 @@
+#include <iostream>
+#include <cstdlib>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include "avl_multimap.h"
+#include "test_check.h"
+using namespace std;
+
+typedef AVLMultiMap<int, int> Multi;
+
+void testSmall()
+{
+  Multi m;
+  m.insert(make_pair(5, 1));
+  m.insert(make_pair(3, 2));
+  m.insert(make_pair(5, 3));
+  m.insert(make_pair(5, 4));
+  check("Size counts values", m.size() == 4);
+  check("Count of duplicate key", m.count(5) == 3 && m.count(3) == 1 && m.count(7) == 0);
+
+  pair<Multi::iterator, Multi::iterator> range = m.equalRange(5);
+  int expected = 1;
+  bool ordered = true;
+  int n = 0;
+  for(Multi::iterator it = range.first; it != range.second; ++it, n++) {
+    ordered = ordered && it->first == 5 && it->second == expected;
+    expected = (expected == 1) ? 3 : expected + 1;
+  }
+  check("Equal range keeps insertion order", ordered && n == 3);
+
+  range = m.equalRange(4);
+  check("Missing key gives empty range", range.first == m.end() && range.second == m.end());
+
+  (*m.find(3)).second = 20;
+  check("Values are writable", m.find(3)->second == 20);
+
+  m.remove(5);
+  check("Remove drops every value", m.size() == 1 && m.count(5) == 0 && m.begin()->first == 3);
+}
+
+void testManyDuplicates()
+{
+  // enough values under one key to span several chunks
+  AVLMultiMap<string, int> m;
+  for(int i = 0; i < 1000; i++) m.insert(make_pair(string("k"), i));
+  int expected = 0;
+  bool ok = true;
+  pair<AVLMultiMap<string, int>::iterator, AVLMultiMap<string, int>::iterator> range = m.equalRange("k");
+  for(AVLMultiMap<string, int>::iterator it = range.first; it != range.second; ++it) {
+    ok = ok && it->second == expected++;
+  }
+  check("Long chunk chain in order", ok && expected == 1000);
+}
+
+void testRandom()
+{
+  Multi m;
+  multimap<int, int> ref;
+  srand(32);
+  for(int i = 0; i < 20000; i++) {
+    int k = rand() % 500;
+    if(rand() % 10 == 0) {
+      m.remove(k);
+      ref.erase(k);
+    }
+    else {
+      m.insert(make_pair(k, i));
+      ref.insert(make_pair(k, i));
+    }
+  }
+  // std::multimap also keeps equal keys in insertion order
+  bool ok = m.size() == ref.size() && m.isBalanced();
+  multimap<int, int>::iterator r = ref.begin();
+  for(Multi::iterator it = m.begin(); ok && it != m.end(); ++it, ++r) {
+    ok = it->first == r->first && it->second == r->second;
+  }
+  check("Random ops match std::multimap", ok && r == ref.end());
+}
+
+// A value whose copy throws while armed.
+struct FragileValue
+{
+  static bool armed;
+  static int live;
+  FragileValue(int v_) : v(v_) { live++; }
+  FragileValue(const FragileValue& other) : v(other.v)
+  {
+    if(armed) throw runtime_error("copy failed");
+    live++;
+  }
+  ~FragileValue() { live--; }
+  int v;
+};
+
+bool FragileValue::armed = false;
+int FragileValue::live = 0;
+
+ostream& operator<<(ostream& out, const FragileValue& value)
+{
+  return out << value.v;
+}
+
+void testThrowingInsert()
+{
+  {
+    AVLMultiMap<int, FragileValue> m;
+    m.insert(make_pair(1, FragileValue(10))); // fills key 1's first chunk
+    m.insert(make_pair(3, FragileValue(30)));
+    m.insert(make_pair(3, FragileValue(31)));
+    int threw = 0;
+    for(int k = 1; k < 4; k++) { // a new chunk, a new key, room in the tail chunk
+      pair<const int, FragileValue> item(k, FragileValue(k));
+      FragileValue::armed = true;
+      try {
+        m.insert(item);
+      }
+      catch(runtime_error&) {
+        threw++;
+      }
+      FragileValue::armed = false;
+    }
+    int entries = 0;
+    for(AVLMultiMap<int, FragileValue>::iterator it = m.begin(); it != m.end(); ++it) entries++;
+    check("Throwing value copy leaves the map as it was",
+          threw == 3 && entries == 3 && m.size() == 3 && m.count(2) == 0 && m.isBalanced());
+    m.insert(make_pair(1, FragileValue(11)));
+    m.insert(make_pair(2, FragileValue(20)));
+    check("Map still takes values", m.count(1) == 2 && m.count(2) == 1 && m.size() == 5);
+  }
+  check("Only built values are destroyed", FragileValue::live == 0);
+}
+
+int main()
+{
+  testSmall();
+  testManyDuplicates();
+  testRandom();
+  testThrowingInsert();
+  return failures;
+}
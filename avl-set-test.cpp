@@ -0,0 +1,66 @@
+#include <iostream>
+#include <cstdlib>
+#include <set>
+#include <string>
+#include "avl_set.h"
+#include "avlbst.h"
+#include "test_check.h"
+using namespace std;
+
+void testSmall()
+{
+  AVLSet<string> s;
+  check("Insert new", s.insert("b") && s.insert("a") && s.insert("c"));
+  check("Insert duplicate", !s.insert("a") && s.size() == 3);
+  check("Contains", s.contains("b") && !s.contains("d"));
+  check("Find", *s.find("c") == "c" && s.find("d") == s.end());
+
+  string all;
+  for(AVLSet<string>::iterator it = s.begin(); it != s.end(); ++it) all += *it;
+  check("In order", all == "abc");
+
+  check("Remove", s.remove("b") && !s.remove("b") && s.size() == 2 && !s.contains("b"));
+  s.clear();
+  check("Clear", s.empty() && s.begin() == s.end());
+}
+
+void testRandom()
+{
+  AVLSet<int> s;
+  set<int> ref;
+  srand(33);
+  bool ok = true;
+  for(int i = 0; i < 50000 && ok; i++) {
+    int k = rand() % 2000;
+    if(rand() % 3 == 0) ok = s.remove(k) == (ref.erase(k) == 1);
+    else ok = s.insert(k) == ref.insert(k).second;
+  }
+  set<int>::iterator r = ref.begin();
+  for(AVLSet<int>::iterator it = s.begin(); ok && it != s.end(); ++it, ++r) ok = *it == *r;
+  check("Random ops match std::set", ok && r == ref.end() && s.size() == ref.size() && s.isBalanced());
+}
+
+void testFootprint()
+{
+  AVLSet<long> s;
+  CompactAVLTree<long, bool> m;
+  for(long i = 0; i < 1000; i++) {
+    s.insert(i);
+    m.insert(make_pair(i, true));
+  }
+  // both pools grow the same way, so the ratio is the slot size ratio
+  size_t setBytes = s.memoryUsage() - sizeof(s);
+  size_t mapBytes = m.memoryUsage() - sizeof(m);
+  cout << "bytes per node: AVLSet<long> " << setBytes / 1024
+       << ", CompactAVLTree<long, bool> " << mapBytes / 1024
+       << ", AVLNode<long, bool> " << sizeof(AVLNode<long, bool>) << endl;
+  check("Set nodes are smaller", setBytes * 4 == mapBytes * 3);
+}
+
+int main()
+{
+  testSmall();
+  testRandom();
+  testFootprint();
+  return failures;
+}
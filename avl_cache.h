@@ -0,0 +1,362 @@
+#ifndef AVL_CACHE_H
+#define AVL_CACHE_H
+
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <cstdlib>
+#include <chrono>
+#include <utility>
+#include "avlbst.h"
+
+/**
+* Links of the intrusive LRU list. The list is circular around a sentinel
+* owned by the cache, so unlinking never needs to check for its ends.
+*/
+struct LruLink
+{
+    LruLink() : prev_(this), next_(this) {}
+
+    void unlink()
+    {
+        prev_->next_ = next_;
+        next_->prev_ = prev_;
+        prev_ = next_ = this;
+    }
+
+    // inserts this right after at
+    void linkAfter(LruLink* at)
+    {
+        prev_ = at;
+        next_ = at->next_;
+        at->next_->prev_ = this;
+        at->next_ = this;
+    }
+
+    LruLink* prev_;
+    LruLink* next_;
+};
+
+/**
+* An AVLNode that is also an LRU list entry and carries its expiry time.
+* Deleting the node takes it off the list.
+*/
+template <typename Key, typename Value, typename TimePoint>
+class CacheNode : public AVLNode<Key, Value>, public LruLink
+{
+public:
+    CacheNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+    virtual ~CacheNode();
+
+    const TimePoint& getExpiry() const;
+    void setExpiry(const TimePoint& expiry);
+
+protected:
+    TimePoint expiry_;
+};
+
+/*
+  --------------------------------------------
+  Begin implementations for the CacheNode class.
+  --------------------------------------------
+*/
+
+template<typename Key, typename Value, typename TimePoint>
+CacheNode<Key, Value, TimePoint>::CacheNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent) :
+    AVLNode<Key, Value>(key, value, parent), expiry_()
+{
+
+}
+
+template<typename Key, typename Value, typename TimePoint>
+CacheNode<Key, Value, TimePoint>::~CacheNode()
+{
+    unlink();
+}
+
+template<typename Key, typename Value, typename TimePoint>
+const TimePoint& CacheNode<Key, Value, TimePoint>::getExpiry() const
+{
+    return expiry_;
+}
+
+template<typename Key, typename Value, typename TimePoint>
+void CacheNode<Key, Value, TimePoint>::setExpiry(const TimePoint& expiry)
+{
+    expiry_ = expiry;
+}
+
+/*
+  ------------------------------------------
+  End implementations for the CacheNode class.
+  ------------------------------------------
+*/
+
+/**
+* An ordered cache holding at most capacity() entries, each with its own
+* expiry time. Entries are threaded on an intrusive LRU list; inserting
+* into a full cache evicts the least recently used entry.
+*
+* Expired entries are dropped lazily when they are looked up, and by a
+* purge step that checks a fixed number of entries per call, walking a
+* hand around the LRU list. put() runs a small step itself, so no
+* separate sweeper or full scan is needed; purgeExpired() may be called
+* from an idle loop to reclaim memory sooner.
+*
+* Clock is a std::chrono style clock, which tests can replace. The cache
+* is not thread safe.
+*/
+template <class Key, class Value, class Clock = std::chrono::steady_clock>
+class AVLCache : protected AVLTree<Key, Value>
+{
+public:
+    typedef typename Clock::duration duration;
+    typedef typename Clock::time_point time_point;
+    typedef typename AVLTree<Key, Value>::iterator iterator;
+
+    static const size_t PUT_PURGE_STEPS = 2; // entries checked by every put
+
+    // Throws std::invalid_argument if capacity is 0.
+    AVLCache(size_t capacity, duration ttl);
+    virtual ~AVLCache();
+
+    void put(const Key& key, const Value& value);               // expires after the default ttl
+    void put(const Key& key, const Value& value, duration ttl);
+    Value* get(const Key& key);      // nullptr if missing or expired; marks the entry used
+    bool contains(const Key& key);   // does not mark the entry used
+    virtual void remove(const Key& key);
+    virtual void clear();
+    size_t purgeExpired(size_t maxChecks); // returns the number of entries dropped
+
+    size_t size() const;
+    size_t capacity() const;
+    bool empty() const;
+    using AVLTree<Key, Value>::isBalanced;
+
+    // Key order. Expired entries that have not been purged are still visited.
+    using AVLTree<Key, Value>::begin;
+    using AVLTree<Key, Value>::end;
+
+protected:
+    typedef CacheNode<Key, Value, time_point> Entry;
+
+    virtual AVLNode<Key, Value>* createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+
+    // Add helper functions here
+    Entry* lookup(const Key& key); // drops key if it has expired
+    void erase(Entry* entry);
+    void touch(Entry* entry); // moves entry to the most recently used end
+
+protected:
+    size_t capacity_;
+    size_t size_;
+    duration ttl_;
+    LruLink lru_;   // next_ is the most recently used entry, prev_ the least
+    LruLink* hand_; // next entry the purge step checks
+};
+
+/*
+  --------------------------------------------
+  Begin implementations for the AVLCache class.
+  --------------------------------------------
+*/
+
+template<class Key, class Value, class Clock>
+const size_t AVLCache<Key, Value, Clock>::PUT_PURGE_STEPS;
+
+template<class Key, class Value, class Clock>
+AVLCache<Key, Value, Clock>::AVLCache(size_t capacity, duration ttl) :
+    capacity_(capacity), size_(0), ttl_(ttl), hand_(&lru_)
+{
+    if(capacity == 0)
+    {
+        throw std::invalid_argument("AVLCache capacity must be positive");
+    }
+}
+
+/**
+* The nodes unlink themselves from lru_ when deleted, so they must go
+* before lru_ does.
+*/
+template<class Key, class Value, class Clock>
+AVLCache<Key, Value, Clock>::~AVLCache()
+{
+    clear();
+}
+
+template<class Key, class Value, class Clock>
+AVLNode<Key, Value>* AVLCache<Key, Value, Clock>::createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent)
+{
+    return new Entry(key, value, parent);
+}
+
+template<class Key, class Value, class Clock>
+void AVLCache<Key, Value, Clock>::put(const Key& key, const Value& value)
+{
+    put(key, value, ttl_);
+}
+
+/**
+* Inserts or overwrites key, restarting its ttl and marking it used. A new
+* key that would overflow the cache first evicts the least recently used
+* entry, after the purge step has had a chance to free an expired one
+* instead, so the tree never holds more than capacity() entries.
+*/
+template<class Key, class Value, class Clock>
+void AVLCache<Key, Value, Clock>::put(const Key& key, const Value& value, duration ttl)
+{
+    purgeExpired(PUT_PURGE_STEPS);
+
+    Entry* entry = static_cast<Entry*>(this->internalFind(key));
+    if(entry != nullptr)
+    {
+        entry->setValue(value);
+    }
+    else
+    {
+        if(size_ >= capacity_)
+        {
+            erase(static_cast<Entry*>(lru_.prev_));
+        }
+        bool created;
+        entry = static_cast<Entry*>(this->findOrCreateNode(key, value, created));
+        size_++;
+    }
+    entry->setExpiry(Clock::now() + ttl);
+    touch(entry);
+}
+
+template<class Key, class Value, class Clock>
+Value* AVLCache<Key, Value, Clock>::get(const Key& key)
+{
+    Entry* entry = lookup(key);
+    if(entry == nullptr)
+    {
+        return nullptr;
+    }
+    touch(entry);
+    return &entry->getValue();
+}
+
+template<class Key, class Value, class Clock>
+bool AVLCache<Key, Value, Clock>::contains(const Key& key)
+{
+    return lookup(key) != nullptr;
+}
+
+template<class Key, class Value, class Clock>
+void AVLCache<Key, Value, Clock>::remove(const Key& key)
+{
+    Entry* entry = static_cast<Entry*>(this->internalFind(key));
+    if(entry != nullptr)
+    {
+        erase(entry);
+    }
+}
+
+template<class Key, class Value, class Clock>
+void AVLCache<Key, Value, Clock>::clear()
+{
+    AVLTree<Key, Value>::clear();
+    size_ = 0;
+    hand_ = &lru_;
+}
+
+/**
+* Checks up to maxChecks entries, continuing from where the last call
+* stopped and moving from the least recently used end towards the most
+* recently used one, wrapping around. Each entry is therefore looked at
+* within size() / maxChecks calls of expiring.
+*/
+template<class Key, class Value, class Clock>
+size_t AVLCache<Key, Value, Clock>::purgeExpired(size_t maxChecks)
+{
+    if(size_ == 0)
+    {
+        return 0;
+    }
+
+    time_point now = Clock::now();
+    size_t removed = 0;
+    for(size_t i = 0; i < maxChecks && size_ > 0; i++)
+    {
+        if(hand_ == &lru_)
+        {
+            hand_ = lru_.prev_;
+        }
+        Entry* entry = static_cast<Entry*>(hand_);
+        hand_ = hand_->prev_;
+        if(!(now < entry->getExpiry()))
+        {
+            erase(entry);
+            removed++;
+        }
+    }
+    return removed;
+}
+
+template<class Key, class Value, class Clock>
+size_t AVLCache<Key, Value, Clock>::size() const
+{
+    return size_;
+}
+
+template<class Key, class Value, class Clock>
+size_t AVLCache<Key, Value, Clock>::capacity() const
+{
+    return capacity_;
+}
+
+template<class Key, class Value, class Clock>
+bool AVLCache<Key, Value, Clock>::empty() const
+{
+    return size_ == 0;
+}
+
+/**
+* Finds key, dropping it instead if it has expired.
+*/
+template<class Key, class Value, class Clock>
+typename AVLCache<Key, Value, Clock>::Entry* AVLCache<Key, Value, Clock>::lookup(const Key& key)
+{
+    Entry* entry = static_cast<Entry*>(this->internalFind(key));
+    if(entry != nullptr && !(Clock::now() < entry->getExpiry()))
+    {
+        erase(entry);
+        return nullptr;
+    }
+    return entry;
+}
+
+/**
+* Removes entry from the tree; its destructor takes it off the LRU list.
+*/
+template<class Key, class Value, class Clock>
+void AVLCache<Key, Value, Clock>::erase(Entry* entry)
+{
+    if(hand_ == entry)
+    {
+        hand_ = entry->prev_;
+    }
+    this->removeNode(entry);
+    size_--;
+}
+
+template<class Key, class Value, class Clock>
+void AVLCache<Key, Value, Clock>::touch(Entry* entry)
+{
+    if(hand_ == entry)
+    {
+        hand_ = entry->prev_;
+    }
+    entry->unlink();
+    entry->linkAfter(&lru_);
+}
+
+/*
+  ------------------------------------------
+  End implementations for the AVLCache class.
+  ------------------------------------------
+*/
+
+#endif
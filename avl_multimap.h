@@ -0,0 +1,522 @@
+#ifndef AVL_MULTIMAP_H
+#define AVL_MULTIMAP_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include "avlbst.h"
+
+/**
+* The values stored under one key of an AVLMultiMap, in insertion order.
+* Values are kept in a chain of chunks whose capacity doubles from 1 up to
+* MAX_CHUNK, so a key with one value costs one small allocation and a key
+* with a million values costs a few thousand.
+*/
+template <typename Value>
+class ValueChunkList
+{
+protected:
+    struct Chunk
+    {
+        Chunk* next;
+        uint32_t count;
+        uint32_t capacity;
+        Value* values() { return reinterpret_cast<Value*>(this + 1); }
+    };
+
+public:
+    static const uint32_t MAX_CHUNK = 256;
+
+    ValueChunkList();
+    ValueChunkList(const ValueChunkList<Value>& other);
+    ValueChunkList<Value>& operator=(const ValueChunkList<Value>& other);
+    ~ValueChunkList();
+
+    void append(const Value& value);
+    void clear();
+    size_t size() const;
+    bool empty() const;
+
+    class iterator
+    {
+    public:
+        iterator();
+
+        Value& operator*() const;
+        Value* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class ValueChunkList<Value>;
+        iterator(Chunk* chunk);
+        Chunk* chunk_;
+        uint32_t index_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+
+protected:
+    Chunk* head_;
+    Chunk* tail_;
+    size_t size_;
+};
+
+/**
+* Prints the values as {a, b, c}, used by the tree's print().
+*/
+template <typename Value>
+std::ostream& operator<<(std::ostream& out, const ValueChunkList<Value>& list)
+{
+    out << '{';
+    for(typename ValueChunkList<Value>::iterator it = list.begin(); it != list.end(); ++it)
+    {
+        if(it != list.begin())
+        {
+            out << ", ";
+        }
+        out << *it;
+    }
+    return out << '}';
+}
+
+/*
+  ----------------------------------------------------------
+  Begin implementations for the ValueChunkList class.
+  ----------------------------------------------------------
+*/
+
+template<typename Value>
+ValueChunkList<Value>::iterator::iterator() : chunk_(nullptr), index_(0)
+{
+
+}
+
+template<typename Value>
+ValueChunkList<Value>::iterator::iterator(Chunk* chunk) : chunk_(chunk), index_(0)
+{
+
+}
+
+template<typename Value>
+Value& ValueChunkList<Value>::iterator::operator*() const
+{
+    return chunk_->values()[index_];
+}
+
+template<typename Value>
+Value* ValueChunkList<Value>::iterator::operator->() const
+{
+    return &(chunk_->values()[index_]);
+}
+
+template<typename Value>
+bool ValueChunkList<Value>::iterator::operator==(const iterator& rhs) const
+{
+    return chunk_ == rhs.chunk_ && index_ == rhs.index_;
+}
+
+template<typename Value>
+bool ValueChunkList<Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+template<typename Value>
+typename ValueChunkList<Value>::iterator& ValueChunkList<Value>::iterator::operator++()
+{
+    if(++index_ == chunk_->count)
+    {
+        chunk_ = chunk_->next;
+        index_ = 0;
+    }
+    return *this;
+}
+
+template<typename Value>
+ValueChunkList<Value>::ValueChunkList() : head_(nullptr), tail_(nullptr), size_(0)
+{
+
+}
+
+template<typename Value>
+ValueChunkList<Value>::ValueChunkList(const ValueChunkList<Value>& other) :
+    head_(nullptr), tail_(nullptr), size_(0)
+{
+    try
+    {
+        for(iterator it = other.begin(); it != other.end(); ++it)
+        {
+            append(*it);
+        }
+    }
+    catch(...)
+    {
+        clear(); // the destructor will not run
+        throw;
+    }
+}
+
+template<typename Value>
+ValueChunkList<Value>& ValueChunkList<Value>::operator=(const ValueChunkList<Value>& other)
+{
+    if(this != &other)
+    {
+        clear();
+        for(iterator it = other.begin(); it != other.end(); ++it)
+        {
+            append(*it);
+        }
+    }
+    return *this;
+}
+
+template<typename Value>
+ValueChunkList<Value>::~ValueChunkList()
+{
+    clear();
+}
+
+/**
+* Appends to the last chunk, starting a bigger one when it is full. A new
+* chunk is only linked in once the value is built in it, so a throwing
+* copy leaves the list as it was.
+*/
+template<typename Value>
+void ValueChunkList<Value>::append(const Value& value)
+{
+    static_assert(alignof(Value) <= alignof(Chunk), "ValueChunkList needs a stricter chunk alignment");
+
+    if(tail_ == nullptr || tail_->count == tail_->capacity)
+    {
+        uint32_t capacity = (tail_ == nullptr) ? 1 : tail_->capacity * 2;
+        if(capacity > MAX_CHUNK)
+        {
+            capacity = MAX_CHUNK;
+        }
+        Chunk* chunk = static_cast<Chunk*>(::operator new(sizeof(Chunk) + capacity * sizeof(Value)));
+        try
+        {
+            new (chunk->values()) Value(value);
+        }
+        catch(...)
+        {
+            ::operator delete(chunk);
+            throw;
+        }
+        chunk->next = nullptr;
+        chunk->count = 1;
+        chunk->capacity = capacity;
+        if(tail_ == nullptr)
+        {
+            head_ = chunk;
+        }
+        else
+        {
+            tail_->next = chunk;
+        }
+        tail_ = chunk;
+    }
+    else
+    {
+        new (tail_->values() + tail_->count) Value(value);
+        tail_->count++;
+    }
+    size_++;
+}
+
+template<typename Value>
+void ValueChunkList<Value>::clear()
+{
+    while(head_ != nullptr)
+    {
+        Chunk* next = head_->next;
+        for(uint32_t i = 0; i < head_->count; i++)
+        {
+            head_->values()[i].~Value();
+        }
+        ::operator delete(head_);
+        head_ = next;
+    }
+    tail_ = nullptr;
+    size_ = 0;
+}
+
+template<typename Value>
+size_t ValueChunkList<Value>::size() const
+{
+    return size_;
+}
+
+template<typename Value>
+bool ValueChunkList<Value>::empty() const
+{
+    return size_ == 0;
+}
+
+template<typename Value>
+typename ValueChunkList<Value>::iterator ValueChunkList<Value>::begin() const
+{
+    return iterator(head_);
+}
+
+template<typename Value>
+typename ValueChunkList<Value>::iterator ValueChunkList<Value>::end() const
+{
+    return iterator();
+}
+
+/*
+  --------------------------------------------------------
+  End implementations for the ValueChunkList class.
+  --------------------------------------------------------
+*/
+
+/**
+* An ordered map that allows duplicate keys. Each distinct key is one AVL
+* node whose value is a ValueChunkList, so appending to a key that already
+* exists is a lookup plus an append and never rebalances. Values under a
+* key keep their insertion order.
+*/
+template <class Key, class Value>
+class AVLMultiMap : protected AVLTree<Key, ValueChunkList<Value> >
+{
+public:
+    AVLMultiMap();
+
+    void insert(const std::pair<const Key, Value>& item); // appends, never overwrites
+    void remove(const Key& key);                          // drops every value for key
+    void clear();
+    bool empty() const;
+    size_t size() const;                 // number of values
+    size_t count(const Key& key) const;  // values stored under key
+    using AVLTree<Key, ValueChunkList<Value> >::isBalanced;
+
+    /**
+    * Walks every (key, value) entry in key order, values of one key in
+    * insertion order. Dereferencing gives a pair of references.
+    */
+    class iterator
+    {
+    public:
+        typedef std::pair<const Key&, Value&> reference;
+
+        // Lets it->first / it->second work on the by-value reference.
+        struct pointer
+        {
+            reference entry;
+            const reference* operator->() const { return &entry; }
+        };
+
+        iterator();
+
+        reference operator*() const;
+        pointer operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class AVLMultiMap<Key, Value>;
+        iterator(Node<Key, ValueChunkList<Value> >* node);
+        Node<Key, ValueChunkList<Value> >* node_;
+        typename ValueChunkList<Value>::iterator value_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const; // first value stored under key
+    // [first, last) covering every value of key; both are end() if it is missing.
+    std::pair<iterator, iterator> equalRange(const Key& key) const;
+
+protected:
+    typedef AVLTree<Key, ValueChunkList<Value> > Base;
+    size_t size_;
+};
+
+/*
+  --------------------------------------------------------
+  Begin implementations for the AVLMultiMap::iterator class.
+  --------------------------------------------------------
+*/
+
+template<class Key, class Value>
+AVLMultiMap<Key, Value>::iterator::iterator() : node_(nullptr)
+{
+
+}
+
+template<class Key, class Value>
+AVLMultiMap<Key, Value>::iterator::iterator(Node<Key, ValueChunkList<Value> >* node) :
+    node_(node)
+{
+    if(node_ != nullptr)
+    {
+        value_ = node_->getValue().begin();
+    }
+}
+
+template<class Key, class Value>
+typename AVLMultiMap<Key, Value>::iterator::reference AVLMultiMap<Key, Value>::iterator::operator*() const
+{
+    return reference(node_->getKey(), *value_);
+}
+
+template<class Key, class Value>
+typename AVLMultiMap<Key, Value>::iterator::pointer AVLMultiMap<Key, Value>::iterator::operator->() const
+{
+    pointer p = { **this };
+    return p;
+}
+
+template<class Key, class Value>
+bool AVLMultiMap<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    return node_ == rhs.node_ && value_ == rhs.value_;
+}
+
+template<class Key, class Value>
+bool AVLMultiMap<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* Steps through the current key's values, then on to the next node.
+*/
+template<class Key, class Value>
+typename AVLMultiMap<Key, Value>::iterator& AVLMultiMap<Key, Value>::iterator::operator++()
+{
+    ++value_;
+    if(value_ == node_->getValue().end())
+    {
+        *this = iterator(Base::successor(node_));
+    }
+    return *this;
+}
+
+/*
+  ------------------------------------------------------
+  End implementations for the AVLMultiMap::iterator class.
+  ------------------------------------------------------
+*/
+
+/*
+  -----------------------------------------------
+  Begin implementations for the AVLMultiMap class.
+  -----------------------------------------------
+*/
+
+template<class Key, class Value>
+AVLMultiMap<Key, Value>::AVLMultiMap() : size_(0)
+{
+
+}
+
+/**
+* One descent finds or creates the key's node. Only a brand new key goes
+* through attachNode and the AVL rebalancing.
+*/
+template<class Key, class Value>
+void AVLMultiMap<Key, Value>::insert(const std::pair<const Key, Value>& item)
+{
+    bool created;
+    AVLNode<Key, ValueChunkList<Value> >* node = this->findOrCreateNode(item.first, ValueChunkList<Value>(), created);
+    try
+    {
+        node->getValue().append(item.second);
+    }
+    catch(...)
+    {
+        if(created)
+        {
+            this->removeNode(node); // no key without values
+        }
+        throw;
+    }
+    size_++;
+}
+
+template<class Key, class Value>
+void AVLMultiMap<Key, Value>::remove(const Key& key)
+{
+    Node<Key, ValueChunkList<Value> >* node = this->internalFind(key);
+    if(node != nullptr)
+    {
+        size_ -= node->getValue().size();
+        this->removeNode(node);
+    }
+}
+
+template<class Key, class Value>
+void AVLMultiMap<Key, Value>::clear()
+{
+    Base::clear();
+    size_ = 0;
+}
+
+template<class Key, class Value>
+bool AVLMultiMap<Key, Value>::empty() const
+{
+    return Base::empty();
+}
+
+template<class Key, class Value>
+size_t AVLMultiMap<Key, Value>::size() const
+{
+    return size_;
+}
+
+template<class Key, class Value>
+size_t AVLMultiMap<Key, Value>::count(const Key& key) const
+{
+    Node<Key, ValueChunkList<Value> >* node = this->internalFind(key);
+    return (node == nullptr) ? 0 : node->getValue().size();
+}
+
+template<class Key, class Value>
+typename AVLMultiMap<Key, Value>::iterator AVLMultiMap<Key, Value>::begin() const
+{
+    return iterator(this->getSmallestNode());
+}
+
+template<class Key, class Value>
+typename AVLMultiMap<Key, Value>::iterator AVLMultiMap<Key, Value>::end() const
+{
+    return iterator();
+}
+
+template<class Key, class Value>
+typename AVLMultiMap<Key, Value>::iterator AVLMultiMap<Key, Value>::find(const Key& key) const
+{
+    return iterator(this->internalFind(key));
+}
+
+template<class Key, class Value>
+std::pair<typename AVLMultiMap<Key, Value>::iterator, typename AVLMultiMap<Key, Value>::iterator>
+AVLMultiMap<Key, Value>::equalRange(const Key& key) const
+{
+    Node<Key, ValueChunkList<Value> >* node = this->internalFind(key);
+    if(node == nullptr)
+    {
+        return std::make_pair(end(), end());
+    }
+    return std::make_pair(iterator(node), iterator(Base::successor(node)));
+}
+
+/*
+  ---------------------------------------------
+  End implementations for the AVLMultiMap class.
+  ---------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef AVL_SET_H
+#define AVL_SET_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <utility>
+#include "compact_avl.h"
+
+/**
+* An ordered set of keys. It is a CompactAVLTree whose slots hold only the
+* key, so unlike AVLTree<Key, bool> there is no value, no pair padding and
+* no per-node pointers or vptr: for an 8-byte key a node is 24 bytes,
+* versus 32 for CompactAVLTree<Key, bool> and 56 for AVLNode<Key, bool>.
+*
+* Iterators yield const Key&. As with CompactAVLTree they stay valid until
+* their key is removed.
+*/
+template <class Key>
+class AVLSet : protected CompactAVLTree<Key, KeyOnly>
+{
+public:
+    typedef typename CompactAVLTree<Key, KeyOnly>::iterator iterator;
+
+    bool insert(const Key& key); // true if key was not already present
+    bool remove(const Key& key); // true if key was present
+    bool contains(const Key& key) const;
+
+    using CompactAVLTree<Key, KeyOnly>::clear;
+    using CompactAVLTree<Key, KeyOnly>::isBalanced;
+    using CompactAVLTree<Key, KeyOnly>::empty;
+    using CompactAVLTree<Key, KeyOnly>::size;
+    using CompactAVLTree<Key, KeyOnly>::memoryUsage;
+    using CompactAVLTree<Key, KeyOnly>::begin;
+    using CompactAVLTree<Key, KeyOnly>::end;
+    using CompactAVLTree<Key, KeyOnly>::find;
+
+protected:
+    typedef CompactAVLTree<Key, KeyOnly> Base;
+};
+
+/*
+  -------------------------------------------
+  Begin implementations for the AVLSet class.
+  -------------------------------------------
+*/
+
+template<class Key>
+bool AVLSet<Key>::insert(const Key& key)
+{
+    bool created;
+    this->findOrInsert(key, KeyOnly(), created);
+    return created;
+}
+
+template<class Key>
+bool AVLSet<Key>::remove(const Key& key)
+{
+    if(this->internalFind(key) == Base::NIL)
+    {
+        return false;
+    }
+    Base::remove(key);
+    return true;
+}
+
+template<class Key>
+bool AVLSet<Key>::contains(const Key& key) const
+{
+    return this->internalFind(key) != Base::NIL;
+}
+
+/*
+  -----------------------------------------
+  End implementations for the AVLSet class.
+  -----------------------------------------
+*/
+
+#endif
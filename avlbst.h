@@ -3,9 +3,13 @@
 
 #include <iostream>
 #include <exception>
+#include <stdexcept>
 #include <cstdlib>
 #include <cstdint>
 #include <algorithm>
+#include <utility>
+#include <vector>
+#include <thread>
 #include "bst.h"
 
 struct KeyError { };
@@ -132,19 +136,275 @@ template <class Key, class Value>
 class AVLTree : public BinarySearchTree<Key, Value>
 {
 public:
+    typedef typename BinarySearchTree<Key, Value>::iterator iterator;
+
+    AVLTree();
     virtual void insert (const std::pair<const Key, Value> &new_item); // TODO
     virtual void remove(const Key& key);  // TODO
+    virtual void clear();
+    // Rebuilds into perfect balance, then recomputes every balance factor.
+    virtual void rebalance();
+
+    // Inserts next to hint (the element that will follow the new one, or end()).
+    // Amortized O(1) when the hint is adjacent to the key.
+    iterator insert(iterator hint, const std::pair<const Key, Value> &new_item);
+
+    // Both make a single descent and at most one rebalance, where find
+    // followed by insert would search twice.
+    // Returns key's value, inserting defaultValue first if key is missing.
+    Value& getOrInsert(const Key& key, const Value& defaultValue);
+    // Inserts value if key is missing, otherwise replaces the value with
+    // combine(old value, value). Returns true if key was new.
+    template<class Combine>
+    bool upsert(const Key& key, const Value& value, Combine combine);
+
+    // Removes every key in [lo, hi] by splitting the range out and joining
+    // what is left, O(log n + k) for k removed keys.
+    void erase(const Key& lo, const Key& hi);
+    // Removes [first, last) the same way. Iterators outside it stay valid.
+    void erase(iterator first, iterator last);
+    // erase(iterator pos) from the base, which unlinks pos's node directly.
+    using BinarySearchTree<Key, Value>::erase;
+
+    // Moves every item with a key >= key into greater (which is cleared first).
+    void split(const Key& key, AVLTree<Key, Value>& greater);
+    // Appends every item of greater, whose keys must all be larger than ours.
+    // Throws std::invalid_argument otherwise. Both run in O(log n).
+    void merge(AVLTree<Key, Value>& greater);
+
+    // Replaces the contents with the (key, value) pairs in [first, last),
+    // given in any order, using up to threads threads. A key that appears
+    // more than once keeps its last value, as with repeated inserts.
+    template<class InputIt>
+    void buildParallel(InputIt first, InputIt last, unsigned threads);
+
+    // Bulk passes over the items on up to threads threads, each taking whole
+    // subtrees. fn may change values but must not touch the tree itself, and
+    // is called concurrently for different items.
+    template<class Fn>
+    void parallelForEach(Fn fn, unsigned threads); // fn(const Key&, Value&)
+    template<class Fn>
+    void parallelForEach(const Key& lo, const Key& hi, Fn fn, unsigned threads); // only lo <= key <= hi
+    template<class Fn>
+    void parallelTransformValues(Fn fn, unsigned threads); // value = fn(key, value)
+    // Folds init and every value, converted to T, with an associative op.
+    // Values are combined in key order, so op need not be commutative.
+    template<class T, class Op>
+    T parallelReduce(T init, Op op, unsigned threads) const;
 protected:
     virtual void nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
+    virtual void removeNode(Node<Key, Value>* node);
 
     // Add helper functions here
     void insertFix(AVLNode<Key, Value>* parent, AVLNode<Key, Value>* node); // TODO, balances tree after insertion
     void removeFix(AVLNode<Key, Value>* node, int8_t diff); // TODO, balances tree after removal
     void rotateLeft(AVLNode<Key, Value>* node); // TODO
     void rotateRight(AVLNode<Key, Value>* node); // TODO
-    
+    AVLNode<Key, Value>* insertNode(const std::pair<const Key, Value> &new_item); // insert, returning the item's node
+    virtual AVLNode<Key, Value>* findOrCreateNode(const Key& key, const Value& value, bool& created); // single descent
+    void attachNode(AVLNode<Key, Value>* parent, AVLNode<Key, Value>* node, bool asLeft); // links a new leaf and rebalances
+
+    // Hooks for trees that keep extra per-node data, e.g. subtree aggregates.
+    // AVLTree itself allocates plain AVLNodes and ignores the updates.
+    virtual AVLNode<Key, Value>* createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+    virtual void updateAfterRotate(AVLNode<Key, Value>* lower, AVLNode<Key, Value>* upper); // upper is now lower's parent
+    virtual void updatePath(AVLNode<Key, Value>* node); // node and all its ancestors changed
+    virtual void updateNode(AVLNode<Key, Value>* node); // node's children were relinked by a join
+
+    // A subtree together with its height, which split and join need and
+    // the nodes themselves do not store.
+    struct Subtree
+    {
+        Subtree() : root(nullptr), height(0) {}
+        Subtree(AVLNode<Key, Value>* root_, int height_) : root(root_), height(height_) {}
+        AVLNode<Key, Value>* root;
+        int height;
+    };
+
+    static int treeHeight(AVLNode<Key, Value>* node); // O(log n), follows the taller child
+    static Subtree leftOf(const Subtree& tree);
+    static Subtree rightOf(const Subtree& tree);
+    int linkNode(AVLNode<Key, Value>* node, const Subtree& left, const Subtree& right); // returns the new height
+    Subtree join(const Subtree& left, AVLNode<Key, Value>* mid, const Subtree& right); // left < mid < right
+    Subtree joinRight(const Subtree& left, AVLNode<Key, Value>* mid, const Subtree& right);
+    Subtree joinLeft(const Subtree& left, AVLNode<Key, Value>* mid, const Subtree& right);
+    Subtree concat(const Subtree& left, const Subtree& right); // join without a middle node
+    Subtree splitLast(const Subtree& tree, AVLNode<Key, Value>*& last);
+    void split(const Subtree& tree, const Key& key, bool keyGoesLeft, Subtree& left, Subtree& right);
+    void cutRange(const Key& lo, const Key* hi, bool hiInclusive); // hi == nullptr cuts to the end
+    void resetRoot(AVLNode<Key, Value>* root); // installs a detached tree as the whole tree
+    int resetBalances(AVLNode<Key, Value>* node); // after BST rotations, returns the height
+
+    // verify hooks: every balance factor must equal the height difference
+    // of its subtrees and lie in [-1, 1]
+    virtual bool checkNode(Node<Key, Value>* node, int leftHeight, int rightHeight) const;
+    virtual bool checkPathNode(Node<Key, Value>* node) const;
+    static int checkedHeight(AVLNode<Key, Value>* node, bool& ok); // checks node's balance too
+    void verifyBulk(const char* op) const; // whole-tree check after joins and rebuilds
+
+    // buildParallel helpers
+    typedef std::vector<std::pair<Key, Value> > ItemVector;
+    static void parallelSort(ItemVector& items, unsigned threads); // stable, by key
+    static void dropDuplicates(ItemVector& items);                // keeps the last of each key
+    Subtree buildRange(const ItemVector& items, size_t lo, size_t hi, unsigned threads);
+
+    // parallel pass helpers, lo/hi of nullptr leave that side unbounded
+    template<class Fn>
+    void visitParallel(AVLNode<Key, Value>* node, const Key* lo, const Key* hi, Fn& fn, unsigned threads);
+    template<class T, class Op>
+    static bool reduceParallel(AVLNode<Key, Value>* node, Op& op, unsigned threads, T& result); // false if empty
+
+protected:
+    AVLNode<Key, Value>* rightmost_; // largest node, so appends skip the descent
 };
 
+/**
+* Default constructor, the base class sets the root to NULL.
+*/
+template<class Key, class Value>
+AVLTree<Key, Value>::AVLTree() : rightmost_(nullptr)
+{
+
+}
+
+/**
+* Allocates the node for a new item. Derived trees return their own node
+* type here.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent)
+{
+    return new AVLNode<Key, Value>(key, value, parent);
+}
+
+/**
+* Called after every rotation. Nothing to do for a plain AVL tree.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::updateAfterRotate(AVLNode<Key, Value>* lower, AVLNode<Key, Value>* upper)
+{
+
+}
+
+/**
+* Called once per insert or remove, after rebalancing, with the deepest
+* node whose subtree changed. Nothing to do for a plain AVL tree.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::updatePath(AVLNode<Key, Value>* node)
+{
+
+}
+
+/**
+* Called by join for each node whose children it set, children first.
+* Nothing to do for a plain AVL tree.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::updateNode(AVLNode<Key, Value>* node)
+{
+
+}
+
+/**
+* Clears the tree along with the cached rightmost node.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::clear()
+{
+    BinarySearchTree<Key, Value>::clear();
+    rightmost_ = nullptr;
+}
+
+/**
+* The rebuild only moves links, so the largest node, and with it
+* rightmost_, stays the same. The base version is skipped since its
+* debug check would see the stale balance factors.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::rebalance()
+{
+    if(this->root_ != nullptr)
+    {
+        this->rebuildSubtree(this->root_);
+    }
+    resetBalances(static_cast<AVLNode<Key, Value>*>(this->root_));
+    verifyBulk("AVLTree::rebalance");
+}
+
+/**
+* Sets every balance factor below node from the subtree heights and lets
+* derived trees refresh their per-node data bottom up. The tree is
+* balanced by then, so the recursion is O(log n) deep.
+*/
+template<class Key, class Value>
+int AVLTree<Key, Value>::resetBalances(AVLNode<Key, Value>* node)
+{
+    if(node == nullptr)
+    {
+        return 0;
+    }
+    int left = resetBalances(node->getLeft());
+    int right = resetBalances(node->getRight());
+    node->setBalance(static_cast<int8_t>(right - left));
+    updateNode(node);
+    return 1 + std::max(left, right);
+}
+
+template<class Key, class Value>
+bool AVLTree<Key, Value>::checkNode(Node<Key, Value>* node, int leftHeight, int rightHeight) const
+{
+    int balance = static_cast<AVLNode<Key, Value>*>(node)->getBalance();
+    return balance == rightHeight - leftHeight && balance >= -1 && balance <= 1;
+}
+
+/**
+* Rotations on the way up only change the balance of path nodes and their
+* children, so those are the ones checked. Their subtree heights come from
+* treeHeight, which trusts the untouched balances further down; that makes
+* each node O(log n) and a whole path O(log^2 n).
+*/
+template<class Key, class Value>
+bool AVLTree<Key, Value>::checkPathNode(Node<Key, Value>* node) const
+{
+    AVLNode<Key, Value>* n = static_cast<AVLNode<Key, Value>*>(node);
+    bool ok = true;
+    int left = checkedHeight(n->getLeft(), ok);
+    int right = checkedHeight(n->getRight(), ok);
+    return ok && checkNode(n, left, right);
+}
+
+/**
+* Returns node's height from its children's treeHeight, clearing ok if
+* node's own balance factor disagrees with them.
+*/
+template<class Key, class Value>
+int AVLTree<Key, Value>::checkedHeight(AVLNode<Key, Value>* node, bool& ok)
+{
+    if(node == nullptr)
+    {
+        return 0;
+    }
+    int left = treeHeight(node->getLeft());
+    int right = treeHeight(node->getRight());
+    int balance = node->getBalance();
+    ok = ok && balance == right - left && balance >= -1 && balance <= 1;
+    return 1 + std::max(left, right);
+}
+
+/**
+* Splits, joins and rebuilds touch too many scattered nodes to track, so
+* in verify-each-op mode they re-check the whole tree.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::verifyBulk(const char* op) const
+{
+    if(this->verifyEachOp_ && !this->verify())
+    {
+        throw std::logic_error(std::string(op) + " left the tree inconsistent");
+    }
+}
+
 
 template<class Key, class Value>
 void AVLTree<Key, Value>::rotateLeft(AVLNode<Key, Value>* node) // mirror of rotateRight
@@ -179,6 +439,7 @@ void AVLTree<Key, Value>::rotateLeft(AVLNode<Key, Value>* node) // mirror of rot
             parent->setRight(x);
         }
     }
+    updateAfterRotate(y, x);
 }
 
 template<class Key, class Value>
@@ -214,6 +475,7 @@ void AVLTree<Key, Value>::rotateRight(AVLNode<Key, Value>* node)
             parent->setLeft(x);
         }
     }
+    updateAfterRotate(y, x);
 }
 
 /*
@@ -223,11 +485,51 @@ void AVLTree<Key, Value>::rotateRight(AVLNode<Key, Value>* node)
 template<class Key, class Value>
 void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
 {
+    insertNode(new_item);
+}
+
+/**
+* Does the work of insert and returns the node now holding the item.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::insertNode(const std::pair<const Key, Value> &new_item)
+{
+    bool created;
+    AVLNode<Key, Value>* node = findOrCreateNode(new_item.first, new_item.second, created);
+    if(!created)
+    {
+        // key already exists, update value
+        node->setValue(new_item.second);
+        updatePath(node);
+    }
+    return node;
+}
+
+/**
+* Returns the node for key, creating it with value (and rebalancing) if
+* the key is missing. Either way only one descent is made, and keys past
+* the current maximum are appended under the cached rightmost node
+* without descending at all. created tells the caller which case it was.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::findOrCreateNode(const Key& key, const Value& value, bool& created)
+{
+    created = true;
+
     // If tree is empty, create root
     if(this->root_ == nullptr)
     {
-        this->root_ = new AVLNode<Key, Value>(new_item.first, new_item.second, nullptr);
-        return;
+        this->root_ = createNode(key, value, nullptr);
+        rightmost_ = static_cast<AVLNode<Key, Value>*>(this->root_);
+        return rightmost_;
+    }
+
+    // monotonic append, the new node becomes the rightmost one
+    if(key > rightmost_->getKey())
+    {
+        AVLNode<Key, Value>* newNode = createNode(key, value, rightmost_);
+        attachNode(rightmost_, newNode, false);
+        return newNode;
     }
 
     // start from root and walk to insertion point
@@ -237,34 +539,49 @@ void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
     while(current != nullptr)
     {
         parent = current;
-        if(new_item.first < current->getKey())
+        if(key < current->getKey())
         {
             current = current->getLeft();
         }
-        else if(new_item.first > current->getKey())
+        else if(key > current->getKey())
         {
             current = current->getRight();
         }
         else
         {
-            // key already exists, update value
-            current->setValue(new_item.second);
-            return;
+            created = false;
+            return current;
         }
     }
 
     // add new node
-    AVLNode<Key, Value>* newNode = new AVLNode<Key, Value>(new_item.first, new_item.second, parent);
-    if(new_item.first < parent->getKey())
+    AVLNode<Key, Value>* newNode = createNode(key, value, parent);
+    attachNode(parent, newNode, key < parent->getKey());
+    return newNode;
+}
+
+/**
+* Links a freshly created leaf under parent (whose slot on that side must
+* be empty) and restores the AVL balance above it.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::attachNode(AVLNode<Key, Value>* parent, AVLNode<Key, Value>* node, bool asLeft)
+{
+    node->setParent(parent);
+    if(asLeft)
     {
-        parent->setLeft(newNode);
+        parent->setLeft(node);
     }
     else
     {
-        parent->setRight(newNode);
+        parent->setRight(node);
+        if(parent == rightmost_)
+        {
+            rightmost_ = node;
+        }
     }
 
-    newNode->setBalance(0);
+    node->setBalance(0);
 
     // rebalancing
     if(parent->getBalance() == -1 || parent->getBalance() == 1)
@@ -274,7 +591,7 @@ void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
     else if(parent->getBalance() == 0)
     {
         // update balance and start fixing
-        if(parent->getLeft() == newNode)
+        if(asLeft)
         {
             parent->setBalance(-1);
         }
@@ -282,8 +599,719 @@ void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
         {
             parent->setBalance(1);
         }
-        insertFix(parent, newNode);
+        insertFix(parent, node);
+    }
+    updatePath(node);
+    if(this->verifyEachOp_)
+    {
+        this->verifyPath(node, "AVLTree::insert");
+    }
+}
+
+/**
+* Hinted insert. If the key belongs directly before hint (or directly
+* after it) the new node is attached there without a search from the
+* root; otherwise this falls back to a normal insert. Returns an iterator
+* to the inserted or updated item.
+*/
+template<class Key, class Value>
+typename AVLTree<Key, Value>::iterator
+AVLTree<Key, Value>::insert(iterator hint, const std::pair<const Key, Value> &new_item)
+{
+    AVLNode<Key, Value>* h = static_cast<AVLNode<Key, Value>*>(this->iteratorNode(hint));
+    AVLNode<Key, Value>* newNode = nullptr;
+
+    if(h == nullptr || this->root_ == nullptr)
+    {
+        // end() hint, appends take the rightmost fast path
+        return this->makeIterator(insertNode(new_item));
+    }
+
+    if(new_item.first < h->getKey())
+    {
+        AVLNode<Key, Value>* pred = static_cast<AVLNode<Key, Value>*>(this->predecessor(h));
+        if(pred == nullptr || pred->getKey() < new_item.first)
+        {
+            // the gap between pred and h is either h's empty left slot
+            // or pred's empty right slot
+            AVLNode<Key, Value>* parent = (h->getLeft() == nullptr) ? h : pred;
+            newNode = createNode(new_item.first, new_item.second, parent);
+            attachNode(parent, newNode, parent == h);
+        }
+    }
+    else if(h->getKey() < new_item.first)
+    {
+        AVLNode<Key, Value>* succ = static_cast<AVLNode<Key, Value>*>(this->successor(h));
+        if(succ == nullptr || new_item.first < succ->getKey())
+        {
+            AVLNode<Key, Value>* parent = (h->getRight() == nullptr) ? h : succ;
+            newNode = createNode(new_item.first, new_item.second, parent);
+            attachNode(parent, newNode, parent != h);
+        }
+    }
+    else
+    {
+        h->setValue(new_item.second);
+        updatePath(h);
+        newNode = h;
+    }
+
+    if(newNode == nullptr)
+    {
+        // hint was not adjacent
+        newNode = insertNode(new_item);
+    }
+    return this->makeIterator(newNode);
+}
+
+/**
+* Derived trees that keep per-node aggregates see the value as inserted;
+* later writes through the returned reference bypass them (use upsert).
+*/
+template<class Key, class Value>
+Value& AVLTree<Key, Value>::getOrInsert(const Key& key, const Value& defaultValue)
+{
+    bool created;
+    return findOrCreateNode(key, defaultValue, created)->getValue();
+}
+
+template<class Key, class Value>
+template<class Combine>
+bool AVLTree<Key, Value>::upsert(const Key& key, const Value& value, Combine combine)
+{
+    bool created;
+    AVLNode<Key, Value>* node = findOrCreateNode(key, value, created);
+    if(!created)
+    {
+        node->setValue(combine(node->getValue(), value));
+        updatePath(node);
+    }
+    return created;
+}
+
+/**
+* Removes all keys k with lo <= k <= hi.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::erase(const Key& lo, const Key& hi)
+{
+    if(hi < lo)
+    {
+        return;
+    }
+    cutRange(lo, &hi, true);
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::erase(iterator first, iterator last)
+{
+    if(first == last)
+    {
+        return;
+    }
+    Node<Key, Value>* stop = this->iteratorNode(last);
+    const Key lo = first->first; // first's node is freed before cutRange returns
+    cutRange(lo, stop == nullptr ? nullptr : &stop->getKey(), false);
+}
+
+/**
+* Splits the tree into keys below lo, the range itself and keys above it,
+* frees the range in one post-order pass and joins the two outer trees.
+* Every split and join step is O(1) plus the height difference it closes,
+* so the whole cut is O(log n) on top of the k deletes, and no per-key
+* search or retrace is done.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::cutRange(const Key& lo, const Key* hi, bool hiInclusive)
+{
+    AVLNode<Key, Value>* root = static_cast<AVLNode<Key, Value>*>(this->root_);
+    Subtree below, rest, doomed, above;
+    split(Subtree(root, treeHeight(root)), lo, false, below, rest);
+    if(hi == nullptr)
+    {
+        doomed = rest;
+    }
+    else
+    {
+        split(rest, *hi, hiInclusive, doomed, above);
+    }
+
+    this->clearNodes(doomed.root);
+
+    resetRoot(concat(below, above).root);
+    verifyBulk("AVLTree::erase");
+}
+
+/**
+* Makes root (possibly a former subtree) the root and refreshes the
+* rightmost cache.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::resetRoot(AVLNode<Key, Value>* root)
+{
+    this->root_ = root;
+    rightmost_ = root;
+    if(root != nullptr)
+    {
+        root->setParent(nullptr);
+        while(rightmost_->getRight() != nullptr)
+        {
+            rightmost_ = rightmost_->getRight();
+        }
+    }
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::split(const Key& key, AVLTree<Key, Value>& greater)
+{
+    if(&greater == this)
+    {
+        return;
+    }
+    greater.clear();
+
+    AVLNode<Key, Value>* root = static_cast<AVLNode<Key, Value>*>(this->root_);
+    Subtree less, more;
+    split(Subtree(root, treeHeight(root)), key, false, less, more);
+    resetRoot(less.root);
+    greater.resetRoot(more.root);
+    verifyBulk("AVLTree::split");
+    greater.verifyBulk("AVLTree::split");
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::merge(AVLTree<Key, Value>& greater)
+{
+    if(&greater == this || greater.root_ == nullptr)
+    {
+        return;
+    }
+    Node<Key, Value>* smallest = greater.getSmallestNode();
+    if(rightmost_ != nullptr && !(rightmost_->getKey() < smallest->getKey()))
+    {
+        throw std::invalid_argument("AVLTree::merge keys overlap");
     }
+
+    AVLNode<Key, Value>* root = static_cast<AVLNode<Key, Value>*>(this->root_);
+    AVLNode<Key, Value>* other = static_cast<AVLNode<Key, Value>*>(greater.root_);
+    greater.root_ = nullptr;
+    greater.rightmost_ = nullptr;
+    resetRoot(concat(Subtree(root, treeHeight(root)), Subtree(other, treeHeight(other))).root);
+    verifyBulk("AVLTree::merge");
+}
+
+template<class Key, class Value>
+int AVLTree<Key, Value>::treeHeight(AVLNode<Key, Value>* node)
+{
+    int height = 0;
+    while(node != nullptr)
+    {
+        height++;
+        node = (node->getBalance() < 0) ? node->getLeft() : node->getRight();
+    }
+    return height;
+}
+
+template<class Key, class Value>
+typename AVLTree<Key, Value>::Subtree AVLTree<Key, Value>::leftOf(const Subtree& tree)
+{
+    return Subtree(tree.root->getLeft(), tree.height - (tree.root->getBalance() > 0 ? 2 : 1));
+}
+
+template<class Key, class Value>
+typename AVLTree<Key, Value>::Subtree AVLTree<Key, Value>::rightOf(const Subtree& tree)
+{
+    return Subtree(tree.root->getRight(), tree.height - (tree.root->getBalance() < 0 ? 2 : 1));
+}
+
+/**
+* Makes left and right the children of node, whose subtree must then be
+* within AVL balance, and sets node's balance from the two heights.
+*/
+template<class Key, class Value>
+int AVLTree<Key, Value>::linkNode(AVLNode<Key, Value>* node, const Subtree& left, const Subtree& right)
+{
+    node->setLeft(left.root);
+    node->setRight(right.root);
+    if(left.root != nullptr)
+    {
+        left.root->setParent(node);
+    }
+    if(right.root != nullptr)
+    {
+        right.root->setParent(node);
+    }
+    node->setBalance(right.height - left.height);
+    updateNode(node);
+    return std::max(left.height, right.height) + 1;
+}
+
+/**
+* Joins two trees and a middle node that sorts between them. When their
+* heights are close mid simply becomes the root; otherwise mid is hung
+* off the spine of the taller tree at the matching height and the path
+* back up is rebalanced.
+*/
+template<class Key, class Value>
+typename AVLTree<Key, Value>::Subtree
+AVLTree<Key, Value>::join(const Subtree& left, AVLNode<Key, Value>* mid, const Subtree& right)
+{
+    if(left.height > right.height + 1)
+    {
+        return joinRight(left, mid, right);
+    }
+    if(right.height > left.height + 1)
+    {
+        return joinLeft(left, mid, right);
+    }
+    return Subtree(mid, linkNode(mid, left, right));
+}
+
+/**
+* join for a left tree at least two taller: walks down its right spine.
+*/
+template<class Key, class Value>
+typename AVLTree<Key, Value>::Subtree
+AVLTree<Key, Value>::joinRight(const Subtree& left, AVLNode<Key, Value>* mid, const Subtree& right)
+{
+    AVLNode<Key, Value>* top = left.root;
+    Subtree outer = leftOf(left);
+    Subtree inner = rightOf(left);
+
+    if(inner.height <= right.height + 1)
+    {
+        if(std::max(inner.height, right.height) + 1 <= outer.height + 1)
+        {
+            Subtree joined(mid, linkNode(mid, inner, right));
+            return Subtree(top, linkNode(top, outer, joined));
+        }
+        // mid would leave top right heavy by two: inner's root moves up
+        Subtree a(top, linkNode(top, outer, leftOf(inner)));
+        Subtree b(mid, linkNode(mid, rightOf(inner), right));
+        return Subtree(inner.root, linkNode(inner.root, a, b));
+    }
+
+    Subtree joined = joinRight(inner, mid, right);
+    if(joined.height <= outer.height + 1)
+    {
+        return Subtree(top, linkNode(top, outer, joined));
+    }
+    // one left rotation at top
+    Subtree a(top, linkNode(top, outer, leftOf(joined)));
+    return Subtree(joined.root, linkNode(joined.root, a, rightOf(joined)));
+}
+
+/**
+* Mirror of joinRight for a right tree at least two taller.
+*/
+template<class Key, class Value>
+typename AVLTree<Key, Value>::Subtree
+AVLTree<Key, Value>::joinLeft(const Subtree& left, AVLNode<Key, Value>* mid, const Subtree& right)
+{
+    AVLNode<Key, Value>* top = right.root;
+    Subtree outer = rightOf(right);
+    Subtree inner = leftOf(right);
+
+    if(inner.height <= left.height + 1)
+    {
+        if(std::max(inner.height, left.height) + 1 <= outer.height + 1)
+        {
+            Subtree joined(mid, linkNode(mid, left, inner));
+            return Subtree(top, linkNode(top, joined, outer));
+        }
+        Subtree a(mid, linkNode(mid, left, leftOf(inner)));
+        Subtree b(top, linkNode(top, rightOf(inner), outer));
+        return Subtree(inner.root, linkNode(inner.root, a, b));
+    }
+
+    Subtree joined = joinLeft(left, mid, inner);
+    if(joined.height <= outer.height + 1)
+    {
+        return Subtree(top, linkNode(top, joined, outer));
+    }
+    // one right rotation at top
+    Subtree b(top, linkNode(top, rightOf(joined), outer));
+    return Subtree(joined.root, linkNode(joined.root, leftOf(joined), b));
+}
+
+template<class Key, class Value>
+typename AVLTree<Key, Value>::Subtree
+AVLTree<Key, Value>::concat(const Subtree& left, const Subtree& right)
+{
+    if(left.root == nullptr)
+    {
+        return right;
+    }
+    AVLNode<Key, Value>* last;
+    Subtree rest = splitLast(left, last);
+    return join(rest, last, right);
+}
+
+/**
+* Detaches the largest node of tree into last and returns the rest.
+*/
+template<class Key, class Value>
+typename AVLTree<Key, Value>::Subtree
+AVLTree<Key, Value>::splitLast(const Subtree& tree, AVLNode<Key, Value>*& last)
+{
+    if(tree.root->getRight() == nullptr)
+    {
+        last = tree.root;
+        return leftOf(tree);
+    }
+    Subtree rest = splitLast(rightOf(tree), last);
+    return join(leftOf(tree), tree.root, rest);
+}
+
+/**
+* Splits tree into the keys before key and the keys after it. key itself
+* goes to the left part if keyGoesLeft, else to the right one.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::split(const Subtree& tree, const Key& key, bool keyGoesLeft, Subtree& left, Subtree& right)
+{
+    if(tree.root == nullptr)
+    {
+        left = right = Subtree();
+        return;
+    }
+
+    AVLNode<Key, Value>* node = tree.root;
+    if(node->getKey() < key || (keyGoesLeft && !(key < node->getKey())))
+    {
+        Subtree rest;
+        split(rightOf(tree), key, keyGoesLeft, rest, right);
+        left = join(leftOf(tree), node, rest);
+    }
+    else
+    {
+        Subtree rest;
+        split(leftOf(tree), key, keyGoesLeft, left, rest);
+        right = join(rest, node, rightOf(tree));
+    }
+}
+
+template<class Key, class Value>
+template<class InputIt>
+void AVLTree<Key, Value>::buildParallel(InputIt first, InputIt last, unsigned threads)
+{
+    if(threads == 0)
+    {
+        threads = 1;
+    }
+    ItemVector items(first, last);
+    parallelSort(items, threads);
+    dropDuplicates(items);
+
+    Subtree built = buildRange(items, 0, items.size(), threads);
+    clear();
+    resetRoot(built.root);
+    verifyBulk("AVLTree::buildParallel");
+}
+
+/**
+* Each thread stable sorts one slice, then neighbouring slices are merged
+* pairwise, one thread per merge, until a single run is left.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::parallelSort(ItemVector& items, unsigned threads)
+{
+    struct ByKey
+    {
+        bool operator()(const std::pair<Key, Value>& a, const std::pair<Key, Value>& b) const
+        {
+            return a.first < b.first;
+        }
+    };
+
+    size_t slices = std::max<size_t>(1, std::min<size_t>(threads, items.size() / 4096));
+    std::vector<size_t> bounds(slices + 1);
+    for(size_t i = 0; i <= slices; i++)
+    {
+        bounds[i] = items.size() * i / slices;
+    }
+
+    std::vector<std::thread> workers;
+    for(size_t i = 1; i < slices; i++)
+    {
+        workers.push_back(std::thread([&items, &bounds, i]() {
+            std::stable_sort(items.begin() + bounds[i], items.begin() + bounds[i + 1], ByKey());
+        }));
+    }
+    std::stable_sort(items.begin() + bounds[0], items.begin() + bounds[1], ByKey());
+    for(size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+
+    for(size_t width = 1; width < slices; width *= 2)
+    {
+        workers.clear();
+        for(size_t i = 0; i + width < slices; i += 2 * width)
+        {
+            size_t end = std::min(i + 2 * width, slices);
+            workers.push_back(std::thread([&items, &bounds, i, width, end]() {
+                std::inplace_merge(items.begin() + bounds[i], items.begin() + bounds[i + width],
+                                   items.begin() + bounds[end], ByKey());
+            }));
+        }
+        for(size_t i = 0; i < workers.size(); i++)
+        {
+            workers[i].join();
+        }
+    }
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::dropDuplicates(ItemVector& items)
+{
+    size_t kept = 0;
+    for(size_t i = 0; i < items.size(); i++)
+    {
+        if(kept > 0 && !(items[kept - 1].first < items[i].first))
+        {
+            items[kept - 1].second = std::move(items[i].second); // same key, later value wins
+        }
+        else
+        {
+            if(kept != i)
+            {
+                items[kept] = std::move(items[i]);
+            }
+            kept++;
+        }
+    }
+    items.erase(items.begin() + kept, items.end());
+}
+
+/**
+* Builds a perfectly balanced tree over items[lo, hi), the middle item at
+* the root. The two halves differ in size by at most one, so their heights
+* do too. While threads > 1 the left half is built on a new thread with
+* half of them. An exception from either half frees what the other built
+* and is rethrown here.
+*/
+template<class Key, class Value>
+typename AVLTree<Key, Value>::Subtree
+AVLTree<Key, Value>::buildRange(const ItemVector& items, size_t lo, size_t hi, unsigned threads)
+{
+    if(lo >= hi)
+    {
+        return Subtree();
+    }
+
+    size_t mid = lo + (hi - lo) / 2;
+    Subtree left, right;
+    if(threads > 1)
+    {
+        std::exception_ptr leftError;
+        std::thread worker([&]() {
+            try
+            {
+                left = buildRange(items, lo, mid, threads / 2);
+            }
+            catch(...)
+            {
+                leftError = std::current_exception();
+            }
+        });
+        try
+        {
+            right = buildRange(items, mid + 1, hi, threads - threads / 2);
+        }
+        catch(...)
+        {
+            worker.join();
+            this->clearNodes(left.root);
+            throw;
+        }
+        worker.join();
+        if(leftError)
+        {
+            this->clearNodes(right.root);
+            std::rethrow_exception(leftError);
+        }
+    }
+    else
+    {
+        left = buildRange(items, lo, mid, 1);
+        try
+        {
+            right = buildRange(items, mid + 1, hi, 1);
+        }
+        catch(...)
+        {
+            this->clearNodes(left.root);
+            throw;
+        }
+    }
+
+    AVLNode<Key, Value>* node;
+    try
+    {
+        node = createNode(items[mid].first, items[mid].second, nullptr);
+    }
+    catch(...)
+    {
+        this->clearNodes(left.root);
+        this->clearNodes(right.root);
+        throw;
+    }
+    return Subtree(node, linkNode(node, left, right));
+}
+
+template<class Key, class Value>
+template<class Fn>
+void AVLTree<Key, Value>::parallelForEach(Fn fn, unsigned threads)
+{
+    visitParallel(static_cast<AVLNode<Key, Value>*>(this->root_), nullptr, nullptr, fn, std::max(threads, 1u));
+}
+
+template<class Key, class Value>
+template<class Fn>
+void AVLTree<Key, Value>::parallelForEach(const Key& lo, const Key& hi, Fn fn, unsigned threads)
+{
+    visitParallel(static_cast<AVLNode<Key, Value>*>(this->root_), &lo, &hi, fn, std::max(threads, 1u));
+}
+
+template<class Key, class Value>
+template<class Fn>
+void AVLTree<Key, Value>::parallelTransformValues(Fn fn, unsigned threads)
+{
+    parallelForEach([&fn](const Key& key, Value& value) { value = fn(key, value); }, threads);
+}
+
+template<class Key, class Value>
+template<class T, class Op>
+T AVLTree<Key, Value>::parallelReduce(T init, Op op, unsigned threads) const
+{
+    T total = init;
+    if(reduceParallel(static_cast<AVLNode<Key, Value>*>(this->root_), op, std::max(threads, 1u), total))
+    {
+        return op(init, total);
+    }
+    return init;
+}
+
+/**
+* In-order walk that skips subtrees outside [lo, hi]. While threads > 1
+* and both subtrees are needed, the left one goes to a new thread with
+* half of them; the AVL balance keeps the halves about the same size. An
+* exception from fn is rethrown once both sides have stopped.
+*/
+template<class Key, class Value>
+template<class Fn>
+void AVLTree<Key, Value>::visitParallel(AVLNode<Key, Value>* node, const Key* lo, const Key* hi, Fn& fn, unsigned threads)
+{
+    if(node == nullptr)
+    {
+        return;
+    }
+
+    bool goLeft = lo == nullptr || *lo < node->getKey();
+    bool goRight = hi == nullptr || node->getKey() < *hi;
+    bool inRange = (lo == nullptr || !(node->getKey() < *lo)) && (hi == nullptr || !(*hi < node->getKey()));
+
+    if(threads > 1 && goLeft && goRight)
+    {
+        std::exception_ptr leftError;
+        std::thread worker([&]() {
+            try
+            {
+                visitParallel(node->getLeft(), lo, hi, fn, threads / 2);
+            }
+            catch(...)
+            {
+                leftError = std::current_exception();
+            }
+        });
+        try
+        {
+            fn(node->getKey(), node->getValue()); // lo < key < hi here
+            visitParallel(node->getRight(), lo, hi, fn, threads - threads / 2);
+        }
+        catch(...)
+        {
+            worker.join();
+            throw;
+        }
+        worker.join();
+        if(leftError)
+        {
+            std::rethrow_exception(leftError);
+        }
+        return;
+    }
+
+    if(goLeft)
+    {
+        visitParallel(node->getLeft(), lo, hi, fn, threads);
+    }
+    if(inRange)
+    {
+        fn(node->getKey(), node->getValue());
+    }
+    if(goRight)
+    {
+        visitParallel(node->getRight(), lo, hi, fn, threads);
+    }
+}
+
+/**
+* Sets result to the fold of node's subtree, splitting across threads the
+* same way as visitParallel.
+*/
+template<class Key, class Value>
+template<class T, class Op>
+bool AVLTree<Key, Value>::reduceParallel(AVLNode<Key, Value>* node, Op& op, unsigned threads, T& result)
+{
+    if(node == nullptr)
+    {
+        return false;
+    }
+
+    T left = result, right = result;
+    bool hasLeft, hasRight;
+    if(threads > 1)
+    {
+        std::exception_ptr leftError;
+        std::thread worker([&]() {
+            try
+            {
+                hasLeft = reduceParallel(node->getLeft(), op, threads / 2, left);
+            }
+            catch(...)
+            {
+                leftError = std::current_exception();
+            }
+        });
+        try
+        {
+            hasRight = reduceParallel(node->getRight(), op, threads - threads / 2, right);
+        }
+        catch(...)
+        {
+            worker.join();
+            throw;
+        }
+        worker.join();
+        if(leftError)
+        {
+            std::rethrow_exception(leftError);
+        }
+    }
+    else
+    {
+        hasLeft = reduceParallel(node->getLeft(), op, 1, left);
+        hasRight = reduceParallel(node->getRight(), op, 1, right);
+    }
+
+    result = hasLeft ? op(left, T(node->getValue())) : T(node->getValue());
+    if(hasRight)
+    {
+        result = op(result, right);
+    }
+    return true;
 }
 
 /*
@@ -293,12 +1321,29 @@ void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
 template<class Key, class Value>
 void AVLTree<Key, Value>:: remove(const Key& key)
 {
-    AVLNode<Key, Value>* node = static_cast<AVLNode<Key, Value>*>(this->internalFind(key));
-    if (node == nullptr) return;
+    AVLNode<Key, Value>* found = static_cast<AVLNode<Key, Value>*>(this->internalFind(key));
+    if (found == nullptr) return;
+    removeNode(found);
+}
+
+/**
+* Unlinks node and rebalances from its parent up. Used by remove and, with
+* no search at all, by erase(iterator).
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::removeNode(Node<Key, Value>* found)
+{
+    AVLNode<Key, Value>* node = static_cast<AVLNode<Key, Value>*>(found);
 
     AVLNode<Key, Value>* parent = static_cast<AVLNode<Key, Value>*>(node->getParent());
     int8_t diff = 0;
 
+    // the rightmost node has no right child, so it is never swapped below
+    if(node == rightmost_)
+    {
+        rightmost_ = static_cast<AVLNode<Key, Value>*>(this->predecessor(node));
+    }
+
     // two children, swap with predecessor
     if (node->getLeft() != nullptr && node->getRight() != nullptr)
     {
@@ -347,6 +1392,11 @@ void AVLTree<Key, Value>:: remove(const Key& key)
     if (parent != nullptr)
     {
         removeFix(parent, diff);
+        updatePath(parent);
+    }
+    if(this->verifyEachOp_)
+    {
+        this->verifyPath(parent != nullptr ? parent : this->root_, "AVLTree::remove");
     }
 }
 
@@ -558,7 +1608,6 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* node, int8_t diff)
         }
         else if(newBalance == -1)
         {
-            std::cout << "done early?" << std::endl;
             node->setBalance(-1);
             return; // done early
         }
@@ -1,10 +1,37 @@
 #include <iostream>
+#include <vector>
+#include <string>
 #include <map>
+#include <functional>
 #include "bst.h"
 #include "avlbst.h"
+#include "test_check.h"
 
 using namespace std;
 
+// Exposes the height of a BST for the balance tests below.
+template<typename Key, typename Value>
+class HeightTree : public BinarySearchTree<Key, Value>
+{
+public:
+    HeightTree() {}
+    explicit HeightTree(double alpha) : BinarySearchTree<Key, Value>(alpha) {}
+    int height() { return this->getHeight(); }
+};
+
+// Lets the verify tests break a node on purpose.
+class BrokenAVL : public AVLTree<int, int>
+{
+public:
+    void setBalance(int key, int8_t balance)
+    {
+        static_cast<AVLNode<int, int>*>(this->internalFind(key))->setBalance(balance);
+    }
+    void setParent(int key, int parentKey)
+    {
+        this->internalFind(key)->setParent(this->internalFind(parentKey));
+    }
+};
 
 int main(int argc, char *argv[])
 {
@@ -57,10 +84,302 @@ int main(int argc, char *argv[])
     zigzagTree.insert(std::make_pair('b', 3)); // This should trigger left-right rotation
     cout << "inserted b, should trigger left-right rotation" << endl;
 
+    std::string zigzagKeys;
     for(AVLTree<char, int>::iterator it = zigzagTree.begin(); it != zigzagTree.end(); ++it) 
     {
         cout << it->first << " => " << it->second << endl;
+        zigzagKeys += it->first;
+    }
+    check("Zig-zag keeps order and balance", zigzagKeys == "abc" && zigzagTree.isBalanced());
+
+    // hinted and append inserts
+
+    cout << "\nHinted Insert Test:" << endl;
+    AVLTree<int, int> hintTree;
+    for(int i = 0; i < 1000; i += 2)
+    {
+        hintTree.insert(std::make_pair(i, i)); // appends past the max
+    }
+    AVLTree<int, int>::iterator hint = hintTree.find(500);
+    for(int i = 499; i > 0; i -= 2)
+    {
+        hint = hintTree.insert(hint, std::make_pair(i, i)); // each key lands right before the hint
+    }
+    hintTree.insert(hintTree.end(), std::make_pair(5000, 1));
+    hintTree.insert(hintTree.find(10), std::make_pair(777, 2)); // not adjacent, falls back
+    hintTree.remove(5000);
+    hintTree.insert(std::make_pair(1001, 3));
+
+    int count = 0;
+    int prev = -1;
+    bool ordered = true;
+    for(AVLTree<int, int>::iterator it = hintTree.begin(); it != hintTree.end(); ++it)
+    {
+        ordered = ordered && prev < it->first;
+        prev = it->first;
+        count++;
+    }
+    check("Hinted inserts", ordered && count == 752 && hintTree.isBalanced());
+
+    // Range Erase Test
+    cout << "\nRange Erase Test:" << endl;
+    AVLTree<int, int> rangeTree;
+    for(int i = 0; i < 1000; i++)
+    {
+        rangeTree.insert(std::make_pair(i, i));
+    }
+    rangeTree.erase(100, 399);                                  // 300 keys
+    rangeTree.erase(rangeTree.find(900), rangeTree.end());     // 100 keys
+    rangeTree.erase(rangeTree.find(0), rangeTree.find(50));    // 50 keys
+    rangeTree.erase(2000, 3000);                               // nothing there
+    rangeTree.insert(std::make_pair(2000, 1));                 // appends after the new maximum
+
+    count = 0;
+    prev = -1;
+    ordered = true;
+    for(AVLTree<int, int>::iterator it = rangeTree.begin(); it != rangeTree.end(); ++it)
+    {
+        ordered = ordered && prev < it->first && !(it->first >= 100 && it->first < 400);
+        prev = it->first;
+        count++;
+    }
+    check("Range erase", ordered && count == 551 && rangeTree.isBalanced());
+
+    // Parallel Build Test
+    cout << "\nParallel Build Test:" << endl;
+    std::vector<std::pair<int, int> > unsorted;
+    for(int i = 0; i < 20000; i++)
+    {
+        unsorted.push_back(std::make_pair((i * 7919) % 10000, i)); // every key twice
+    }
+    AVLTree<int, int> builtTree;
+    builtTree.insert(std::make_pair(-1, 0)); // replaced by the build
+    builtTree.buildParallel(unsorted.begin(), unsorted.end(), 4);
+    builtTree.insert(std::make_pair(10000, 0));
+
+    count = 0;
+    prev = -1;
+    ordered = true;
+    bool lastWins = true;
+    for(AVLTree<int, int>::iterator it = builtTree.begin(); it != builtTree.end(); ++it)
+    {
+        ordered = ordered && prev < it->first;
+        lastWins = lastWins && (it->first == 10000 || it->second >= 10000);
+        prev = it->first;
+        count++;
+    }
+    check("Parallel build keeps the last value", ordered && count == 10001 && lastWins && builtTree.isBalanced());
+
+    // Parallel Ops Test
+    cout << "\nParallel Ops Test:" << endl;
+    builtTree.remove(10000);
+    builtTree.parallelTransformValues([](const int& key, const int& value) { return key * 2; }, 4);
+    builtTree.parallelForEach(100, 199, [](const int& key, int& value) { value = -1; }, 3);
+    long total = builtTree.parallelReduce(0L, [](long a, long b) { return a + b; }, 4);
+    // 2 * (0 + ... + 9999) with 100..199 replaced by -1
+    long expected = 2L * 9999 * 10000 / 2 - 2L * (100 + 199) * 100 / 2 - 100;
+    check("Parallel ops sum", total == expected);
+
+    // Batch Find Test
+    cout << "\nBatch Find Test:" << endl;
+    std::vector<int> probes;
+    for(int i = -50; i < 10050; i += 3)
+    {
+        probes.push_back(i);
+    }
+    std::vector<AVLTree<int, int>::iterator> found;
+    builtTree.findMany(probes, found);
+    bool sameAsFind = found.size() == probes.size();
+    for(size_t i = 0; sameAsFind && i < probes.size(); i++)
+    {
+        sameAsFind = found[i] == builtTree.find(probes[i]);
+    }
+    check("Batch find matches find", sameAsFind);
+
+    // Scapegoat Test
+    cout << "\nScapegoat Test:" << endl;
+    HeightTree<int, int> scapegoat(0.7);
+    for(int i = 0; i < 10000; i++)
+    {
+        scapegoat.insert(std::make_pair(i, i)); // sorted, the worst case for a plain BST
+    }
+    int insertHeight = scapegoat.height();
+    for(int i = 0; i < 10000; i++)
+    {
+        if(i % 10 != 0)
+        {
+            scapegoat.remove(i);
+        }
+    }
+    count = 0;
+    prev = -1;
+    ordered = true;
+    for(HeightTree<int, int>::iterator it = scapegoat.begin(); it != scapegoat.end(); ++it)
+    {
+        ordered = ordered && prev < it->first && it->first % 10 == 0;
+        prev = it->first;
+        count++;
+    }
+    // log base 1/0.7 of 10000 is 25.8
+    check("Scapegoat height bounded", ordered && count == 1000 && insertHeight <= 27 && scapegoat.height() <= 27);
+
+    // Rebalance Test
+    cout << "\nRebalance Test:" << endl;
+    HeightTree<int, int> vine;
+    for(int i = 0; i < 1000; i++)
+    {
+        vine.insert(std::make_pair(i, i));
+    }
+    int vineHeight = vine.height();
+    vine.rebalance();
+    AVLTree<int, int> avlRebuilt;
+    for(int i = 0; i < 1000; i++)
+    {
+        avlRebuilt.insert(std::make_pair(i, i));
+    }
+    avlRebuilt.rebalance();
+    for(int i = 0; i < 1000; i += 2)
+    {
+        avlRebuilt.remove(i); // balance factors must be right for this to stay balanced
+    }
+    check("Rebalance flattens a vine", vineHeight == 1000 && vine.height() == 10 && vine.isBalanced());
+    check("Rebalanced AVL keeps its balance factors", avlRebuilt.isBalanced() && avlRebuilt.begin()->first == 1);
+
+    // Tree Shape Test
+    cout << "\nTree Shape Test:" << endl;
+    TreeShape avlShape = avlRebuilt.shape();
+    TreeShape parallelShape = avlRebuilt.shape(4);
+    cout << "nodes: " << avlShape.nodes << " height: " << avlShape.height << " leaf depths: "
+         << avlShape.minLeafDepth << "-" << avlShape.maxLeafDepth << endl;
+    check("Tree shape", avlShape.nodes == 500 && avlShape.balanced &&
+                        avlShape.minLeafDepth <= avlShape.maxLeafDepth && avlShape.maxLeafDepth == (int)avlShape.height - 1);
+    check("Parallel shape agrees", parallelShape.nodes == avlShape.nodes && parallelShape.height == avlShape.height &&
+                                   parallelShape.minLeafDepth == avlShape.minLeafDepth);
+
+    // Verify Test
+    cout << "\nVerify Test:" << endl;
+    AVLTree<int, int> checked;
+    checked.setVerifyEachOp(true);
+    bool noThrow = true;
+    try
+    {
+        for(int i = 0; i < 2000; i++)
+        {
+            checked.insert(std::make_pair((i * 7919) % 2000, i));
+        }
+        for(int i = 0; i < 2000; i += 3)
+        {
+            checked.remove(i);
+        }
+        checked.erase(100, 300);
+        AVLTree<int, int> upper;
+        checked.split(1000, upper);
+        checked.merge(upper);
+        checked.rebalance();
+        HeightTree<int, int> checkedScapegoat(0.7);
+        checkedScapegoat.setVerifyEachOp(true);
+        for(int i = 0; i < 2000; i++)
+        {
+            checkedScapegoat.insert(std::make_pair(i, i));
+        }
+        for(int i = 0; i < 2000; i += 2)
+        {
+            checkedScapegoat.remove(i);
+        }
+    }
+    catch(std::logic_error&)
+    {
+        noThrow = false;
+    }
+
+    BrokenAVL broken;
+    for(int i = 1; i <= 7; i++)
+    {
+        broken.insert(std::make_pair(i, i)); // perfect tree rooted at 4
+    }
+    bool validBefore = broken.verify();
+    broken.setBalance(1, 1); // a leaf claiming a right child
+    bool badBalanceFound = !broken.verify();
+    broken.setVerifyEachOp(true);
+    bool insertThrew = false;
+    try
+    {
+        broken.insert(std::make_pair(0, 0)); // 1 is on this insert's path
+    }
+    catch(std::logic_error&)
+    {
+        insertThrew = true;
+    }
+    broken.setVerifyEachOp(false);
+    broken.setParent(3, 4); // 3 hangs under 2
+    bool badLinkFound = !broken.verify();
+    broken.setParent(3, 2);
+    check("Verified ops pass", noThrow && checked.verify() && validBefore);
+    check("Verify finds a bad balance", badBalanceFound && insertThrew);
+    check("Verify finds a bad link", badLinkFound);
+
+    // Get Or Insert Test
+    cout << "\nGet Or Insert Test:" << endl;
+    AVLTree<int, int> counters;
+    for(int i = 0; i < 1000; i++)
+    {
+        counters.getOrInsert(i % 10, 0)++;
+    }
+    bool upserted = true;
+    for(int i = 0; i < 1000; i++)
+    {
+        bool created = counters.upsert(10 + i % 5, 2, std::plus<int>());
+        upserted = upserted && created == (i < 5);
+    }
+    const AVLTree<int, int>& constCounters = counters;
+    check("Get or insert counts", counters[0] == 100 && counters[9] == 100 && counters[14] == 400);
+    check("Upsert creates once", upserted && counters.isBalanced());
+    check("Try get", counters.tryGet(99) == nullptr && *constCounters.tryGet(12) == 400);
+
+    // Erase Iterator Test
+    cout << "\nErase Iterator Test:" << endl;
+    AVLTree<int, int> filtered;
+    BinarySearchTree<int, int> plainFiltered;
+    for(int i = 0; i < 2000; i++)
+    {
+        filtered.insert(std::make_pair((i * 7919) % 2000, i));
+        plainFiltered.insert(std::make_pair((i * 7919) % 2000, i));
+    }
+    filtered.setVerifyEachOp(true); // every erase re-checks its path
+    AVLTree<int, int>::iterator held = filtered.find(1999); // never erased below
+    AVLTree<int, int>::iterator scan = filtered.begin();
+    while(scan != filtered.end())
+    {
+        if(scan->first % 2 == 1 && scan->first != 1999)
+        {
+            scan = filtered.erase(scan);
+        }
+        else
+        {
+            ++scan;
+        }
+    }
+    BinarySearchTree<int, int>::iterator plainScan = plainFiltered.begin();
+    while(plainScan != plainFiltered.end())
+    {
+        plainScan = (plainScan->first % 2 == 1) ? plainFiltered.erase(plainScan) : ++plainScan;
+    }
+    count = 0;
+    prev = -1;
+    ordered = true;
+    for(AVLTree<int, int>::iterator it = filtered.begin(); it != filtered.end(); ++it)
+    {
+        ordered = ordered && prev < it->first && (it->first % 2 == 0 || it->first == 1999);
+        prev = it->first;
+        count++;
+    }
+    int plainCount = 0;
+    for(BinarySearchTree<int, int>::iterator it = plainFiltered.begin(); it != plainFiltered.end(); ++it)
+    {
+        plainCount++;
     }
+    check("Erase by iterator", ordered && count == 1001 && held->first == 1999 && filtered.isBalanced());
+    check("Plain BST erase by iterator", plainCount == 1000 && plainFiltered.verify());
 
-    return 0;
+    return failures;
 }
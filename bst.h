@@ -3,8 +3,20 @@
 
 #include <iostream>
 #include <exception>
+#include <stdexcept>
 #include <cstdlib>
+#include <cmath>
 #include <utility>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "tree_shape.h"
+
+#ifdef BST_VERIFY
+#define BST_VERIFY_DEFAULT true
+#else
+#define BST_VERIFY_DEFAULT false
+#endif
 
 /**
  * A templated class for a Node in a search tree.
@@ -189,22 +201,45 @@ void Node<Key, Value>::setValue(const Value& value)
 
 /**
 * A templated unbalanced binary search tree.
+*
+* Constructed with a scapegoat alpha in (0.5, 1), the plain tree keeps
+* itself balanced the way a scapegoat tree does: when an insert lands
+* deeper than log base 1/alpha of the size, the lowest ancestor whose
+* child holds more than alpha of its subtree is rebuilt into perfect
+* balance, and when removes shrink the tree below alpha of its peak size
+* the whole tree is rebuilt. Only the two sizes are kept, nothing per
+* node. Derived trees do their own balancing and never use this mode.
 */
 template <typename Key, typename Value>
 class BinarySearchTree
 {
 public:
     BinarySearchTree(); //TODO
+    // Throws std::invalid_argument unless 0.5 < scapegoatAlpha < 1.
+    explicit BinarySearchTree(double scapegoatAlpha);
     virtual ~BinarySearchTree(); //TODO
     virtual void insert(const std::pair<const Key, Value>& keyValuePair); //TODO
     virtual void remove(const Key& key); //TODO
-    void clear(); //TODO
+    virtual void clear(); //TODO
+    // Rebuilds the tree into perfect balance in place (Day-Stout-Warren):
+    // O(n) time, O(1) extra space.
+    virtual void rebalance();
     bool isBalanced() const; //TODO
+    // Node count, height, leaf depths and balance in one iterative walk.
+    TreeShape shape(unsigned threads = 1) const;
+    // Checks key order, parent/child links and whatever derived trees add
+    // (e.g. AVL balance factors) in one iterative O(n) pass.
+    bool verify() const;
+    // When on, every insert, remove and rebuild re-checks just the nodes it
+    // touched and throws std::logic_error if one is broken. Off by default,
+    // on by default when compiled with -DBST_VERIFY.
+    void setVerifyEachOp(bool on);
     void print() const;
     bool empty() const;
 
     template<typename PPKey, typename PPValue>
     friend void prettyPrintBST(BinarySearchTree<PPKey, PPValue> & tree);
+    friend struct TreeRootAccess; // see tree_export.h
 public:
     /**
     * An internal iterator class for traversing the contents of the BST.
@@ -232,8 +267,19 @@ public:
     iterator begin() const;
     iterator end() const;
     iterator find(const Key& key) const;
+    // Removes the item at pos without searching for it and returns an
+    // iterator to the next one. Other iterators stay valid, so a filtering
+    // scan is O(n) plus the rebalancing.
+    iterator erase(iterator pos);
+    // out[i] = find(keys[i]). The searches run in lockstep groups that
+    // prefetch each next node, so their cache misses overlap.
+    void findMany(const std::vector<Key>& keys, std::vector<iterator>& out) const;
     Value& operator[](const Key& key);
     Value const & operator[](const Key& key) const;
+    // Pointer to key's value, or nullptr if it is missing. Unlike
+    // operator[] a miss costs no exception.
+    Value* tryGet(const Key& key);
+    const Value* tryGet(const Key& key) const;
 
 protected:
     // Mandatory helper functions
@@ -246,15 +292,40 @@ protected:
     // Provided helper functions
     virtual void printRoot (Node<Key, Value> *r) const;
     virtual void nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2);
+    virtual void removeNode(Node<Key, Value>* node); // the work of remove once node is found
 
     // Add helper functions here
     static Node<Key, Value>* successor(Node<Key, Value>* current); // TODO, should be like predecessor
     int getHeight(); // gets height of a tree, useful for finding balance
     void clearNodes(Node<Key, Value>* node); // helper function for clear()
+    void rotateLeft(Node<Key, Value>* node); // plain rotations for trees without balance data
+    void rotateRight(Node<Key, Value>* node);
+    static iterator makeIterator(Node<Key, Value>* node); // lets derived trees build/read iterators
+    static Node<Key, Value>* iteratorNode(const iterator& it);
+
+    // rebalance and scapegoat helpers
+    Node<Key, Value>* rebuildSubtree(Node<Key, Value>* top); // DSW on top's subtree, returns its new root
+    void compressVine(Node<Key, Value>* parent, bool asLeft, size_t count);
+    void scapegoatInserted(Node<Key, Value>* node, size_t depth);
+    void scapegoatRemoved();
+    static size_t subtreeSize(Node<Key, Value>* node);
+
+    // verify helpers. checkNode gets the child heights (in nodes) during the
+    // full pass; checkPathNode is its O(log n) counterpart for the per-op
+    // checks and may trust nodes off the touched path.
+    virtual bool checkNode(Node<Key, Value>* node, int leftHeight, int rightHeight) const;
+    virtual bool checkPathNode(Node<Key, Value>* node) const;
+    static bool checkLinks(Node<Key, Value>* node); // children point back and are ordered
+    bool verifySubtree(Node<Key, Value>* top) const;
+    void verifyPath(Node<Key, Value>* node, const char* op) const; // node up to the root
 
 protected:
     Node<Key, Value>* root_;
     // You should not need other data members
+    double scapegoatAlpha_;   // 0 when the mode is off
+    size_t scapegoatSize_;    // both sizes are only kept when it is on
+    size_t scapegoatMaxSize_; // largest size since the last full rebuild
+    bool verifyEachOp_;
 };
 
 /*
@@ -357,6 +428,24 @@ template<class Key, class Value>
 BinarySearchTree<Key, Value>::BinarySearchTree() 
 {
     root_ = nullptr;
+    scapegoatAlpha_ = 0;
+    scapegoatSize_ = 0;
+    scapegoatMaxSize_ = 0;
+    verifyEachOp_ = BST_VERIFY_DEFAULT;
+}
+
+/**
+* Constructor for a tree that balances itself as a scapegoat tree.
+*/
+template<class Key, class Value>
+BinarySearchTree<Key, Value>::BinarySearchTree(double scapegoatAlpha) :
+    root_(nullptr), scapegoatAlpha_(scapegoatAlpha), scapegoatSize_(0), scapegoatMaxSize_(0),
+    verifyEachOp_(BST_VERIFY_DEFAULT)
+{
+    if(!(scapegoatAlpha > 0.5 && scapegoatAlpha < 1))
+    {
+        throw std::invalid_argument("scapegoat alpha must be in (0.5, 1)");
+    }
 }
 
 template<typename Key, typename Value>
@@ -416,6 +505,65 @@ BinarySearchTree<Key, Value>::find(const Key & k) const
     return it;
 }
 
+/**
+* Walks FIND_GROUP searches down the tree one level at a time, round
+* robin. Each step prefetches the node the search moves to, and by the
+* time the round comes back to it the other searches have covered the
+* miss.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::findMany(const std::vector<Key>& keys, std::vector<iterator>& out) const
+{
+    static const size_t FIND_GROUP = 16;
+
+    out.assign(keys.size(), end());
+    Node<Key, Value>* cursor[FIND_GROUP];
+    for(size_t base = 0; base < keys.size(); base += FIND_GROUP)
+    {
+        size_t count = std::min(FIND_GROUP, keys.size() - base);
+        for(size_t i = 0; i < count; i++)
+        {
+            cursor[i] = root_;
+        }
+
+        bool active = root_ != nullptr;
+        while(active)
+        {
+            active = false;
+            for(size_t i = 0; i < count; i++)
+            {
+                Node<Key, Value>* node = cursor[i];
+                if(node == nullptr)
+                {
+                    continue;
+                }
+                const Key& key = keys[base + i];
+                if(key < node->getKey())
+                {
+                    node = node->getLeft();
+                }
+                else if(node->getKey() < key)
+                {
+                    node = node->getRight();
+                }
+                else
+                {
+                    out[base + i] = iterator(node);
+                    node = nullptr;
+                }
+                if(node != nullptr)
+                {
+#ifdef __GNUC__
+                    __builtin_prefetch(node);
+#endif
+                    active = true;
+                }
+                cursor[i] = node;
+            }
+        }
+    }
+}
+
 /**
  * @precondition The key exists in the map
  * Returns the value associated with the key
@@ -435,6 +583,20 @@ Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
     return curr->getValue();
 }
 
+template<class Key, class Value>
+Value* BinarySearchTree<Key, Value>::tryGet(const Key& key)
+{
+    Node<Key, Value>* node = internalFind(key);
+    return node == nullptr ? nullptr : &node->getValue();
+}
+
+template<class Key, class Value>
+const Value* BinarySearchTree<Key, Value>::tryGet(const Key& key) const
+{
+    Node<Key, Value>* node = internalFind(key);
+    return node == nullptr ? nullptr : &node->getValue();
+}
+
 /**
 * An insert method to insert into a Binary Search Tree.
 * The tree will not remain balanced when inserting.
@@ -447,15 +609,18 @@ void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &key
     if(root_ == nullptr) 
     {
         root_ = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, nullptr);
+        scapegoatInserted(root_, 0);
         return;
     }
 
     Node<Key, Value>* current = root_;
     Node<Key, Value>* parent = nullptr;
+    size_t depth = 0;
 
     while(current != nullptr) 
     {
         parent = current;
+        depth++;
         if(keyValuePair.first < current->getKey()) 
         {
             current = current->getLeft();
@@ -480,7 +645,11 @@ void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &key
     {
         parent->setRight(newNode);
     }
-
+    scapegoatInserted(newNode, depth);
+    if(verifyEachOp_)
+    {
+        verifyPath(newNode, "BinarySearchTree::insert");
+    }
 }
 
 
@@ -498,7 +667,35 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
     {
         return; // no key is found
     }
+    removeNode(node);
+}
 
+/**
+* The successor is found before anything moves. Removal frees only pos's
+* node and relinks the rest (a two-child node trades places with its
+* predecessor rather than copying items), so the successor's node, and
+* with it the returned iterator, survives.
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::erase(iterator pos)
+{
+    Node<Key, Value>* node = pos.current_;
+    if(node == nullptr)
+    {
+        return end();
+    }
+    Node<Key, Value>* next = successor(node);
+    removeNode(node);
+    return iterator(next);
+}
+
+/**
+* Unlinks and frees node, which must be in the tree.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::removeNode(Node<Key, Value>* node)
+{
     // Case 1: Node has two children
     if (node->getLeft() && node->getRight()) 
     {
@@ -538,6 +735,11 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
         }
 
         delete node;
+        scapegoatRemoved();
+        if(verifyEachOp_)
+        {
+            verifyPath(parent != nullptr ? parent : root_, "BinarySearchTree::remove");
+        }
         return;
     }
 
@@ -574,6 +776,11 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
     }
 
     delete node;
+    scapegoatRemoved();
+    if(verifyEachOp_)
+    {
+        verifyPath(parent != nullptr ? parent : root_, "BinarySearchTree::remove");
+    }
 }
 
 
@@ -653,6 +860,155 @@ void BinarySearchTree<Key, Value>::clear()
         clearNodes(root_); // helper function performs post-order deletion
     }
     root_ = nullptr;
+    scapegoatSize_ = 0;
+    scapegoatMaxSize_ = 0;
+}
+
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::rebalance()
+{
+    if(root_ != nullptr)
+    {
+        rebuildSubtree(root_);
+    }
+    scapegoatMaxSize_ = scapegoatSize_;
+    if(verifyEachOp_ && !verify())
+    {
+        throw std::logic_error("BinarySearchTree::rebalance left the tree inconsistent");
+    }
+}
+
+/**
+* Day-Stout-Warren on one subtree, using only rotations. Rotating every
+* left child up turns the subtree into a "vine", a chain of right
+* children in key order. Rounds of left rotations on every other vine
+* node then fold it into a complete tree: the first round moves the
+* nodes that do not fit a perfect tree into the bottom level, and each
+* later round halves the vine.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::rebuildSubtree(Node<Key, Value>* top)
+{
+    Node<Key, Value>* parent = top->getParent();
+    bool asLeft = parent != nullptr && parent->getLeft() == top;
+
+    size_t count = 0;
+    Node<Key, Value>* node = top;
+    while(node != nullptr)
+    {
+        Node<Key, Value>* left = node->getLeft();
+        if(left != nullptr)
+        {
+            rotateRight(node);
+            node = left;
+        }
+        else
+        {
+            count++;
+            node = node->getRight();
+        }
+    }
+
+    size_t perfect = 1; // largest 2^k - 1 <= count
+    while(perfect * 2 + 1 <= count)
+    {
+        perfect = perfect * 2 + 1;
+    }
+    compressVine(parent, asLeft, count - perfect);
+    while(perfect > 1)
+    {
+        perfect /= 2;
+        compressVine(parent, asLeft, perfect);
+    }
+    return (parent == nullptr) ? root_ : (asLeft ? parent->getLeft() : parent->getRight());
+}
+
+/**
+* One DSW round: left rotates count alternate nodes down the vine that
+* hangs off parent (the root if parent is null).
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::compressVine(Node<Key, Value>* parent, bool asLeft, size_t count)
+{
+    Node<Key, Value>* node = (parent == nullptr) ? root_ : (asLeft ? parent->getLeft() : parent->getRight());
+    for(size_t i = 0; i < count; i++)
+    {
+        Node<Key, Value>* next = node->getRight();
+        rotateLeft(node);
+        node = next->getRight();
+    }
+}
+
+/**
+* Called with every new node and its depth (edges from the root). If
+* the node is too deep, one of its ancestors must hold more than alpha of
+* its subtree on one side; the lowest such ancestor is the scapegoat and
+* is rebuilt. Subtree sizes are counted on the way up, which the rebuild
+* pays for anyway.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::scapegoatInserted(Node<Key, Value>* node, size_t depth)
+{
+    if(scapegoatAlpha_ == 0)
+    {
+        return;
+    }
+    scapegoatSize_++;
+    scapegoatMaxSize_ = std::max(scapegoatMaxSize_, scapegoatSize_);
+    double limit = std::log(static_cast<double>(scapegoatSize_)) / std::log(1 / scapegoatAlpha_);
+    if(depth <= limit)
+    {
+        return;
+    }
+
+    size_t size = 1;
+    Node<Key, Value>* child = node;
+    Node<Key, Value>* parent = node->getParent();
+    while(parent != nullptr)
+    {
+        Node<Key, Value>* sibling = (parent->getLeft() == child) ? parent->getRight() : parent->getLeft();
+        size_t parentSize = size + 1 + subtreeSize(sibling);
+        if(size > scapegoatAlpha_ * parentSize)
+        {
+            Node<Key, Value>* top = rebuildSubtree(parent);
+            if(verifyEachOp_ && !verifySubtree(top))
+            {
+                throw std::logic_error("BinarySearchTree::insert left the tree inconsistent");
+            }
+            return;
+        }
+        size = parentSize;
+        child = parent;
+        parent = parent->getParent();
+    }
+}
+
+/**
+* Called after a node is deleted. Once the tree is down to alpha of its
+* peak size, depths may exceed the insert bound, so it is rebuilt whole.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::scapegoatRemoved()
+{
+    if(scapegoatAlpha_ == 0)
+    {
+        return;
+    }
+    scapegoatSize_--;
+    if(scapegoatSize_ < scapegoatAlpha_ * scapegoatMaxSize_)
+    {
+        rebalance();
+    }
+}
+
+template<typename Key, typename Value>
+size_t BinarySearchTree<Key, Value>::subtreeSize(Node<Key, Value>* node)
+{
+    if(node == nullptr)
+    {
+        return 0;
+    }
+    return 1 + subtreeSize(node->getLeft()) + subtreeSize(node->getRight());
 }
 
 /*
@@ -675,6 +1031,93 @@ void BinarySearchTree<Key, Value>::clearNodes(Node<Key, Value>* node) // helper
     delete node;
 }
 
+/**
+* Wraps a node in an iterator. The iterator's node constructor is only
+* visible to BinarySearchTree, so derived trees go through here.
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::makeIterator(Node<Key, Value>* node)
+{
+    return iterator(node);
+}
+
+/**
+* Returns the node an iterator refers to (NULL for end()).
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::iteratorNode(const iterator& it)
+{
+    return it.current_;
+}
+
+/**
+* Rotates node's right child up into node's place. Only links are
+* changed, so derived trees keep any per-node data they carry.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::rotateLeft(Node<Key, Value>* node)
+{
+    Node<Key, Value>* parent = node->getParent();
+    Node<Key, Value>* x = node->getRight();
+    Node<Key, Value>* b = x->getLeft();
+
+    x->setLeft(node);
+    node->setParent(x);
+    node->setRight(b);
+    if(b != nullptr)
+    {
+        b->setParent(node);
+    }
+    x->setParent(parent);
+
+    if(parent == nullptr)
+    {
+        root_ = x;
+    }
+    else if(parent->getLeft() == node)
+    {
+        parent->setLeft(x);
+    }
+    else
+    {
+        parent->setRight(x);
+    }
+}
+
+/**
+* Mirror of rotateLeft, rotates node's left child up into node's place.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::rotateRight(Node<Key, Value>* node)
+{
+    Node<Key, Value>* parent = node->getParent();
+    Node<Key, Value>* x = node->getLeft();
+    Node<Key, Value>* b = x->getRight();
+
+    x->setRight(node);
+    node->setParent(x);
+    node->setLeft(b);
+    if(b != nullptr)
+    {
+        b->setParent(node);
+    }
+    x->setParent(parent);
+
+    if(parent == nullptr)
+    {
+        root_ = x;
+    }
+    else if(parent->getRight() == node)
+    {
+        parent->setRight(x);
+    }
+    else
+    {
+        parent->setLeft(x);
+    }
+}
+
 
 /**
 * A helper function to find the smallest node in the tree.
@@ -733,47 +1176,159 @@ Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) con
 }
 
 /**
- * Return true iff the BST is balanced.
+ * Return true iff the BST is balanced. Stops at the first node whose
+ * subtrees differ in height by more than one.
  */
 template<typename Key, typename Value>
 bool BinarySearchTree<Key, Value>::isBalanced() const
 {
-    if(root_ == nullptr) // base case, empty tree will always be balanced
-    {
-        return true;
-    }
+    return analyzeShape(root_, GetterChildren(), SHAPE_STOP_UNBALANCED).balanced;
+}
 
-    BinarySearchTree<Key, Value> leftSubtree;
-    leftSubtree.root_ = root_->getLeft();
-    BinarySearchTree<Key, Value> rightSubtree;
-    rightSubtree.root_ = root_->getRight();
+template<typename Key, typename Value>
+TreeShape BinarySearchTree<Key, Value>::shape(unsigned threads) const
+{
+    return analyzeShapeParallel(root_, GetterChildren(), threads);
+}
+
+template<typename Key, typename Value>
+int BinarySearchTree<Key, Value>::getHeight()
+{
+    return analyzeShape(root_, GetterChildren()).height;
+}
 
-    int leftHeight = leftSubtree.getHeight();
-    int rightHeight = rightSubtree.getHeight();
+template<typename Key, typename Value>
+bool BinarySearchTree<Key, Value>::verify() const
+{
+    return (root_ == nullptr || root_->getParent() == nullptr) && verifySubtree(root_);
+}
 
-    bool differenceCheck = abs(leftHeight - rightHeight) <= 1; // difference between subtrees is not greater than 1
-    bool subtreeCheck =  leftSubtree.isBalanced() && rightSubtree.isBalanced(); // recursive call, sees if subtrees are balanced
-    return differenceCheck && subtreeCheck;
-    
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::setVerifyEachOp(bool on)
+{
+    verifyEachOp_ = on;
 }
 
+/**
+* Post-order walk with an explicit stack, so a degenerate tree cannot
+* overflow the call stack. Each node is checked against the key bounds
+* its ancestors impose on the way down and handed to checkNode with its
+* child heights on the way up.
+*/
 template<typename Key, typename Value>
-int BinarySearchTree<Key, Value>::getHeight()
+bool BinarySearchTree<Key, Value>::verifySubtree(Node<Key, Value>* top) const
 {
-    if(root_ == nullptr) // base case, empty tree has height of 0
+    struct Frame
     {
-        return 0;
+        Frame(Node<Key, Value>* node_, const Key* lo_, const Key* hi_) :
+            node(node_), lo(lo_), hi(hi_), stage(0), leftHeight(0) {}
+        Node<Key, Value>* node;
+        const Key* lo; // exclusive bounds, nullptr if unbounded
+        const Key* hi;
+        int stage;     // 0 new, 1 left done, 2 right done
+        int leftHeight;
+    };
+
+    if(top == nullptr)
+    {
+        return true;
     }
+    std::vector<Frame> stack;
+    stack.push_back(Frame(top, nullptr, nullptr));
+    int height = 0; // height of the subtree finished last
+    while(!stack.empty())
+    {
+        Frame& frame = stack.back();
+        Node<Key, Value>* node = frame.node;
+        if(frame.stage == 0)
+        {
+            const Key& key = node->getKey();
+            if((frame.lo != nullptr && !(*frame.lo < key)) ||
+               (frame.hi != nullptr && !(key < *frame.hi)) || !checkLinks(node))
+            {
+                return false;
+            }
+            frame.stage = 1;
+            if(node->getLeft() != nullptr)
+            {
+                stack.push_back(Frame(node->getLeft(), frame.lo, &key));
+                continue;
+            }
+            height = 0;
+        }
+        if(frame.stage == 1)
+        {
+            frame.leftHeight = height;
+            frame.stage = 2;
+            if(node->getRight() != nullptr)
+            {
+                stack.push_back(Frame(node->getRight(), &node->getKey(), frame.hi));
+                continue;
+            }
+            height = 0;
+        }
+        if(!checkNode(node, frame.leftHeight, height))
+        {
+            return false;
+        }
+        height = 1 + std::max(frame.leftHeight, height);
+        stack.pop_back();
+    }
+    return true;
+}
 
-    BinarySearchTree<Key, Value> leftSubtree;
-    leftSubtree.root_ = root_->getLeft();
-    BinarySearchTree<Key, Value> rightSubtree;
-    rightSubtree.root_ = root_->getRight();
+/**
+* A plain tree has nothing beyond ordering and links to check.
+*/
+template<typename Key, typename Value>
+bool BinarySearchTree<Key, Value>::checkNode(Node<Key, Value>* node, int leftHeight, int rightHeight) const
+{
+    return true;
+}
+
+template<typename Key, typename Value>
+bool BinarySearchTree<Key, Value>::checkPathNode(Node<Key, Value>* node) const
+{
+    return true;
+}
 
-    int leftHeight = leftSubtree.getHeight();
-    int rightHeight = rightSubtree.getHeight();
+template<typename Key, typename Value>
+bool BinarySearchTree<Key, Value>::checkLinks(Node<Key, Value>* node)
+{
+    Node<Key, Value>* left = node->getLeft();
+    Node<Key, Value>* right = node->getRight();
+    return (left == nullptr || (left->getParent() == node && left->getKey() < node->getKey())) &&
+           (right == nullptr || (right->getParent() == node && node->getKey() < right->getKey()));
+}
 
-    return 1 + std::max(leftHeight, rightHeight); // returns greatest height of subtrees
+/**
+* The per-op check. Every node from node up to the root must have
+* consistent links and pass checkPathNode, node must sit between its
+* in-order neighbours, and the walk must end at root_. O(log n) on a
+* balanced tree, plus whatever checkPathNode costs.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::verifyPath(Node<Key, Value>* node, const char* op) const
+{
+    bool ok = true;
+    if(node != nullptr)
+    {
+        Node<Key, Value>* pred = predecessor(node);
+        Node<Key, Value>* succ = successor(node);
+        ok = (pred == nullptr || pred->getKey() < node->getKey()) &&
+             (succ == nullptr || node->getKey() < succ->getKey());
+    }
+    Node<Key, Value>* last = node;
+    while(ok && node != nullptr)
+    {
+        ok = checkLinks(node) && checkPathNode(node);
+        last = node;
+        node = node->getParent();
+    }
+    if(!ok || last != root_)
+    {
+        throw std::logic_error(std::string(op) + " left the tree inconsistent");
+    }
 }
 
 
@@ -0,0 +1,214 @@
+#include <iostream>
+#include <cstdlib>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include "compact_avl.h"
+#include "avlbst.h"
+#include "test_check.h"
+using namespace std;
+
+// contents must match the reference map exactly and in order
+template<typename Key, typename Value, typename Layout>
+bool same(CompactAVLTree<Key, Value, Layout>& t, map<Key, Value>& m)
+{
+  typename map<Key, Value>::iterator mit = m.begin();
+  for(typename CompactAVLTree<Key, Value, Layout>::iterator it = t.begin(); it != t.end(); ++it, ++mit) {
+    if(mit == m.end() || mit->first != it->first || mit->second != it->second) return false;
+  }
+  return mit == m.end() && t.size() == m.size();
+}
+
+void testAgainstMap()
+{
+  CompactAVLTree<int, int> t;
+  map<int, int> m;
+  srand(104);
+  for(int i = 0; i < 20000; i++) {
+    int k = rand() % 2000;
+    if(rand() % 3 == 0) {
+      t.remove(k);
+      m.erase(k);
+    }
+    else {
+      t.insert(make_pair(k, i));
+      m[k] = i;
+    }
+  }
+  check("Random ops match map", same(t, m));
+  check("Random ops balanced", t.isBalanced());
+}
+
+void testSequential()
+{
+  CompactAVLTree<int, int> t;
+  for(int i = 0; i < 100000; i++) t.insert(make_pair(i, -i));
+  check("Sequential balanced", t.isBalanced() && t.size() == 100000);
+  check("Lookup", t[4242] == -4242 && t.find(100000) == t.end());
+  for(int i = 0; i < 100000; i += 3) t.remove(i);
+  check("Remove every third", t.isBalanced() && t.size() == 66666 && t.find(3) == t.end());
+}
+
+void testStrings()
+{
+  CompactAVLTree<string, string> t;
+  map<string, string> m;
+  for(int i = 0; i < 500; i++) {
+    string k = "key" + to_string(i * 7 % 500);
+    t.insert(make_pair(k, k + "!"));
+    m[k] = k + "!";
+  }
+  for(int i = 0; i < 500; i += 2) {
+    string k = "key" + to_string(i);
+    t.remove(k);
+    m.erase(k);
+  }
+  t.insert(make_pair(string("key0"), string("back")));
+  m["key0"] = "back";
+  check("String items survive pool growth and reuse", same(t, m));
+
+  t.clear();
+  check("Clear", t.empty() && t.size() == 0 && t.begin() == t.end());
+}
+
+void testFootprint()
+{
+  CompactAVLTree<int, int> t;
+  for(int i = 0; i < 1 << 16; i++) t.insert(make_pair(i, i));
+  size_t compactBytes = t.memoryUsage() / t.size();
+  cout << "bytes per int->int node: compact " << compactBytes
+       << ", AVLNode " << sizeof(AVLNode<int, int>) << endl;
+  check("Compact node is under half an AVLNode", compactBytes * 2 <= sizeof(AVLNode<int, int>));
+}
+
+// A key whose copy throws while armed, as a std::string copy can on
+// bad_alloc.
+struct FragileKey
+{
+  static bool armed;
+  static int live;
+  FragileKey(int k_) : k(k_) { live++; }
+  FragileKey(const FragileKey& other) : k(other.k)
+  {
+    if(armed) throw runtime_error("copy failed");
+    live++;
+  }
+  ~FragileKey() { live--; }
+  bool operator<(const FragileKey& rhs) const { return k < rhs.k; }
+  int k;
+};
+bool FragileKey::armed = false;
+int FragileKey::live = 0;
+
+void testThrowingInsert()
+{
+  CompactAVLTree<FragileKey, int> t;
+  for(int i = 0; i < 16; i++) t.insert(make_pair(FragileKey(i), i)); // pool is full
+  t.remove(3);
+  int threw = 0;
+  // From the free list, then through a pool growth, then past the high
+  // water mark; the unarmed inserts between them move on to the next case.
+  for(int k = 100; k < 103; k++) {
+    pair<const FragileKey, int> item(FragileKey(k), k);
+    FragileKey::armed = true;
+    try {
+      t.insert(item);
+    }
+    catch(runtime_error&) {
+      threw++;
+    }
+    FragileKey::armed = false;
+    if(k == 100) t.insert(make_pair(FragileKey(50), 50)); // takes the free slot
+    if(k == 101) t.insert(make_pair(FragileKey(60), 60)); // grows the pool
+  }
+  int count = 0;
+  for(CompactAVLTree<FragileKey, int>::iterator it = t.begin(); it != t.end(); ++it) count++;
+  t.insert(make_pair(FragileKey(200), 200));
+  check("Throwing item constructor leaves the pool intact", threw == 3 && count == 17 && t.size() == 18 && t.isBalanced());
+  t.clear();
+  check("Only constructed items are destroyed", FragileKey::live == 0);
+}
+
+// A value too big to want in the search path.
+struct Blob
+{
+  Blob(int v = 0) { for(int i = 0; i < 50; i++) words[i] = v + i; }
+  bool operator!=(const Blob& rhs) const { return words[0] != rhs.words[0] || words[49] != rhs.words[49]; }
+  int words[50];
+};
+
+typedef CompactAVLTree<int, Blob, ColdValueSlots<int, Blob> > ColdTree;
+
+struct ColdSlotSize : ColdTree
+{
+  static size_t value() { return sizeof(Slot); }
+};
+
+struct InlineSlotSize : CompactAVLTree<int, Blob>
+{
+  static size_t value() { return sizeof(Slot); }
+};
+
+void testColdValues()
+{
+  ColdTree t;
+  map<int, Blob> m;
+  srand(50);
+  for(int i = 0; i < 20000; i++) {
+    int k = rand() % 2000;
+    if(rand() % 3 == 0) {
+      t.remove(k);
+      m.erase(k);
+    }
+    else {
+      t.insert(make_pair(k, Blob(i)));
+      m[k] = Blob(i);
+    }
+  }
+  check("Cold values match map", same(t, m) && t.isBalanced());
+
+  t.clear();
+  t.insert(make_pair(0, Blob(7)));
+  Blob& held = t[0];
+  for(int i = 1; i < 10000; i++) t.insert(make_pair(i, Blob(i)));
+  check("Value references survive pool growth", &held == &t[0] && held.words[0] == 7);
+
+  CompactAVLTree<string, string, ColdValueSlots<string, string> > strings;
+  for(int i = 0; i < 300; i++) strings.insert(make_pair(to_string(i), string(100, 'a' + i % 26)));
+  for(int i = 0; i < 300; i += 2) strings.remove(to_string(i));
+  strings.insert(make_pair(string("0"), string("back")));
+  check("Cold string items", strings.size() == 151 && strings["0"] == "back" && strings.find("2") == strings.end() &&
+                             strings["299"] == string(100, 'a' + 299 % 26));
+
+  CompactAVLTree<FragileKey, int, ColdValueSlots<FragileKey, int> > fragile;
+  for(int i = 0; i < 256; i++) fragile.insert(make_pair(FragileKey(i), i)); // one full chunk
+  fragile.remove(3);
+  size_t before = fragile.memoryUsage();
+  pair<const FragileKey, int> item(FragileKey(300), 300);
+  FragileKey::armed = true;
+  bool threw = false;
+  try {
+    fragile.insert(item);
+  }
+  catch(runtime_error&) {
+    threw = true;
+  }
+  FragileKey::armed = false;
+  fragile.insert(make_pair(FragileKey(3), 3)); // takes the freed handle, no new chunk
+  check("Throwing cold item keeps its handle", threw && fragile.size() == 256 && fragile.memoryUsage() == before);
+
+  cout << "slot bytes for int -> Blob: cold value slots " << ColdSlotSize::value()
+       << ", inline " << InlineSlotSize::value() << endl;
+  check("Cold value slots hold no value bytes", ColdSlotSize::value() == 20);
+}
+
+int main()
+{
+  testAgainstMap();
+  testSequential();
+  testStrings();
+  testFootprint();
+  testThrowingInsert();
+  testColdValues();
+  return failures;
+}
@@ -0,0 +1,1041 @@
+#ifndef COMPACT_AVL_H
+#define COMPACT_AVL_H
+
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+/**
+* Value type for a CompactAVLTree that stores keys only; see AVLSet.
+*/
+struct KeyOnly
+{
+};
+
+/*
+ * Slot layouts. A layout decides what a CompactAVLTree slot holds next to
+ * its links, the hot part every search reads, and where the item the
+ * iterators yield lives:
+ *
+ *   typedef ... type;                          what iterators yield
+ *   typedef ... hot;                           what a slot holds
+ *   static const Key& key(const hot&);         the key, read at every step
+ *   type& itemOf(hot&) const;                  the item behind a slot
+ *   void construct(hot* where, const Key&, const Value&);
+ *   void destroy(hot&);
+ *   static void relocate(hot* to, hot& from);  copies a slot when the pool grows
+ *   size_t memoryUsage() const;                bytes held outside the pool
+ */
+
+/**
+* The default layout: the whole item sits in the slot, a key/value pair
+* for a map or just the key when Value is KeyOnly.
+*/
+template <class Key, class Value>
+struct CompactSlotItem
+{
+    typedef std::pair<const Key, Value> type;
+    typedef type hot;
+    static const Key& key(const hot& item) { return item.first; }
+    type& itemOf(hot& item) const { return item; }
+    void construct(hot* where, const Key& key, const Value& value) { new (where) type(key, value); }
+    void destroy(hot& item) { item.~type(); }
+    static void relocate(hot* to, hot& from) { new ((void*)to) type(std::move_if_noexcept(from)); }
+    size_t memoryUsage() const { return 0; }
+};
+
+template <class Key>
+struct CompactSlotItem<Key, KeyOnly>
+{
+    typedef const Key type;
+    typedef type hot;
+    static const Key& key(const hot& item) { return item; }
+    type& itemOf(hot& item) const { return item; }
+    void construct(hot* where, const Key& key, const KeyOnly&) { new ((void*)where) Key(key); }
+    void destroy(hot& item) { item.~type(); }
+    static void relocate(hot* to, hot& from) { new ((void*)to) Key(from); }
+    size_t memoryUsage() const { return 0; }
+};
+
+/**
+* A layout for large values. The slot keeps only a copy of the key and a
+* 32-bit handle, and the items live in a slab of fixed size chunks, so a
+* search never pulls value bytes into cache: for an int key a slot is 20
+* bytes whatever the value's size. Reaching a value costs one more
+* indirection and the key is stored twice.
+*
+* Chunks never move, so unlike the default layout references to items
+* survive pool growth.
+*/
+template <class Key, class Value>
+class ColdValueSlots
+{
+public:
+    typedef std::pair<const Key, Value> type;
+    struct hot
+    {
+        hot(const Key& key_, uint32_t handle_) : key(key_), handle(handle_) {}
+        Key key;
+        uint32_t handle;
+    };
+
+    ColdValueSlots();
+    ~ColdValueSlots();
+    // The chunks are owned raw, so layouts are not copied.
+    ColdValueSlots(const ColdValueSlots&) = delete;
+    ColdValueSlots& operator=(const ColdValueSlots&) = delete;
+
+    static const Key& key(const hot& item) { return item.key; }
+    type& itemOf(hot& item) const;
+    void construct(hot* where, const Key& key, const Value& value);
+    void destroy(hot& item);
+    static void relocate(hot* to, hot& from);
+    size_t memoryUsage() const;
+
+protected:
+    static const uint32_t CHUNK_SHIFT = 8; // 256 items per chunk
+    static const uint32_t CHUNK_MASK = (1u << CHUNK_SHIFT) - 1;
+
+    type* at(uint32_t handle) const;
+
+    std::vector<type*> chunks_;  // raw storage, constructed up to used_
+    std::vector<uint32_t> free_; // handles of destroyed items
+    uint32_t used_;              // high water mark of handles handed out
+};
+
+/*
+  --------------------------------------------------
+  Begin implementations for the ColdValueSlots class.
+  --------------------------------------------------
+*/
+
+template<class Key, class Value>
+ColdValueSlots<Key, Value>::ColdValueSlots() : used_(0)
+{
+
+}
+
+/**
+* The tree destroys every item before its layout goes away, so only the
+* chunks are left to free.
+*/
+template<class Key, class Value>
+ColdValueSlots<Key, Value>::~ColdValueSlots()
+{
+    for(size_t i = 0; i < chunks_.size(); i++)
+    {
+        ::operator delete(chunks_[i]);
+    }
+}
+
+template<class Key, class Value>
+typename ColdValueSlots<Key, Value>::type* ColdValueSlots<Key, Value>::at(uint32_t handle) const
+{
+    return chunks_[handle >> CHUNK_SHIFT] + (handle & CHUNK_MASK);
+}
+
+template<class Key, class Value>
+typename ColdValueSlots<Key, Value>::type& ColdValueSlots<Key, Value>::itemOf(hot& item) const
+{
+    return *at(item.handle);
+}
+
+/**
+* Reuses the most recently freed handle, or takes the next one and adds
+* a chunk when the last is full. The handle is only taken once both the
+* item and its hot half are built, so a throwing copy hands nothing out.
+*/
+template<class Key, class Value>
+void ColdValueSlots<Key, Value>::construct(hot* where, const Key& key, const Value& value)
+{
+    bool reuse = !free_.empty();
+    uint32_t handle = reuse ? free_.back() : used_;
+    if(!reuse && (handle >> CHUNK_SHIFT) == chunks_.size())
+    {
+        chunks_.push_back(static_cast<type*>(::operator new(sizeof(type) << CHUNK_SHIFT)));
+    }
+    type* item = new ((void*)at(handle)) type(key, value);
+    try
+    {
+        new ((void*)where) hot(key, handle);
+    }
+    catch(...)
+    {
+        item->~type();
+        throw;
+    }
+    if(reuse)
+    {
+        free_.pop_back();
+    }
+    else
+    {
+        used_++;
+    }
+}
+
+template<class Key, class Value>
+void ColdValueSlots<Key, Value>::destroy(hot& item)
+{
+    at(item.handle)->~type();
+    free_.push_back(item.handle);
+    item.~hot();
+}
+
+template<class Key, class Value>
+void ColdValueSlots<Key, Value>::relocate(hot* to, hot& from)
+{
+    new ((void*)to) hot(std::move_if_noexcept(from));
+}
+
+template<class Key, class Value>
+size_t ColdValueSlots<Key, Value>::memoryUsage() const
+{
+    return chunks_.size() * (sizeof(type) << CHUNK_SHIFT) + chunks_.capacity() * sizeof(type*) +
+           free_.capacity() * sizeof(uint32_t);
+}
+
+/*
+  ------------------------------------------------
+  End implementations for the ColdValueSlots class.
+  ------------------------------------------------
+*/
+
+/**
+* An AVL tree whose nodes live in one contiguous pool and refer to each
+* other by 32-bit index instead of by pointer. There is no vptr and no
+* separate balance byte: the balance factor is packed into the top two
+* bits of the parent link. For an int -> int map a node is 20 bytes, versus
+* 48 bytes (plus allocator overhead) for an AVLNode.
+*
+* The interface mirrors AVLTree. Index 0 means "no node", and the 30 bit
+* parent field caps the tree at MAX_NODES entries. References returned by
+* operator[] or the iterator are invalidated when the pool grows (except
+* with ColdValueSlots); the iterators themselves stay valid until their
+* item is removed.
+*
+* Layout picks what a slot holds. CompactAVLTree<Key, Value,
+* ColdValueSlots<Key, Value> > keeps large values out of the pool so that
+* searches only walk small slots; the interface is the same either way.
+*/
+template <class Key, class Value, class Layout = CompactSlotItem<Key, Value> >
+class CompactAVLTree
+{
+public:
+    static const uint32_t MAX_NODES = (1u << 30) - 2;
+
+    CompactAVLTree();
+    ~CompactAVLTree();
+    // The pool is owned raw, so trees are not copied.
+    CompactAVLTree(const CompactAVLTree&) = delete;
+    CompactAVLTree& operator=(const CompactAVLTree&) = delete;
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool isBalanced() const;
+    bool empty() const;
+    size_t size() const;
+    size_t memoryUsage() const; // bytes reserved by the pool and the tree itself
+
+    class iterator
+    {
+    public:
+        iterator();
+
+        typename Layout::type& operator*() const;
+        typename Layout::type* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class CompactAVLTree<Key, Value, Layout>;
+        iterator(CompactAVLTree<Key, Value, Layout>* tree, uint32_t index);
+        CompactAVLTree<Key, Value, Layout>* tree_;
+        uint32_t index_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    typedef typename Layout::hot Hot;
+
+    // A pool slot. Free slots have a destroyed item, are marked by the
+    // FREE_MARK balance bits and chain through left.
+    struct Slot
+    {
+        Hot item;
+        uint32_t left;
+        uint32_t right;
+        uint32_t parentBalance; // balance + 1 in the top 2 bits, parent index below
+    };
+
+    static const uint32_t NIL = 0;
+    static const uint32_t PARENT_MASK = (1u << 30) - 1;
+    static const uint32_t FREE_MARK = 3u << 30;
+
+    // slot accessors
+    Slot& slot(uint32_t i) const;
+    uint32_t parentOf(uint32_t i) const;
+    void setParent(uint32_t i, uint32_t parent);
+    int balanceOf(uint32_t i) const;
+    void setBalance(uint32_t i, int balance);
+    void replaceChild(uint32_t parent, uint32_t oldChild, uint32_t newChild);
+
+    // pool management
+    uint32_t allocate(const Key& key, const Value& value, uint32_t parent);
+    void release(uint32_t i);
+    void grow();
+
+    // tree helpers
+    uint32_t internalFind(const Key& key) const;
+    uint32_t findOrInsert(const Key& key, const Value& value, bool& created); // single descent
+    uint32_t successor(uint32_t i) const;
+    void rotateLeft(uint32_t x);
+    void rotateRight(uint32_t x);
+    void insertFix(uint32_t parent, uint32_t child);
+    void removeFix(uint32_t parent, bool leftShrank);
+    int checkHeight(uint32_t i) const; // height, or -1 if a subtree is unbalanced
+
+protected:
+    Slot* pool_;
+    uint32_t capacity_; // slots allocated
+    uint32_t used_;     // high water mark, slots 1..used_ have been handed out
+    uint32_t freeHead_;
+    uint32_t root_;
+    uint32_t size_;
+    Layout layout_;
+};
+
+/*
+  -------------------------------------------------------------
+  Begin implementations for the CompactAVLTree::iterator class.
+  -------------------------------------------------------------
+*/
+
+template<class Key, class Value, class Layout>
+CompactAVLTree<Key, Value, Layout>::iterator::iterator() : tree_(nullptr), index_(NIL)
+{
+
+}
+
+template<class Key, class Value, class Layout>
+CompactAVLTree<Key, Value, Layout>::iterator::iterator(CompactAVLTree<Key, Value, Layout>* tree, uint32_t index) :
+    tree_(tree), index_(index)
+{
+
+}
+
+template<class Key, class Value, class Layout>
+typename Layout::type& CompactAVLTree<Key, Value, Layout>::iterator::operator*() const
+{
+    return tree_->layout_.itemOf(tree_->slot(index_).item);
+}
+
+template<class Key, class Value, class Layout>
+typename Layout::type* CompactAVLTree<Key, Value, Layout>::iterator::operator->() const
+{
+    return &tree_->layout_.itemOf(tree_->slot(index_).item);
+}
+
+/**
+* All end iterators compare equal, whichever tree they came from.
+*/
+template<class Key, class Value, class Layout>
+bool CompactAVLTree<Key, Value, Layout>::iterator::operator==(const iterator& rhs) const
+{
+    return index_ == rhs.index_ && (index_ == NIL || tree_ == rhs.tree_);
+}
+
+template<class Key, class Value, class Layout>
+bool CompactAVLTree<Key, Value, Layout>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+template<class Key, class Value, class Layout>
+typename CompactAVLTree<Key, Value, Layout>::iterator& CompactAVLTree<Key, Value, Layout>::iterator::operator++()
+{
+    index_ = tree_->successor(index_);
+    return *this;
+}
+
+/*
+  -----------------------------------------------------------
+  End implementations for the CompactAVLTree::iterator class.
+  -----------------------------------------------------------
+*/
+
+/*
+  ---------------------------------------------------
+  Begin implementations for the CompactAVLTree class.
+  ---------------------------------------------------
+*/
+
+template<class Key, class Value, class Layout>
+CompactAVLTree<Key, Value, Layout>::CompactAVLTree() :
+    pool_(nullptr), capacity_(0), used_(0), freeHead_(NIL), root_(NIL), size_(0)
+{
+
+}
+
+template<class Key, class Value, class Layout>
+CompactAVLTree<Key, Value, Layout>::~CompactAVLTree()
+{
+    clear();
+    ::operator delete(pool_);
+}
+
+template<class Key, class Value, class Layout>
+bool CompactAVLTree<Key, Value, Layout>::empty() const
+{
+    return root_ == NIL;
+}
+
+template<class Key, class Value, class Layout>
+size_t CompactAVLTree<Key, Value, Layout>::size() const
+{
+    return size_;
+}
+
+template<class Key, class Value, class Layout>
+size_t CompactAVLTree<Key, Value, Layout>::memoryUsage() const
+{
+    return sizeof(*this) + (size_t)capacity_ * sizeof(Slot) + layout_.memoryUsage();
+}
+
+/**
+* Slot i lives at pool_[i - 1] since index 0 is the null link.
+*/
+template<class Key, class Value, class Layout>
+typename CompactAVLTree<Key, Value, Layout>::Slot& CompactAVLTree<Key, Value, Layout>::slot(uint32_t i) const
+{
+    return pool_[i - 1];
+}
+
+template<class Key, class Value, class Layout>
+uint32_t CompactAVLTree<Key, Value, Layout>::parentOf(uint32_t i) const
+{
+    return slot(i).parentBalance & PARENT_MASK;
+}
+
+template<class Key, class Value, class Layout>
+void CompactAVLTree<Key, Value, Layout>::setParent(uint32_t i, uint32_t parent)
+{
+    slot(i).parentBalance = (slot(i).parentBalance & ~PARENT_MASK) | parent;
+}
+
+template<class Key, class Value, class Layout>
+int CompactAVLTree<Key, Value, Layout>::balanceOf(uint32_t i) const
+{
+    return (int)(slot(i).parentBalance >> 30) - 1;
+}
+
+template<class Key, class Value, class Layout>
+void CompactAVLTree<Key, Value, Layout>::setBalance(uint32_t i, int balance)
+{
+    slot(i).parentBalance = (slot(i).parentBalance & PARENT_MASK) | ((uint32_t)(balance + 1) << 30);
+}
+
+/**
+* Points parent's link (or the root) at newChild instead of oldChild.
+*/
+template<class Key, class Value, class Layout>
+void CompactAVLTree<Key, Value, Layout>::replaceChild(uint32_t parent, uint32_t oldChild, uint32_t newChild)
+{
+    if(parent == NIL)
+    {
+        root_ = newChild;
+    }
+    else if(slot(parent).left == oldChild)
+    {
+        slot(parent).left = newChild;
+    }
+    else
+    {
+        slot(parent).right = newChild;
+    }
+}
+
+/**
+* Takes a slot from the free list, or past the high water mark, and
+* constructs a balanced leaf in it. The slot is only claimed once the
+* item is built, so an item constructor that throws leaves the free list
+* and used_ as they were.
+*/
+template<class Key, class Value, class Layout>
+uint32_t CompactAVLTree<Key, Value, Layout>::allocate(const Key& key, const Value& value, uint32_t parent)
+{
+    uint32_t i = freeHead_;
+    if(i == NIL)
+    {
+        if(used_ == MAX_NODES)
+        {
+            throw std::length_error("CompactAVLTree is full");
+        }
+        if(used_ == capacity_)
+        {
+            grow();
+        }
+        i = used_ + 1;
+    }
+
+    Slot& s = slot(i);
+    layout_.construct(&s.item, key, value);
+    if(i == freeHead_)
+    {
+        freeHead_ = s.left;
+    }
+    else
+    {
+        used_ = i;
+    }
+    s.left = NIL;
+    s.right = NIL;
+    s.parentBalance = parent | (1u << 30);
+    size_++;
+    return i;
+}
+
+/**
+* Destroys the item and pushes the slot onto the free list.
+*/
+template<class Key, class Value, class Layout>
+void CompactAVLTree<Key, Value, Layout>::release(uint32_t i)
+{
+    Slot& s = slot(i);
+    layout_.destroy(s.item);
+    s.left = freeHead_;
+    s.parentBalance = FREE_MARK;
+    freeHead_ = i;
+    size_--;
+}
+
+/**
+* Doubles the pool. Live items are moved across, or copied when their move
+* may throw, and the old ones are only destroyed once every item is in
+* place, so a throwing copy leaves the tree as it was. Free slots only keep
+* their free list link.
+*/
+template<class Key, class Value, class Layout>
+void CompactAVLTree<Key, Value, Layout>::grow()
+{
+    uint32_t newCapacity = capacity_ == 0 ? 16 : (uint32_t)std::min<uint64_t>(2ull * capacity_, MAX_NODES);
+    Slot* newPool = static_cast<Slot*>(::operator new((size_t)newCapacity * sizeof(Slot)));
+
+    uint32_t i = 0;
+    try
+    {
+        for(; i < used_; i++)
+        {
+            Slot& from = pool_[i];
+            Slot& to = newPool[i];
+            if(from.parentBalance != FREE_MARK)
+            {
+                Layout::relocate(&to.item, from.item);
+            }
+            to.left = from.left;
+            to.right = from.right;
+            to.parentBalance = from.parentBalance;
+        }
+    }
+    catch(...)
+    {
+        while(i-- > 0)
+        {
+            if(newPool[i].parentBalance != FREE_MARK)
+            {
+                newPool[i].item.~Hot();
+            }
+        }
+        ::operator delete(newPool);
+        throw;
+    }
+
+    for(i = 0; i < used_; i++)
+    {
+        if(pool_[i].parentBalance != FREE_MARK)
+        {
+            pool_[i].item.~Hot();
+        }
+    }
+    ::operator delete(pool_);
+    pool_ = newPool;
+    capacity_ = newCapacity;
+}
+
+/**
+* Destroys every item. The pool is kept for reuse.
+*/
+template<class Key, class Value, class Layout>
+void CompactAVLTree<Key, Value, Layout>::clear()
+{
+    for(uint32_t i = 1; i <= used_; i++)
+    {
+        if(slot(i).parentBalance != FREE_MARK)
+        {
+            layout_.destroy(slot(i).item);
+        }
+    }
+    used_ = 0;
+    freeHead_ = NIL;
+    root_ = NIL;
+    size_ = 0;
+}
+
+template<class Key, class Value, class Layout>
+uint32_t CompactAVLTree<Key, Value, Layout>::internalFind(const Key& key) const
+{
+    uint32_t current = root_;
+    while(current != NIL)
+    {
+        const Slot& s = slot(current);
+        if(key < Layout::key(s.item))
+        {
+            current = s.left;
+        }
+        else if(Layout::key(s.item) < key)
+        {
+            current = s.right;
+        }
+        else
+        {
+            return current;
+        }
+    }
+    return NIL;
+}
+
+template<class Key, class Value, class Layout>
+uint32_t CompactAVLTree<Key, Value, Layout>::successor(uint32_t i) const
+{
+    if(i == NIL)
+    {
+        return NIL;
+    }
+
+    if(slot(i).right != NIL)
+    {
+        i = slot(i).right;
+        while(slot(i).left != NIL)
+        {
+            i = slot(i).left;
+        }
+        return i;
+    }
+
+    uint32_t parent = parentOf(i);
+    while(parent != NIL && slot(parent).right == i)
+    {
+        i = parent;
+        parent = parentOf(parent);
+    }
+    return parent;
+}
+
+template<class Key, class Value, class Layout>
+void CompactAVLTree<Key, Value, Layout>::rotateLeft(uint32_t x)
+{
+    uint32_t y = slot(x).right;
+    uint32_t b = slot(y).left;
+    uint32_t parent = parentOf(x);
+
+    slot(x).right = b;
+    if(b != NIL)
+    {
+        setParent(b, x);
+    }
+    setParent(y, parent);
+    replaceChild(parent, x, y);
+    slot(y).left = x;
+    setParent(x, y);
+}
+
+template<class Key, class Value, class Layout>
+void CompactAVLTree<Key, Value, Layout>::rotateRight(uint32_t x)
+{
+    uint32_t y = slot(x).left;
+    uint32_t b = slot(y).right;
+    uint32_t parent = parentOf(x);
+
+    slot(x).left = b;
+    if(b != NIL)
+    {
+        setParent(b, x);
+    }
+    setParent(y, parent);
+    replaceChild(parent, x, y);
+    slot(y).right = x;
+    setParent(x, y);
+}
+
+template<class Key, class Value, class Layout>
+void CompactAVLTree<Key, Value, Layout>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    bool created;
+    uint32_t node = findOrInsert(keyValuePair.first, keyValuePair.second, created);
+    if(!created)
+    {
+        layout_.itemOf(slot(node).item).second = keyValuePair.second;
+    }
+}
+
+/**
+* Returns the slot holding key, adding (key, value) first if it is
+* missing. created tells the two cases apart.
+*/
+template<class Key, class Value, class Layout>
+uint32_t CompactAVLTree<Key, Value, Layout>::findOrInsert(const Key& key, const Value& value, bool& created)
+{
+    created = true;
+    if(root_ == NIL)
+    {
+        root_ = allocate(key, value, NIL);
+        return root_;
+    }
+
+    uint32_t current = root_;
+    uint32_t parent = NIL;
+    bool goLeft = false;
+    while(current != NIL)
+    {
+        parent = current;
+        const Slot& s = slot(current);
+        if(key < Layout::key(s.item))
+        {
+            current = s.left;
+            goLeft = true;
+        }
+        else if(Layout::key(s.item) < key)
+        {
+            current = s.right;
+            goLeft = false;
+        }
+        else
+        {
+            created = false;
+            return current;
+        }
+    }
+
+    // allocate may move the pool, so only use indices across it
+    uint32_t node = allocate(key, value, parent);
+    if(goLeft)
+    {
+        slot(parent).left = node;
+    }
+    else
+    {
+        slot(parent).right = node;
+    }
+    insertFix(parent, node);
+    return node;
+}
+
+/**
+* Retraces from a newly grown child up towards the root, rotating at the
+* first node that goes out of balance.
+*/
+template<class Key, class Value, class Layout>
+void CompactAVLTree<Key, Value, Layout>::insertFix(uint32_t parent, uint32_t child)
+{
+    while(parent != NIL)
+    {
+        int balance = balanceOf(parent) + (slot(parent).left == child ? -1 : 1);
+        setBalance(parent, balance);
+
+        if(balance == 0)
+        {
+            return;
+        }
+        if(balance == -1 || balance == 1)
+        {
+            child = parent;
+            parent = parentOf(parent);
+            continue;
+        }
+
+        if(balance == -2)
+        {
+            if(balanceOf(child) == -1) // zig-zig
+            {
+                rotateRight(parent);
+                setBalance(parent, 0);
+                setBalance(child, 0);
+            }
+            else // zig-zag
+            {
+                uint32_t grandchild = slot(child).right;
+                int g = balanceOf(grandchild);
+                rotateLeft(child);
+                rotateRight(parent);
+                setBalance(child, g == 1 ? -1 : 0);
+                setBalance(parent, g == -1 ? 1 : 0);
+                setBalance(grandchild, 0);
+            }
+        }
+        else
+        {
+            if(balanceOf(child) == 1) // zig-zig
+            {
+                rotateLeft(parent);
+                setBalance(parent, 0);
+                setBalance(child, 0);
+            }
+            else // zig-zag
+            {
+                uint32_t grandchild = slot(child).left;
+                int g = balanceOf(grandchild);
+                rotateRight(child);
+                rotateLeft(parent);
+                setBalance(child, g == -1 ? 1 : 0);
+                setBalance(parent, g == 1 ? -1 : 0);
+                setBalance(grandchild, 0);
+            }
+        }
+        return;
+    }
+}
+
+/*
+ * A node with two children is replaced by its predecessor, which is
+ * relinked into its place (no items are copied), then the removal is
+ * retraced from the deepest changed node.
+ */
+template<class Key, class Value, class Layout>
+void CompactAVLTree<Key, Value, Layout>::remove(const Key& key)
+{
+    uint32_t node = internalFind(key);
+    if(node == NIL)
+    {
+        return;
+    }
+
+    uint32_t parent = parentOf(node);
+    uint32_t left = slot(node).left;
+    uint32_t right = slot(node).right;
+
+    if(left == NIL || right == NIL)
+    {
+        uint32_t child = (left != NIL) ? left : right;
+        bool wasLeft = parent != NIL && slot(parent).left == node;
+        if(child != NIL)
+        {
+            setParent(child, parent);
+        }
+        replaceChild(parent, node, child);
+        release(node);
+        removeFix(parent, wasLeft);
+        return;
+    }
+
+    // predecessor is the rightmost node of the left subtree
+    uint32_t pred = left;
+    while(slot(pred).right != NIL)
+    {
+        pred = slot(pred).right;
+    }
+
+    uint32_t fixFrom;
+    bool leftShrank;
+    if(pred == left)
+    {
+        // pred moves up one level and keeps its own left subtree
+        fixFrom = pred;
+        leftShrank = true;
+    }
+    else
+    {
+        uint32_t predParent = parentOf(pred);
+        uint32_t predLeft = slot(pred).left;
+        slot(predParent).right = predLeft;
+        if(predLeft != NIL)
+        {
+            setParent(predLeft, predParent);
+        }
+        slot(pred).left = left;
+        setParent(left, pred);
+        fixFrom = predParent;
+        leftShrank = false;
+    }
+
+    slot(pred).right = right;
+    setParent(right, pred);
+    setParent(pred, parent);
+    setBalance(pred, balanceOf(node));
+    replaceChild(parent, node, pred);
+    release(node);
+    removeFix(fixFrom, leftShrank);
+}
+
+/**
+* Retraces a height decrease on one side of parent. Stops as soon as a
+* subtree keeps its height.
+*/
+template<class Key, class Value, class Layout>
+void CompactAVLTree<Key, Value, Layout>::removeFix(uint32_t parent, bool leftShrank)
+{
+    while(parent != NIL)
+    {
+        int balance = balanceOf(parent) + (leftShrank ? 1 : -1);
+        uint32_t top = parent; // root of this subtree after any rotation
+
+        if(balance == 1 || balance == -1)
+        {
+            setBalance(parent, balance);
+            return;
+        }
+        else if(balance == 2)
+        {
+            uint32_t child = slot(parent).right;
+            int c = balanceOf(child);
+            if(c == -1) // zig-zag
+            {
+                uint32_t grandchild = slot(child).left;
+                int g = balanceOf(grandchild);
+                rotateRight(child);
+                rotateLeft(parent);
+                setBalance(parent, g == 1 ? -1 : 0);
+                setBalance(child, g == -1 ? 1 : 0);
+                setBalance(grandchild, 0);
+                top = grandchild;
+            }
+            else
+            {
+                rotateLeft(parent);
+                if(c == 0)
+                {
+                    setBalance(parent, 1);
+                    setBalance(child, -1);
+                    return; // height unchanged
+                }
+                setBalance(parent, 0);
+                setBalance(child, 0);
+                top = child;
+            }
+        }
+        else if(balance == -2)
+        {
+            uint32_t child = slot(parent).left;
+            int c = balanceOf(child);
+            if(c == 1) // zig-zag
+            {
+                uint32_t grandchild = slot(child).right;
+                int g = balanceOf(grandchild);
+                rotateLeft(child);
+                rotateRight(parent);
+                setBalance(parent, g == -1 ? 1 : 0);
+                setBalance(child, g == 1 ? -1 : 0);
+                setBalance(grandchild, 0);
+                top = grandchild;
+            }
+            else
+            {
+                rotateRight(parent);
+                if(c == 0)
+                {
+                    setBalance(parent, -1);
+                    setBalance(child, 1);
+                    return; // height unchanged
+                }
+                setBalance(parent, 0);
+                setBalance(child, 0);
+                top = child;
+            }
+        }
+        else
+        {
+            setBalance(parent, 0);
+        }
+
+        // this subtree got shorter, continue with its parent
+        parent = parentOf(top);
+        leftShrank = parent != NIL && slot(parent).left == top;
+    }
+}
+
+template<class Key, class Value, class Layout>
+int CompactAVLTree<Key, Value, Layout>::checkHeight(uint32_t i) const
+{
+    if(i == NIL)
+    {
+        return 0;
+    }
+    int left = checkHeight(slot(i).left);
+    int right = checkHeight(slot(i).right);
+    if(left < 0 || right < 0 || std::abs(left - right) > 1)
+    {
+        return -1;
+    }
+    return 1 + std::max(left, right);
+}
+
+template<class Key, class Value, class Layout>
+bool CompactAVLTree<Key, Value, Layout>::isBalanced() const
+{
+    return checkHeight(root_) >= 0;
+}
+
+template<class Key, class Value, class Layout>
+typename CompactAVLTree<Key, Value, Layout>::iterator CompactAVLTree<Key, Value, Layout>::begin() const
+{
+    uint32_t i = root_;
+    while(i != NIL && slot(i).left != NIL)
+    {
+        i = slot(i).left;
+    }
+    return iterator(const_cast<CompactAVLTree<Key, Value, Layout>*>(this), i);
+}
+
+template<class Key, class Value, class Layout>
+typename CompactAVLTree<Key, Value, Layout>::iterator CompactAVLTree<Key, Value, Layout>::end() const
+{
+    return iterator(const_cast<CompactAVLTree<Key, Value, Layout>*>(this), NIL);
+}
+
+template<class Key, class Value, class Layout>
+typename CompactAVLTree<Key, Value, Layout>::iterator CompactAVLTree<Key, Value, Layout>::find(const Key& key) const
+{
+    return iterator(const_cast<CompactAVLTree<Key, Value, Layout>*>(this), internalFind(key));
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<class Key, class Value, class Layout>
+Value& CompactAVLTree<Key, Value, Layout>::operator[](const Key& key)
+{
+    uint32_t i = internalFind(key);
+    if(i == NIL) throw std::out_of_range("Invalid key");
+    return layout_.itemOf(slot(i).item).second;
+}
+
+template<class Key, class Value, class Layout>
+Value const & CompactAVLTree<Key, Value, Layout>::operator[](const Key& key) const
+{
+    uint32_t i = internalFind(key);
+    if(i == NIL) throw std::out_of_range("Invalid key");
+    return layout_.itemOf(slot(i).item).second;
+}
+
+/*
+  -------------------------------------------------
+  End implementations for the CompactAVLTree class.
+  -------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,353 @@
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "bst.h"
+#include "avlbst.h"
+#include "test_check.h"
+using namespace std;
+
+// Complexity regression suite. Every operation is timed over a range of
+// tree sizes n = 2^k, and the slope of log(time per unit) against log(n)
+// is checked against the operation's class: about 0 for O(1) and
+// O(log n) per op, about 1 for O(n), 2 for O(n^2). The classes are far
+// enough apart that the bounds below leave room for cache effects, but
+// timing cannot tell O(1) from O(log n); search ops are also checked
+// exactly by counting key comparisons against the AVL height bound, and
+// the walks (iterator++, begin, clear, isBalanced) by counting the links
+// they follow. make check-complexity runs everything. The timings are at
+// the mercy of the machine's load, so the build itself only runs the
+// exact counts (complexity-test --counts).
+
+const double SUBLINEAR_MAX = 0.6; // O(1) and O(log n) per op
+const double LINEAR_MIN = 0.6;
+const double LINEAR_MAX = 1.6;
+const double SIZE_BUDGET_MS = 2000; // one measurement slower than this ends the series
+
+// A key that counts its comparisons.
+struct CountedKey
+{
+  static unsigned long long comparisons;
+  CountedKey(int k = 0) : key(k) {}
+  bool operator<(const CountedKey& rhs) const { comparisons++; return key < rhs.key; }
+  bool operator>(const CountedKey& rhs) const { comparisons++; return key > rhs.key; }
+  bool operator==(const CountedKey& rhs) const { comparisons++; return key == rhs.key; }
+  int key;
+};
+unsigned long long CountedKey::comparisons = 0;
+
+ostream& operator<<(ostream& out, const CountedKey& k)
+{
+  return out << k.key;
+}
+
+enum Order { SORTED, REVERSED, RANDOM };
+const char* ORDER_NAMES[] = { "sorted", "reversed", "random" };
+
+vector<int> keysInOrder(size_t n, Order order)
+{
+  vector<int> keys(n);
+  for(size_t i = 0; i < n; i++) keys[i] = (int)i;
+  if(order == REVERSED) reverse(keys.begin(), keys.end());
+  if(order == RANDOM) shuffle(keys.begin(), keys.end(), mt19937(46));
+  return keys;
+}
+
+typedef chrono::steady_clock Clock;
+
+double elapsedNs(Clock::time_point start)
+{
+  return chrono::duration<double, nano>(Clock::now() - start).count();
+}
+
+volatile long sink;
+
+// Time of one measurement on a tree of size n, in ns per unit of work.
+typedef double (*Measure)(size_t n, Order order);
+
+template<typename Tree>
+double insertEach(size_t n, Order order)
+{
+  vector<int> keys = keysInOrder(n, order);
+  Tree tree;
+  Clock::time_point start = Clock::now();
+  for(size_t i = 0; i < n; i++) tree.insert(make_pair(keys[i], keys[i]));
+  return elapsedNs(start) / n;
+}
+
+template<typename Tree>
+double findEach(size_t n, Order order)
+{
+  vector<int> keys = keysInOrder(n, order);
+  Tree tree;
+  for(size_t i = 0; i < n; i++) tree.insert(make_pair(keys[i], keys[i]));
+  long sum = 0;
+  Clock::time_point start = Clock::now();
+  for(size_t i = 0; i < n; i++) sum += tree.find(keys[i])->second;
+  double ns = elapsedNs(start) / n;
+  sink = sum;
+  return ns;
+}
+
+template<typename Tree>
+double removeEach(size_t n, Order order)
+{
+  vector<int> keys = keysInOrder(n, order);
+  Tree tree;
+  for(size_t i = 0; i < n; i++) tree.insert(make_pair(keys[i], keys[i]));
+  Clock::time_point start = Clock::now();
+  for(size_t i = 0; i < n; i++) tree.remove(keys[i]);
+  return elapsedNs(start) / n;
+}
+
+// per increment
+template<typename Tree>
+double iterateAll(size_t n, Order order)
+{
+  vector<int> keys = keysInOrder(n, order);
+  Tree tree;
+  for(size_t i = 0; i < n; i++) tree.insert(make_pair(keys[i], keys[i]));
+  long sum = 0;
+  Clock::time_point start = Clock::now();
+  for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it) sum += it->second;
+  double ns = elapsedNs(start) / n;
+  sink = sum;
+  return ns;
+}
+
+// per call
+template<typename Tree>
+double beginCalls(size_t n, Order order)
+{
+  vector<int> keys = keysInOrder(n, order);
+  Tree tree;
+  for(size_t i = 0; i < n; i++) tree.insert(make_pair(keys[i], keys[i]));
+  const int calls = 1000;
+  long sum = 0;
+  Clock::time_point start = Clock::now();
+  for(int i = 0; i < calls; i++) sum += tree.begin()->second;
+  double ns = elapsedNs(start) / calls;
+  sink = sum;
+  return ns;
+}
+
+// whole call
+template<typename Tree>
+double clearAll(size_t n, Order order)
+{
+  vector<int> keys = keysInOrder(n, order);
+  Tree tree;
+  for(size_t i = 0; i < n; i++) tree.insert(make_pair(keys[i], keys[i]));
+  Clock::time_point start = Clock::now();
+  tree.clear();
+  return elapsedNs(start);
+}
+
+template<typename Tree>
+double isBalancedAll(size_t n, Order order)
+{
+  vector<int> keys = keysInOrder(n, order);
+  Tree tree;
+  for(size_t i = 0; i < n; i++) tree.insert(make_pair(keys[i], keys[i]));
+  Clock::time_point start = Clock::now();
+  sink = tree.isBalanced();
+  return elapsedNs(start);
+}
+
+// Least squares slope of log(ns) over log(n), taking the fastest of three
+// trials per size to shed scheduler noise. Returns a huge slope if a
+// measurement runs past the budget, which only a drift can cause.
+double slopeOf(Measure measure, Order order, int minExp, int maxExp)
+{
+  vector<double> xs, ys;
+  for(int e = minExp; e <= maxExp; e++) {
+    size_t n = (size_t)1 << e;
+    double best = 0;
+    for(int trial = 0; trial < 3; trial++) {
+      Clock::time_point start = Clock::now();
+      double ns = measure(n, order);
+      if(trial == 0 || ns < best) best = ns;
+      if(elapsedNs(start) > SIZE_BUDGET_MS * 1e6) return 99;
+    }
+    xs.push_back(log((double)n));
+    ys.push_back(log(max(best, 0.1)));
+  }
+  double mx = 0, my = 0;
+  for(size_t i = 0; i < xs.size(); i++) {
+    mx += xs[i];
+    my += ys[i];
+  }
+  mx /= xs.size();
+  my /= xs.size();
+  double sxy = 0, sxx = 0;
+  for(size_t i = 0; i < xs.size(); i++) {
+    sxy += (xs[i] - mx) * (ys[i] - my);
+    sxx += (xs[i] - mx) * (xs[i] - mx);
+  }
+  return sxy / sxx;
+}
+
+// what names the expected class in the output
+void expectSublinear(const string& name, const string& what, Measure measure, Order order, int minExp = 10, int maxExp = 16)
+{
+  double slope = slopeOf(measure, order, minExp, maxExp);
+  cout << fixed << setprecision(2) << "  slope " << slope << endl;
+  check(name + " " + ORDER_NAMES[order] + " is " + what, slope < SUBLINEAR_MAX);
+}
+
+// Whole-tree passes stop at a smaller size, past which the random order's
+// cache misses steepen the curve.
+void expectLinear(const string& name, Measure measure, Order order, int minExp = 8, int maxExp = 15)
+{
+  double slope = slopeOf(measure, order, minExp, maxExp);
+  cout << fixed << setprecision(2) << "  slope " << slope << endl;
+  check(name + " " + ORDER_NAMES[order] + " is O(n)", slope >= LINEAR_MIN && slope < LINEAR_MAX);
+}
+
+typedef AVLTree<int, int> Avl;
+typedef BinarySearchTree<int, int> Bst;
+
+void testAvlTimings()
+{
+  for(int o = SORTED; o <= RANDOM; o++) {
+    Order order = (Order)o;
+    expectSublinear("AVLTree insert", "O(log n)", insertEach<Avl>, order);
+    expectSublinear("AVLTree find", "O(log n)", findEach<Avl>, order);
+    expectSublinear("AVLTree remove", "O(log n)", removeEach<Avl>, order);
+    expectSublinear("AVLTree iterator++", "amortized O(1)", iterateAll<Avl>, order);
+    expectSublinear("AVLTree begin", "O(log n)", beginCalls<Avl>, order);
+    expectLinear("AVLTree clear", clearAll<Avl>, order);
+    expectLinear("AVLTree isBalanced", isBalancedAll<Avl>, order);
+  }
+}
+
+void testBstTimings()
+{
+  // only random keys keep a plain BST logarithmic
+  expectSublinear("BinarySearchTree insert", "O(log n)", insertEach<Bst>, RANDOM);
+  expectSublinear("BinarySearchTree find", "O(log n)", findEach<Bst>, RANDOM);
+  expectSublinear("BinarySearchTree remove", "O(log n)", removeEach<Bst>, RANDOM);
+  expectSublinear("BinarySearchTree iterator++", "amortized O(1)", iterateAll<Bst>, RANDOM);
+  // a plain BST fed sorted keys is a list, so the suite must see O(n) per op
+  expectLinear("BinarySearchTree insert (detector check)", insertEach<Bst>, SORTED, 8, 12);
+}
+
+// Exact check: with the height bound 1.44 log2(n + 2), a search in an
+// AVL tree makes at most two comparisons per level.
+void testComparisonCounts()
+{
+  const size_t n = 1 << 16;
+  unsigned long long bound = (unsigned long long)(2 * 1.4405 * log2((double)n + 2)) + 2;
+  for(int o = SORTED; o <= RANDOM; o++) {
+    vector<int> keys = keysInOrder(n, (Order)o);
+    AVLTree<CountedKey, int> tree;
+    unsigned long long insertMax = 0, findMax = 0, removeMax = 0;
+    for(size_t i = 0; i < n; i++) {
+      unsigned long long before = CountedKey::comparisons;
+      tree.insert(make_pair(CountedKey(keys[i]), keys[i]));
+      insertMax = max(insertMax, CountedKey::comparisons - before);
+    }
+    for(size_t i = 0; i < n; i++) {
+      unsigned long long before = CountedKey::comparisons;
+      tree.find(CountedKey(keys[i]));
+      findMax = max(findMax, CountedKey::comparisons - before);
+    }
+    for(size_t i = 0; i < n; i++) {
+      unsigned long long before = CountedKey::comparisons;
+      tree.remove(CountedKey(keys[i]));
+      removeMax = max(removeMax, CountedKey::comparisons - before);
+    }
+    cout << "  max comparisons insert " << insertMax << " find " << findMax << " remove " << removeMax
+         << " (bound " << bound << ")" << endl;
+    check(string("AVLTree comparisons ") + ORDER_NAMES[o] + " within height bound",
+          insertMax <= bound && findMax <= bound && removeMax <= bound);
+  }
+}
+
+// A node that counts every link it hands out, so whole-tree walks can be
+// bounded by exact step counts instead of timings.
+struct CountingNode : public AVLNode<int, int>
+{
+  static unsigned long long steps;
+  static unsigned long long deleted;
+  CountingNode(const int& key, const int& value, AVLNode<int, int>* parent) : AVLNode<int, int>(key, value, parent) {}
+  ~CountingNode() { deleted++; }
+  AVLNode<int, int>* getParent() const override { steps++; return AVLNode<int, int>::getParent(); }
+  AVLNode<int, int>* getLeft() const override { steps++; return AVLNode<int, int>::getLeft(); }
+  AVLNode<int, int>* getRight() const override { steps++; return AVLNode<int, int>::getRight(); }
+};
+unsigned long long CountingNode::steps = 0;
+unsigned long long CountingNode::deleted = 0;
+
+class CountingTree : public AVLTree<int, int>
+{
+protected:
+  AVLNode<int, int>* createNode(const int& key, const int& value, AVLNode<int, int>* parent) override
+  {
+    return new CountingNode(key, value, parent);
+  }
+};
+
+// Exact check of the walks: begin() follows one path, a full iteration
+// crosses each link a bounded number of times, and clear() and
+// isBalanced() visit each node a bounded number of times. A step along a
+// path reads a few links: up to three per level for begin(), whose
+// recursion also checks each level's parent, and two for iterator++.
+void testStepCounts()
+{
+  const size_t n = 1 << 16;
+  unsigned long long height = (unsigned long long)(1.4405 * log2((double)n + 2));
+  for(int o = SORTED; o <= RANDOM; o++) {
+    vector<int> keys = keysInOrder(n, (Order)o);
+    CountingTree tree;
+    for(size_t i = 0; i < n; i++) tree.insert(make_pair(keys[i], keys[i]));
+
+    unsigned long long before = CountingNode::steps;
+    CountingTree::iterator it = tree.begin();
+    unsigned long long beginSteps = CountingNode::steps - before;
+
+    unsigned long long incrementMax = 0;
+    before = CountingNode::steps;
+    size_t items = 0;
+    while(it != tree.end()) {
+      unsigned long long start = CountingNode::steps;
+      ++it;
+      items++;
+      incrementMax = max(incrementMax, CountingNode::steps - start);
+    }
+    unsigned long long iterateSteps = CountingNode::steps - before;
+
+    before = CountingNode::steps;
+    bool balanced = tree.isBalanced();
+    unsigned long long balancedSteps = CountingNode::steps - before;
+
+    before = CountingNode::steps;
+    unsigned long long deletedBefore = CountingNode::deleted;
+    tree.clear();
+    unsigned long long clearSteps = CountingNode::steps - before;
+    unsigned long long cleared = CountingNode::deleted - deletedBefore;
+
+    cout << "  steps begin " << beginSteps << " (height " << height << "), iterate " << iterateSteps
+         << " (max " << incrementMax << "), isBalanced " << balancedSteps << ", clear " << clearSteps
+         << " for n " << n << endl;
+    check(string("AVLTree begin ") + ORDER_NAMES[o] + " follows one path", beginSteps <= 3 * height + 2);
+    check(string("AVLTree iterator++ ") + ORDER_NAMES[o] + " is amortized O(1)",
+          items == n && iterateSteps <= 6 * n && incrementMax <= 2 * height + 2);
+    check(string("AVLTree isBalanced ") + ORDER_NAMES[o] + " is O(n)", balanced && balancedSteps <= 3 * n);
+    check(string("AVLTree clear ") + ORDER_NAMES[o] + " is O(n)", cleared == n && clearSteps <= 3 * n);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  testComparisonCounts();
+  testStepCounts();
+  if(argc > 1 && string(argv[1]) == "--counts") return failures;
+  testAvlTimings();
+  testBstTimings();
+  return failures;
+}
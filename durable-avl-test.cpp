@@ -0,0 +1,247 @@
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+#include <thread>
+#include "durable_avl.h"
+#include "test_check.h"
+using namespace std;
+
+typedef DurableAVLTree<int, string> Durable;
+
+const char* LOG_PATH = "durable-avl-test.wal";
+
+void removeFiles()
+{
+  std::remove(LOG_PATH);
+  std::remove((string(LOG_PATH) + ".snapshot").c_str());
+}
+
+// Does the reopened tree hold exactly ref?
+bool matches(const Durable& t, const map<int, string>& ref)
+{
+  map<int, string>::const_iterator r = ref.begin();
+  for(Durable::iterator it = t.begin(); it != t.end(); ++it, ++r) {
+    if(r == ref.end() || r->first != it->first || r->second != it->second) return false;
+  }
+  return r == ref.end() && t.isBalanced();
+}
+
+void testReplay()
+{
+  removeFiles();
+  map<int, string> ref;
+  {
+    Durable t(LOG_PATH);
+    for(int i = 0; i < 200; i++) {
+      t.insert(make_pair(i % 50, to_string(i)));
+      ref[i % 50] = to_string(i);
+    }
+    for(int i = 0; i < 50; i += 3) {
+      t.remove(i);
+      ref.erase(i);
+    }
+  }
+  Durable t(LOG_PATH);
+  check("Replay restores the tree", matches(t, ref));
+  string v;
+  check("Get after replay", t.get(49, v) && v == "199" && !t.contains(0));
+}
+
+void testCheckpoint()
+{
+  removeFiles();
+  map<int, string> ref;
+  {
+    Durable t(LOG_PATH, false);
+    for(int i = 0; i < 1000; i++) {
+      t.insert(make_pair(i, "a"));
+      ref[i] = "a";
+    }
+    t.checkpoint();
+    check("Checkpoint empties the log", t.logBytes() == 0);
+    t.remove(5);
+    ref.erase(5);
+    t.insert(make_pair(1000, "b"));
+    ref[1000] = "b";
+    t.flush();
+  }
+  {
+    Durable t(LOG_PATH, false);
+    check("Snapshot plus log", matches(t, ref));
+  }
+
+  {
+    Durable t(LOG_PATH, false, 4096);
+    for(int i = 0; i < 2000; i++) {
+      t.insert(make_pair(i % 300, to_string(i)));
+      ref[i % 300] = to_string(i);
+    }
+    check("Automatic checkpoint bounds the log", t.logBytes() <= 4096);
+  }
+  {
+    // writers that cross the threshold together share one snapshot
+    Durable t(LOG_PATH, true, 4096);
+    size_t before = t.logBytes();
+    t.remove(-1);
+    check("Removing a missing key logs nothing", t.logBytes() == before);
+    vector<thread> writers;
+    for(int w = 0; w < 4; w++) {
+      writers.push_back(thread([&t, w]() {
+        for(int i = 0; i < 500; i++) t.insert(make_pair(300 + w * 500 + i, "c"));
+      }));
+    }
+    for(size_t w = 0; w < writers.size(); w++) writers[w].join();
+    for(int i = 300; i < 2300; i++) ref[i] = "c";
+    // about 24 bytes a record, so a snapshot per ~170 inserts
+    cout << "  2000 inserts, " << t.checkpoints() << " checkpoints" << endl;
+    check("One snapshot per threshold crossing", t.checkpoints() <= 2000 * 24 / 4096 + 2);
+  }
+  Durable t(LOG_PATH);
+  check("Replay after automatic checkpoints", matches(t, ref));
+}
+
+void testTornTail()
+{
+  removeFiles();
+  map<int, string> ref;
+  {
+    Durable t(LOG_PATH);
+    for(int i = 0; i < 10; i++) {
+      t.insert(make_pair(i, "x"));
+      ref[i] = "x";
+    }
+  }
+  {
+    // half a record, as a crash in the middle of a write would leave
+    ofstream out(LOG_PATH, ios::app | ios::binary);
+    out.write("\x20\x00\x00\x00\x01\x02", 6);
+  }
+  {
+    Durable t(LOG_PATH);
+    check("Torn tail is ignored", matches(t, ref));
+    t.insert(make_pair(10, "y"));
+    ref[10] = "y";
+  }
+  Durable t(LOG_PATH);
+  check("Writes after a torn tail replay", matches(t, ref));
+}
+
+// Reaches the checkpoint internals.
+class TestDurable : public Durable
+{
+public:
+  TestDurable(const char* path) : Durable(path, false) {}
+  // What a failed log write leaves behind: every later log() throws.
+  void breakLog()
+  {
+    lock_guard<mutex> lock(logMutex_);
+    failed_ = true;
+  }
+  // A writer that saw the log past the threshold.
+  void autoCheckpoint() { runCheckpoint(true); }
+  // Removes keys and checkpoints as one step, with the removes still in
+  // the pending batch when the snapshot is written, and stops after the
+  // rename as a crash before the log is truncated would.
+  void removeAndCrashAfterRename(const vector<int>& keys)
+  {
+    lock_guard<mutex> treeLock(treeMutex_);
+    unique_lock<mutex> lock(logMutex_);
+    committed_.wait(lock, [this]() { return !writing_; });
+    for(size_t i = 0; i < keys.size(); i++) {
+      AVLTree<int, string>::remove(keys[i]);
+      appendRecord(OP_REMOVE, keys[i], nullptr, pending_);
+      appended_++;
+    }
+    writeSnapshot();
+    pending_.clear(); // lost with the process
+  }
+};
+
+void testCrashBeforeTruncate()
+{
+  removeFiles();
+  map<int, string> ref;
+  {
+    TestDurable t(LOG_PATH);
+    for(int i = 0; i < 100; i++) {
+      t.insert(make_pair(i, "a"));
+      ref[i] = "a";
+    }
+    t.flush();
+    vector<int> doomed;
+    for(int i = 0; i < 100; i += 2) {
+      doomed.push_back(i);
+      ref.erase(i);
+    }
+    t.removeAndCrashAfterRename(doomed);
+  }
+  Durable t(LOG_PATH);
+  check("Crash between snapshot rename and log truncate", matches(t, ref));
+}
+
+void testAutoCheckpointOnce()
+{
+  removeFiles();
+  TestDurable t(LOG_PATH);
+  for(int i = 0; i < 100; i++) t.insert(make_pair(i, "a"));
+  t.autoCheckpoint();
+  t.autoCheckpoint(); // a second writer arriving after the first one's snapshot
+  check("Automatic checkpoint re-checks the threshold", t.checkpoints() == 1 && t.logBytes() == 0);
+}
+
+void testFailedLog()
+{
+  removeFiles();
+  TestDurable t(LOG_PATH);
+  t.insert(make_pair(1, "a"));
+  t.insert(make_pair(2, "b"));
+  t.flush();
+  t.breakLog();
+  int thrown = 0;
+  try { t.insert(make_pair(3, "c")); } catch(runtime_error&) { thrown++; }
+  try { t.insert(make_pair(1, "z")); } catch(runtime_error&) { thrown++; }
+  try { t.remove(2); } catch(runtime_error&) { thrown++; }
+  string one;
+  check("Failed log leaves the tree unchanged", thrown == 3 && !t.contains(3) && t.get(1, one) && one == "a" &&
+        t.contains(2) && t.isBalanced());
+}
+
+void testGroupCommit()
+{
+  removeFiles();
+  const int THREADS = 4, PER_THREAD = 250;
+  size_t commits;
+  {
+    Durable t(LOG_PATH);
+    vector<thread> writers;
+    for(int w = 0; w < THREADS; w++) {
+      writers.push_back(thread([&t, w]() {
+        for(int i = 0; i < PER_THREAD; i++) t.insert(make_pair(w * PER_THREAD + i, "v"));
+      }));
+    }
+    for(size_t w = 0; w < writers.size(); w++) writers[w].join();
+    commits = t.commits();
+  }
+  Durable t(LOG_PATH);
+  int count = 0;
+  for(Durable::iterator it = t.begin(); it != t.end(); ++it) count++;
+  cout << "  " << THREADS * PER_THREAD << " writes in " << commits << " commits" << endl;
+  check("Concurrent writers all durable", count == THREADS * PER_THREAD && commits <= size_t(THREADS * PER_THREAD));
+}
+
+int main()
+{
+  testReplay();
+  testCheckpoint();
+  testTornTail();
+  testCrashBeforeTruncate();
+  testAutoCheckpointOnce();
+  testFailedLog();
+  testGroupCommit();
+  removeFiles();
+  return failures;
+}
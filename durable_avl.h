@@ -0,0 +1,667 @@
+#ifndef DURABLE_AVL_H
+#define DURABLE_AVL_H
+
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fcntl.h>
+#include <unistd.h>
+#include "avlbst.h"
+#include "wal_codec.h"
+
+/**
+* An AVLTree whose inserts and removes are made durable through a
+* write-ahead log at path. Each change is appended as a binary record
+*
+*     [payload length : u32][checksum : u32][op : u8][key][value]
+*
+* (native byte order) to an in-memory batch. A commit thread writes the
+* whole batch with one write() and one fdatasync(), so writers that arrive
+* while a sync is running share the next one. In commitWait mode insert()
+* and remove() return once their record is on disk; otherwise they return
+* at once and flush() waits for everything written so far.
+*
+* checkpoint() writes the whole tree to path + ".snapshot" and empties the
+* log; checkpointBytes > 0 does so automatically once the log grows past
+* it. Opening an existing path loads the snapshot and the log, keeps the
+* last operation on each key and builds the tree from the result in one
+* pass with buildParallel. A torn or corrupt tail (a crash mid write) ends
+* the replay and is cut off the log.
+*
+* Writers and get()/contains() may be called from several threads. The
+* iterators are not synchronized with writers. Errors opening or writing
+* the files throw std::runtime_error.
+*/
+template <class Key, class Value>
+class DurableAVLTree : protected AVLTree<Key, Value>
+{
+public:
+    typedef typename AVLTree<Key, Value>::iterator iterator;
+
+    explicit DurableAVLTree(const std::string& path, bool commitWait = true, size_t checkpointBytes = 0);
+    virtual ~DurableAVLTree(); // commits whatever is pending
+
+    virtual void insert(const std::pair<const Key, Value>& keyValuePair);
+    virtual void remove(const Key& key);
+    bool get(const Key& key, Value& value) const;
+    bool contains(const Key& key) const;
+
+    void flush();      // returns once every change made so far is on disk
+    void checkpoint(); // snapshot the tree and empty the log
+
+    size_t logBytes() const; // current log length, committed or not
+    size_t commits() const;  // number of fdatasync calls on the log so far
+    size_t checkpoints() const; // number of snapshots written so far
+
+    using AVLTree<Key, Value>::empty;
+    using AVLTree<Key, Value>::isBalanced;
+    using AVLTree<Key, Value>::begin;
+    using AVLTree<Key, Value>::end;
+    using AVLTree<Key, Value>::find;
+
+protected:
+    enum Op { OP_INSERT = 1, OP_REMOVE = 2 };
+    typedef std::pair<Key, std::pair<bool, Value> > Change; // (key, (removed, value))
+
+    // Add helper functions here
+    static uint32_t checksum(const char* data, size_t length);
+    static void appendRecord(Op op, const Key& key, const Value* value, std::string& out);
+    static size_t readRecords(const std::string& data, std::vector<Change>& changes);
+    static std::string readFile(const std::string& path);
+    static void writeAll(int fd, const char* data, size_t length);
+    static void syncFile(int fd);
+    static void syncDirectory(const std::string& path);
+
+    void recover();
+    void runCheckpoint(bool automatic); // automatic: only if the log is still over checkpointBytes_
+    void writeSnapshot(); // checkpoint up to and including the rename
+    void truncateLog();
+    uint64_t log(Op op, const Key& key, const Value* value);
+    void commit(uint64_t sequence);
+    void commitLoop();
+    void waitFor(uint64_t sequence, std::unique_lock<std::mutex>& lock);
+
+protected:
+    std::string path_;
+    bool commitWait_;
+    size_t checkpointBytes_;
+    int fd_;
+
+    mutable std::mutex treeMutex_; // guards the tree; taken before logMutex_
+    mutable std::mutex logMutex_;  // guards everything below
+    std::condition_variable wake_;      // commit thread: work or stop
+    std::condition_variable committed_; // waiters: durable_ moved or the thread went idle
+    std::string pending_;               // records not yet handed to the commit thread
+    uint64_t appended_;                 // sequence number of the last record appended
+    uint64_t durable_;                  // every record up to this one is on disk
+    size_t logBytes_;
+    size_t commits_;
+    size_t checkpoints_;
+    bool writing_;                      // the commit thread is writing outside the lock
+    bool failed_;
+    bool stopping_;
+    std::thread committer_;
+};
+
+/*
+  ------------------------------------------------
+  Begin implementations for the DurableAVLTree class.
+  ------------------------------------------------
+*/
+
+template<class Key, class Value>
+DurableAVLTree<Key, Value>::DurableAVLTree(const std::string& path, bool commitWait, size_t checkpointBytes) :
+    path_(path), commitWait_(commitWait), checkpointBytes_(checkpointBytes), fd_(-1),
+    appended_(0), durable_(0), logBytes_(0), commits_(0), checkpoints_(0), writing_(false), failed_(false), stopping_(false)
+{
+    recover();
+    committer_ = std::thread(&DurableAVLTree<Key, Value>::commitLoop, this);
+}
+
+template<class Key, class Value>
+DurableAVLTree<Key, Value>::~DurableAVLTree()
+{
+    {
+        std::lock_guard<std::mutex> lock(logMutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    committer_.join();
+    ::close(fd_);
+}
+
+/**
+* The tree never holds a change the log lacks. A new key is linked first,
+* since that may throw, and unlinked again if log() throws. An overwrite
+* copies the value before logging and swaps it in afterwards.
+*/
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    uint64_t sequence;
+    {
+        std::lock_guard<std::mutex> lock(treeMutex_);
+        Node<Key, Value>* node = this->internalFind(keyValuePair.first);
+        if(node == nullptr)
+        {
+            bool created;
+            AVLNode<Key, Value>* added = this->findOrCreateNode(keyValuePair.first, keyValuePair.second, created);
+            try
+            {
+                sequence = log(OP_INSERT, keyValuePair.first, &keyValuePair.second);
+            }
+            catch(...)
+            {
+                this->removeNode(added);
+                throw;
+            }
+        }
+        else
+        {
+            Value value(keyValuePair.second);
+            sequence = log(OP_INSERT, keyValuePair.first, &keyValuePair.second);
+            std::swap(node->getValue(), value);
+        }
+    }
+    commit(sequence);
+}
+
+/**
+* Logs before unlinking, which cannot throw, so a failed log leaves the
+* key in place.
+*/
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::remove(const Key& key)
+{
+    uint64_t sequence;
+    {
+        std::lock_guard<std::mutex> lock(treeMutex_);
+        Node<Key, Value>* node = this->internalFind(key);
+        if(node == nullptr)
+        {
+            return; // nothing to log or wait for
+        }
+        sequence = log(OP_REMOVE, key, nullptr);
+        this->removeNode(node);
+    }
+    commit(sequence);
+}
+
+template<class Key, class Value>
+bool DurableAVLTree<Key, Value>::get(const Key& key, Value& value) const
+{
+    std::lock_guard<std::mutex> lock(treeMutex_);
+    Node<Key, Value>* node = this->internalFind(key);
+    if(node == nullptr)
+    {
+        return false;
+    }
+    value = node->getValue();
+    return true;
+}
+
+template<class Key, class Value>
+bool DurableAVLTree<Key, Value>::contains(const Key& key) const
+{
+    std::lock_guard<std::mutex> lock(treeMutex_);
+    return this->internalFind(key) != nullptr;
+}
+
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::flush()
+{
+    std::unique_lock<std::mutex> lock(logMutex_);
+    waitFor(appended_, lock);
+}
+
+/**
+* Holds the tree still while the snapshot is written, so the snapshot
+* contains exactly the records appended so far; the log is then emptied.
+*/
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::checkpoint()
+{
+    runCheckpoint(false);
+}
+
+/**
+* An automatic checkpoint re-checks the log size under the locks: every
+* writer that saw the log past checkpointBytes_ calls here, and only the
+* first should write a snapshot.
+*/
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::runCheckpoint(bool automatic)
+{
+    std::lock_guard<std::mutex> treeLock(treeMutex_);
+    std::unique_lock<std::mutex> lock(logMutex_);
+    committed_.wait(lock, [this]() { return !writing_; });
+    if(automatic && logBytes_ <= checkpointBytes_)
+    {
+        return;
+    }
+    writeSnapshot();
+    truncateLog();
+}
+
+/**
+* Called with both locks held and the commit thread idle. The pending
+* batch goes to the log first, so the log is complete up to the snapshot
+* point. A crash after the rename but before the truncate then replays
+* the new snapshot and a log of changes it already has, which ends in
+* the same state; without the batch a removed key could come back.
+*/
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::writeSnapshot()
+{
+    if(!pending_.empty())
+    {
+        try
+        {
+            writeAll(fd_, pending_.data(), pending_.size());
+            syncFile(fd_);
+        }
+        catch(std::runtime_error&)
+        {
+            failed_ = true;
+            committed_.notify_all();
+            throw;
+        }
+        pending_.clear();
+        durable_ = appended_;
+        commits_++;
+        committed_.notify_all();
+    }
+
+    std::string snapshotPath = path_ + ".snapshot";
+    std::string tempPath = snapshotPath + ".tmp";
+    int fd = ::open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+    {
+        throw std::runtime_error("DurableAVLTree cannot create " + tempPath);
+    }
+    try
+    {
+        std::string buffer;
+        for(iterator it = this->begin(); it != this->end(); ++it)
+        {
+            appendRecord(OP_INSERT, it->first, &it->second, buffer);
+            if(buffer.size() >= (1 << 20))
+            {
+                writeAll(fd, buffer.data(), buffer.size());
+                buffer.clear();
+            }
+        }
+        writeAll(fd, buffer.data(), buffer.size());
+        syncFile(fd);
+    }
+    catch(...)
+    {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+    if(::rename(tempPath.c_str(), snapshotPath.c_str()) != 0)
+    {
+        throw std::runtime_error("DurableAVLTree cannot rename " + tempPath);
+    }
+    syncDirectory(snapshotPath);
+    checkpoints_++;
+}
+
+/**
+* Called with both locks held once the snapshot is in place.
+*/
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::truncateLog()
+{
+    if(::ftruncate(fd_, 0) != 0)
+    {
+        throw std::runtime_error("DurableAVLTree cannot truncate " + path_);
+    }
+    syncFile(fd_);
+
+    logBytes_ = 0;
+    durable_ = appended_;
+    committed_.notify_all();
+}
+
+template<class Key, class Value>
+size_t DurableAVLTree<Key, Value>::logBytes() const
+{
+    std::lock_guard<std::mutex> lock(logMutex_);
+    return logBytes_;
+}
+
+template<class Key, class Value>
+size_t DurableAVLTree<Key, Value>::commits() const
+{
+    std::lock_guard<std::mutex> lock(logMutex_);
+    return commits_;
+}
+
+template<class Key, class Value>
+size_t DurableAVLTree<Key, Value>::checkpoints() const
+{
+    std::lock_guard<std::mutex> lock(logMutex_);
+    return checkpoints_;
+}
+
+/**
+* FNV-1a, enough to tell a torn write from a whole record.
+*/
+template<class Key, class Value>
+uint32_t DurableAVLTree<Key, Value>::checksum(const char* data, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i < length; i++)
+    {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 16777619u;
+    }
+    return hash;
+}
+
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::appendRecord(Op op, const Key& key, const Value* value, std::string& out)
+{
+    size_t start = out.size();
+    out.append(8, '\0'); // length and checksum, filled in below
+    out.push_back(static_cast<char>(op));
+    WalCodec<Key>::encode(key, out);
+    if(value != nullptr)
+    {
+        WalCodec<Value>::encode(*value, out);
+    }
+    uint32_t length = static_cast<uint32_t>(out.size() - start - 8);
+    uint32_t sum = checksum(out.data() + start + 8, length);
+    std::memcpy(&out[start], &length, 4);
+    std::memcpy(&out[start + 4], &sum, 4);
+}
+
+/**
+* Decodes records from data into changes and returns the length of the
+* valid prefix.
+*/
+template<class Key, class Value>
+size_t DurableAVLTree<Key, Value>::readRecords(const std::string& data, std::vector<Change>& changes)
+{
+    const char* begin = data.data();
+    const char* end = begin + data.size();
+    const char* pos = begin;
+    while(end - pos >= 9)
+    {
+        uint32_t length, sum;
+        std::memcpy(&length, pos, 4);
+        std::memcpy(&sum, pos + 4, 4);
+        const char* body = pos + 8;
+        if(length < 1 || static_cast<size_t>(end - body) < length || checksum(body, length) != sum)
+        {
+            break;
+        }
+        const char* field = body + 1;
+        const char* bodyEnd = body + length;
+        Change change;
+        change.second.first = (*body == OP_REMOVE);
+        if(!WalCodec<Key>::decode(field, bodyEnd, change.first) ||
+           (*body == OP_INSERT && !WalCodec<Value>::decode(field, bodyEnd, change.second.second)) ||
+           (*body != OP_INSERT && *body != OP_REMOVE) || field != bodyEnd)
+        {
+            break;
+        }
+        changes.push_back(change);
+        pos = bodyEnd;
+    }
+    return pos - begin;
+}
+
+template<class Key, class Value>
+std::string DurableAVLTree<Key, Value>::readFile(const std::string& path)
+{
+    std::string data;
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        return data; // a missing file is an empty one
+    }
+    char buffer[1 << 16];
+    ssize_t got;
+    while((got = ::read(fd, buffer, sizeof(buffer))) != 0)
+    {
+        if(got < 0 && errno != EINTR)
+        {
+            ::close(fd);
+            throw std::runtime_error("DurableAVLTree cannot read " + path);
+        }
+        if(got > 0)
+        {
+            data.append(buffer, got);
+        }
+    }
+    ::close(fd);
+    return data;
+}
+
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::writeAll(int fd, const char* data, size_t length)
+{
+    while(length > 0)
+    {
+        ssize_t wrote = ::write(fd, data, length);
+        if(wrote < 0 && errno != EINTR)
+        {
+            throw std::runtime_error("DurableAVLTree write failed");
+        }
+        if(wrote > 0)
+        {
+            data += wrote;
+            length -= wrote;
+        }
+    }
+}
+
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::syncFile(int fd)
+{
+    if(::fdatasync(fd) != 0)
+    {
+        throw std::runtime_error("DurableAVLTree fdatasync failed");
+    }
+}
+
+/**
+* Makes a rename into path's directory durable.
+*/
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::syncDirectory(const std::string& path)
+{
+    size_t slash = path.rfind('/');
+    std::string dir = (slash == std::string::npos) ? "." : path.substr(0, slash + 1);
+    int fd = ::open(dir.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        throw std::runtime_error("DurableAVLTree cannot open " + dir);
+    }
+    int result = ::fsync(fd);
+    ::close(fd);
+    if(result != 0)
+    {
+        throw std::runtime_error("DurableAVLTree cannot sync " + dir);
+    }
+}
+
+/**
+* Replays the snapshot and then the log. Only the last change to each key
+* matters, so the changes are stably sorted by key, reduced to their last
+* entry, and the surviving inserts are built into the tree in one go
+* instead of being applied one at a time.
+*/
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::recover()
+{
+    std::vector<Change> changes;
+    readRecords(readFile(path_ + ".snapshot"), changes);
+    std::string log = readFile(path_);
+    size_t valid = readRecords(log, changes);
+
+    std::stable_sort(changes.begin(), changes.end(),
+        [](const Change& a, const Change& b) { return a.first < b.first; });
+    std::vector<std::pair<Key, Value> > items;
+    for(size_t i = 0; i < changes.size(); i++)
+    {
+        bool last = (i + 1 == changes.size()) || (changes[i].first < changes[i + 1].first);
+        if(last && !changes[i].second.first)
+        {
+            items.push_back(std::make_pair(changes[i].first, changes[i].second.second));
+        }
+    }
+    unsigned threads = std::thread::hardware_concurrency();
+    this->buildParallel(items.begin(), items.end(), threads == 0 ? 1 : threads);
+
+    fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if(fd_ < 0)
+    {
+        throw std::runtime_error("DurableAVLTree cannot open " + path_);
+    }
+    if(valid < log.size())
+    {
+        // drop the torn tail so new records follow the last good one
+        if(::ftruncate(fd_, valid) != 0)
+        {
+            ::close(fd_);
+            throw std::runtime_error("DurableAVLTree cannot repair " + path_);
+        }
+        syncFile(fd_);
+    }
+    logBytes_ = valid;
+}
+
+/**
+* Adds a record to the pending batch and returns its sequence number. The
+* caller holds treeMutex_, so records are in the same order as the
+* changes to the tree.
+*/
+template<class Key, class Value>
+uint64_t DurableAVLTree<Key, Value>::log(Op op, const Key& key, const Value* value)
+{
+    std::lock_guard<std::mutex> lock(logMutex_);
+    if(failed_)
+    {
+        throw std::runtime_error("DurableAVLTree log write failed");
+    }
+    size_t before = pending_.size();
+    try
+    {
+        appendRecord(op, key, value, pending_);
+    }
+    catch(...)
+    {
+        pending_.resize(before); // no half record in the batch
+        throw;
+    }
+    logBytes_ += pending_.size() - before;
+    wake_.notify_one();
+    return ++appended_;
+}
+
+/**
+* Called after treeMutex_ is released, which is what lets other writers
+* join the batch being committed. Runs the automatic checkpoint, which
+* makes the record durable too, unless another writer already has.
+*/
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::commit(uint64_t sequence)
+{
+    std::unique_lock<std::mutex> lock(logMutex_);
+    if(checkpointBytes_ > 0 && logBytes_ > checkpointBytes_)
+    {
+        lock.unlock();
+        runCheckpoint(true);
+        lock.lock();
+    }
+    if(commitWait_)
+    {
+        waitFor(sequence, lock);
+    }
+}
+
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::waitFor(uint64_t sequence, std::unique_lock<std::mutex>& lock)
+{
+    committed_.wait(lock, [this, sequence]() { return durable_ >= sequence || failed_; });
+    if(durable_ < sequence)
+    {
+        throw std::runtime_error("DurableAVLTree log write failed");
+    }
+}
+
+/**
+* Takes the whole pending batch, writes and syncs it outside the lock,
+* then publishes the new durable sequence number. On stop it commits what
+* is left first.
+*/
+template<class Key, class Value>
+void DurableAVLTree<Key, Value>::commitLoop()
+{
+    std::unique_lock<std::mutex> lock(logMutex_);
+    while(true)
+    {
+        wake_.wait(lock, [this]() { return !pending_.empty() || stopping_; });
+        if(pending_.empty())
+        {
+            return; // stopping with nothing left
+        }
+
+        std::string batch;
+        batch.swap(pending_);
+        uint64_t sequence = appended_;
+        writing_ = true;
+        lock.unlock();
+
+        bool ok = true;
+        try
+        {
+            writeAll(fd_, batch.data(), batch.size());
+            syncFile(fd_);
+        }
+        catch(std::runtime_error&)
+        {
+            ok = false;
+        }
+
+        lock.lock();
+        writing_ = false;
+        if(ok)
+        {
+            durable_ = std::max(durable_, sequence);
+            commits_++;
+        }
+        else
+        {
+            failed_ = true;
+        }
+        committed_.notify_all();
+        if(failed_)
+        {
+            return;
+        }
+    }
+}
+
+/*
+  ----------------------------------------------
+  End implementations for the DurableAVLTree class.
+  ----------------------------------------------
+*/
+
+#endif
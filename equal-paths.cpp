@@ -5,53 +5,20 @@
 #endif
 
 #include "equal-paths.h"
+#include "tree_shape.h"
 using namespace std;
 
 
 // You may add any prototypes of helper functions here
 
 
+/**
+* Walks the tree iteratively with the shape engine, stopping at the first
+* leaf whose depth differs from the first one found, so deep trees cannot
+* overflow the stack.
+*/
 bool equalPaths(Node * root)
 {
-    if(root == nullptr) // base case
-    {
-        return true;
-    }
-
-    if(root->left == nullptr && root->right == nullptr) // base case, node is a leaf node
-    {
-        return true;
-    }
-
-    int leafDepth = -1;
-    return equalPathsHelper(root, 0, leafDepth);
-}
-
-int getLength(Node* root)
-{
-    if(root == nullptr) // base case, root is null
-    {
-        return 0;
-    }
-    int leftDepth = getLength(root->left);
-    int rightDepth = getLength(root->right);
-
-    return 1 + max(leftDepth, rightDepth);
-}
-
-bool equalPathsHelper(Node* root, int depth, int& leafDepth)
-{
-    if(root == nullptr) return true;
-
-    // is leaf
-    if(root->left == nullptr && root->right == nullptr)
-    {
-        if (leafDepth == -1) leafDepth = depth;
-        return depth == leafDepth;
-    }
-
-    // check subtrees
-    return equalPathsHelper(root->left, depth + 1, leafDepth) &&
-           equalPathsHelper(root->right, depth + 1, leafDepth);
+    return analyzeShape(root, MemberChildren(), SHAPE_STOP_UNEQUAL_LEAVES).equalLeafDepths;
 }
 
@@ -28,7 +28,5 @@ struct Node {
  * @param root Pointer to the root of the tree to check for equal paths
  */
 bool equalPaths(Node * root);
-bool equalPathsHelper(Node* root, int depth, int& leafDepth); // helper function for equalPaths
-int getLength(Node* root); // helper function
 
 #endif
\ No newline at end of file
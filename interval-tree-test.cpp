@@ -0,0 +1,192 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include "interval_tree.h"
+#include "test_check.h"
+using namespace std;
+
+typedef IntervalTree<int, int> Tree;
+
+// overlapping() reports in no particular order
+bool byKey(const Tree::iterator& a, const Tree::iterator& b)
+{
+  return a->first < b->first;
+}
+
+// brute force count of intervals in [lo, hi] over the stored list
+int bruteCount(vector<pair<int, int> >& all, int lo, int hi)
+{
+  int n = 0;
+  for(size_t i = 0; i < all.size(); i++) {
+    if(all[i].first <= hi && lo <= all[i].second) n++;
+  }
+  return n;
+}
+
+void testSmall()
+{
+  Tree t;
+  t.insert(make_pair(Interval<int>(1, 5), 1));
+  t.insert(make_pair(Interval<int>(3, 4), 2));
+  t.insert(make_pair(Interval<int>(6, 9), 3));
+  t.insert(make_pair(Interval<int>(10, 10), 4));
+
+  vector<Tree::iterator> out;
+  t.overlapping(4, out);
+  sort(out.begin(), out.end(), byKey);
+  check("Point in two", out.size() == 2 && out[0]->second == 1 && out[1]->second == 2);
+
+  out.clear();
+  t.overlapping(5, 6, out);
+  sort(out.begin(), out.end(), byKey);
+  check("Touching endpoints count", out.size() == 2 && out[1]->second == 3);
+
+  out.clear();
+  t.overlapping(11, out);
+  check("Point in none", out.empty());
+
+  bool threw = false;
+  try {
+    t.insert(make_pair(Interval<int>(5, 1), 0));
+  }
+  catch(std::invalid_argument&) {
+    threw = true;
+  }
+  check("Reversed interval throws", threw);
+
+  int rejected = 0;
+  try {
+    t.getOrInsert(Interval<int>(20, 5), 7);
+  }
+  catch(std::invalid_argument&) {
+    rejected++;
+  }
+  try {
+    t.upsert(Interval<int>(30, 1), 1, plus<int>());
+  }
+  catch(std::invalid_argument&) {
+    rejected++;
+  }
+  t.getOrInsert(Interval<int>(1, 5), 0) += 10;
+  t.upsert(Interval<int>(12, 14), 5, plus<int>());
+  out.clear();
+  t.overlapping(0, 100, out);
+  sort(out.begin(), out.end(), byKey);
+  check("getOrInsert and upsert reject reversed intervals", rejected == 2 && out.size() == 5 &&
+        out[0]->second == 11 && out[4]->first.lo == 12);
+}
+
+void testRandom()
+{
+  Tree t;
+  vector<pair<int, int> > all;
+  srand(104);
+  for(int i = 0; i < 3000; i++) {
+    int lo = rand() % 10000, hi = lo + rand() % 200;
+    if(t.find(Interval<int>(lo, hi)) != t.end()) continue;
+    t.insert(make_pair(Interval<int>(lo, hi), i));
+    all.push_back(make_pair(lo, hi));
+  }
+  // remove a third to exercise the removeFix rotations
+  for(size_t i = 0; i < all.size(); i += 3) t.remove(Interval<int>(all[i].first, all[i].second));
+  vector<pair<int, int> > kept;
+  for(size_t i = 0; i < all.size(); i++) if(i % 3 != 0) kept.push_back(all[i]);
+
+  bool ok = true;
+  for(int q = 0; q < 300 && ok; q++) {
+    int lo = rand() % 10500 - 200, hi = lo + rand() % 50;
+    vector<Tree::iterator> out;
+    t.overlapping(lo, hi, out);
+    ok = (int)out.size() == bruteCount(kept, lo, hi);
+    for(size_t i = 0; ok && i < out.size(); i++) {
+      ok = out[i]->first.lo <= hi && lo <= out[i]->first.hi;
+    }
+  }
+  check("Random queries match brute force", ok);
+}
+
+void testBuildParallel()
+{
+  Tree t;
+  t.insert(make_pair(Interval<int>(1, 2), 1));
+  vector<pair<Interval<int>, int> > items;
+  items.push_back(make_pair(Interval<int>(3, 8), 2));
+  items.push_back(make_pair(Interval<int>(9, 4), 3));
+  bool threw = false;
+  try {
+    t.buildParallel(items.begin(), items.end(), 2);
+  }
+  catch(std::invalid_argument&) {
+    threw = true;
+  }
+  check("buildParallel rejects reversed intervals", threw && t.begin()->second == 1 && ++t.begin() == t.end());
+
+  items.pop_back();
+  t.buildParallel(items.begin(), items.end(), 2);
+  vector<Tree::iterator> out;
+  t.overlapping(5, out);
+  check("buildParallel builds valid intervals", t.begin()->second == 2 && ++t.begin() == t.end() &&
+        out.size() == 1 && out[0]->second == 2);
+}
+
+// every query against the brute force count, and each reported interval really overlaps
+bool queriesMatch(Tree& t, vector<pair<int, int> >& all, int queries)
+{
+  for(int q = 0; q < queries; q++) {
+    int lo = rand() % 10500 - 200, hi = lo + rand() % 50;
+    vector<Tree::iterator> out;
+    t.overlapping(lo, hi, out);
+    if((int)out.size() != bruteCount(all, lo, hi)) return false;
+    for(size_t i = 0; i < out.size(); i++) {
+      if(out[i]->first.hi < lo || hi < out[i]->first.lo) return false;
+    }
+  }
+  return true;
+}
+
+void testBulk()
+{
+  Tree t;
+  t.setVerifyEachOp(true);
+  vector<pair<int, int> > all;
+  srand(31);
+  for(int i = 0; i < 2000; i++) {
+    int lo = rand() % 10000, hi = lo + rand() % 300;
+    if(t.find(Interval<int>(lo, hi)) != t.end()) continue;
+    t.insert(make_pair(Interval<int>(lo, hi), i));
+    all.push_back(make_pair(lo, hi));
+  }
+
+  // range erase, then split and merge back
+  t.erase(Interval<int>(2000, 0), Interval<int>(3000, 0));
+  vector<pair<int, int> > kept;
+  for(size_t i = 0; i < all.size(); i++) if(all[i].first < 2000 || all[i].first >= 3000) kept.push_back(all[i]);
+  bool ok = t.verify() && queriesMatch(t, kept, 200);
+
+  Tree upper;
+  t.split(Interval<int>(6000, 0), upper);
+  vector<pair<int, int> > lower;
+  vector<pair<int, int> > higher;
+  for(size_t i = 0; i < kept.size(); i++) (kept[i].first < 6000 ? lower : higher).push_back(kept[i]);
+  ok = ok && t.verify() && upper.verify() && queriesMatch(t, lower, 200) && queriesMatch(upper, higher, 200);
+  t.merge(upper);
+  ok = ok && t.verify() && queriesMatch(t, kept, 200);
+  check("Slots survive erase, split and merge", ok);
+
+  t.rebalance();
+  for(size_t i = 0; i < kept.size(); i += 2) t.remove(Interval<int>(kept[i].first, kept[i].second));
+  vector<pair<int, int> > half;
+  for(size_t i = 1; i < kept.size(); i += 2) half.push_back(kept[i]);
+  check("Slots survive rebalance and removes", t.verify() && queriesMatch(t, half, 200));
+}
+
+int main()
+{
+  testSmall();
+  testRandom();
+  testBuildParallel();
+  testBulk();
+  return failures;
+}
@@ -0,0 +1,772 @@
+#ifndef INTERVAL_TREE_H
+#define INTERVAL_TREE_H
+
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+#include "augmented_avl.h"
+
+/**
+* A closed interval [lo, hi], the key type of IntervalTree. Intervals are
+* ordered by lo, then by hi.
+*/
+template <typename Key>
+struct Interval
+{
+    Interval(const Key& lo_, const Key& hi_) : lo(lo_), hi(hi_) {}
+
+    Key lo;
+    Key hi;
+};
+
+template <typename Key>
+bool operator<(const Interval<Key>& a, const Interval<Key>& b)
+{
+    return a.lo < b.lo || (!(b.lo < a.lo) && a.hi < b.hi);
+}
+
+template <typename Key>
+bool operator>(const Interval<Key>& a, const Interval<Key>& b)
+{
+    return b < a;
+}
+
+template <typename Key>
+bool operator==(const Interval<Key>& a, const Interval<Key>& b)
+{
+    return !(a < b) && !(b < a);
+}
+
+template <typename Key>
+std::ostream& operator<<(std::ostream& out, const Interval<Key>& interval)
+{
+    return out << '[' << interval.lo << ", " << interval.hi << ']';
+}
+
+/**
+* Aggregate policy for IntervalTree: the largest right endpoint in a
+* subtree. first is false for an empty subtree, so Key needs no minimum.
+*/
+template <typename Key>
+struct IntervalEndAggregate
+{
+    typedef std::pair<bool, Key> type;
+    static type identity() { return type(false, Key()); }
+    template <typename Value>
+    static type lift(const Interval<Key>& interval, const Value&) { return type(true, interval.hi); }
+    static type combine(const type& a, const type& b)
+    {
+        if(!a.first) return b;
+        if(!b.first) return a;
+        return (a.second < b.second) ? b : a;
+    }
+};
+
+template <class Key, class Value>
+class IntervalTree;
+
+/**
+* An interval tree node. Besides its own interval it is one position of
+* the priority search tree that IntervalTree lays over the AVL shape: its
+* slot keeps the latest ending interval of its subtree that no ancestor
+* keeps already. An interval no slot keeps waits in its own node's leaf.
+*/
+template <typename Key, typename Value>
+class IntervalNode : public AugmentedAVLNode<Interval<Key>, Value, IntervalEndAggregate<Key> >
+{
+public:
+    IntervalNode(const Interval<Key>& key, const Value& value, AVLNode<Interval<Key>, Value>* parent);
+    virtual ~IntervalNode();
+
+protected:
+    friend class IntervalTree<Key, Value>;
+
+    IntervalNode* slot_;   // interval kept at this position, nullptr if none
+    IntervalNode* holder_; // position keeping this node's interval, nullptr if none
+    bool inLeaf_;          // this node's interval waits below the slot instead
+    bool dirty_;           // relinked by a join since the slots were repaired
+};
+
+/*
+  ------------------------------------------------
+  Begin implementations for the IntervalNode class.
+  ------------------------------------------------
+*/
+
+/**
+* A new node is placed by the tree once it is linked in.
+*/
+template<typename Key, typename Value>
+IntervalNode<Key, Value>::IntervalNode(const Interval<Key>& key, const Value& value, AVLNode<Interval<Key>, Value>* parent) :
+    AugmentedAVLNode<Interval<Key>, Value, IntervalEndAggregate<Key> >(key, value, parent),
+    slot_(nullptr), holder_(nullptr), inLeaf_(false), dirty_(false)
+{
+
+}
+
+template<typename Key, typename Value>
+IntervalNode<Key, Value>::~IntervalNode()
+{
+
+}
+
+/*
+  ----------------------------------------------
+  End implementations for the IntervalNode class.
+  ----------------------------------------------
+*/
+
+/**
+* An AVL tree of closed intervals, keyed by Interval<Key>, where
+* every node also knows the largest hi in its subtree.
+*
+* Overlap queries use a priority search tree kept in the same nodes: each
+* slot holds the latest ending interval of its subtree not already held
+* higher up, so ends only fall on the way down. A point query stops at
+* the first slot that ends before the point and never goes right of a
+* node that starts after it. That bounds both overlapping() calls at
+* O(log n + k) for k matches.
+*
+* Keeping the slots costs O(log n) per rotation: insert stays O(log n) and
+* remove becomes O(log^2 n). split, merge and the range erases repair the
+* O(log n) nodes their joins relinked, O(log^2 n), plus O(log n) for each
+* survivor that an erased node's slot held. buildParallel and rebalance
+* refill every slot, O(n).
+*
+* Each distinct interval holds one value; inserting the same [lo, hi]
+* again overwrites it.
+*/
+template <class Key, class Value>
+class IntervalTree : public AugmentedAVLTree<Interval<Key>, Value, IntervalEndAggregate<Key> >
+{
+public:
+    typedef Interval<Key> interval_type;
+    typedef typename AVLTree<interval_type, Value>::iterator iterator;
+
+    // All three throw std::invalid_argument if the interval has hi < lo.
+    virtual void insert(const std::pair<const interval_type, Value> &new_item);
+    Value& getOrInsert(const interval_type& interval, const Value& defaultValue);
+    template<class Combine>
+    bool upsert(const interval_type& interval, const Value& value, Combine combine);
+    // Checks every interval before the tree is touched, so a reversed one
+    // leaves the old contents in place.
+    template<class InputIt>
+    void buildParallel(InputIt first, InputIt last, unsigned threads);
+
+    // The bulk operations of AVLTree, followed by a repair of the slots.
+    void erase(const interval_type& lo, const interval_type& hi);
+    void erase(iterator first, iterator last);
+    using AVLTree<interval_type, Value>::erase;
+    void split(const interval_type& key, IntervalTree<Key, Value>& greater);
+    void merge(IntervalTree<Key, Value>& greater);
+    virtual void rebalance();
+
+    // Appends every interval containing point, in no particular order.
+    void overlapping(const Key& point, std::vector<iterator>& out) const;
+    // Appends every interval sharing at least one point with [lo, hi], in
+    // no particular order.
+    void overlapping(const Key& lo, const Key& hi, std::vector<iterator>& out) const;
+
+protected:
+    typedef AugmentedAVLTree<interval_type, Value, IntervalEndAggregate<Key> > Base;
+    typedef IntervalNode<Key, Value> INode;
+
+    virtual AVLNode<interval_type, Value>* createNode(const interval_type& key, const Value& value, AVLNode<interval_type, Value>* parent);
+    virtual AVLNode<interval_type, Value>* findOrCreateNode(const interval_type& key, const Value& value, bool& created);
+    virtual void updateAfterRotate(AVLNode<interval_type, Value>* lower, AVLNode<interval_type, Value>* upper);
+    virtual void updatePath(AVLNode<interval_type, Value>* node);
+    virtual void updateNode(AVLNode<interval_type, Value>* node);
+    virtual void nodeSwap(AVLNode<interval_type, Value>* n1, AVLNode<interval_type, Value>* n2);
+    virtual void removeNode(Node<interval_type, Value>* node);
+    virtual bool checkNode(Node<interval_type, Value>* node, int leftHeight, int rightHeight) const;
+
+    // Add helper functions here
+    static void checkInterval(const interval_type& interval);
+    void stab(Node<interval_type, Value>* position, const Key& point, std::vector<iterator>& out) const;
+
+    // slot upkeep
+    static INode* slotOf(Node<interval_type, Value>* position); // nullptr for an empty subtree
+    static void keep(INode* position, INode* item);             // item may be nullptr
+    static void pushDown(INode* position, INode* item);         // places an unplaced item below position
+    static void pullUp(INode* position);                        // refills a slot that was just emptied
+    static void eject(INode* item);                             // takes item out of its slot or leaf
+    static void place(INode* item);                             // pushDown from the root, if unplaced
+    void prepareCut(const interval_type& lo, const interval_type* hi, bool hiInclusive, std::vector<INode*>& homeless);
+    static void ejectDirty(Node<interval_type, Value>* position, std::vector<INode*>& homeless);
+    static void refillDirty(Node<interval_type, Value>* position);
+    static void repair(Node<interval_type, Value>* root, std::vector<INode*>& homeless);
+};
+
+/*
+  ------------------------------------------------
+  Begin implementations for the IntervalTree class.
+  ------------------------------------------------
+*/
+
+template<class Key, class Value>
+void IntervalTree<Key, Value>::checkInterval(const interval_type& interval)
+{
+    if(interval.hi < interval.lo)
+    {
+        throw std::invalid_argument("IntervalTree interval has hi < lo");
+    }
+}
+
+template<class Key, class Value>
+void IntervalTree<Key, Value>::insert(const std::pair<const interval_type, Value> &new_item)
+{
+    checkInterval(new_item.first);
+    Base::insert(new_item);
+}
+
+template<class Key, class Value>
+Value& IntervalTree<Key, Value>::getOrInsert(const interval_type& interval, const Value& defaultValue)
+{
+    checkInterval(interval);
+    return Base::getOrInsert(interval, defaultValue);
+}
+
+template<class Key, class Value>
+template<class Combine>
+bool IntervalTree<Key, Value>::upsert(const interval_type& interval, const Value& value, Combine combine)
+{
+    checkInterval(interval);
+    return Base::upsert(interval, value, combine);
+}
+
+template<class Key, class Value>
+template<class InputIt>
+void IntervalTree<Key, Value>::buildParallel(InputIt first, InputIt last, unsigned threads)
+{
+    typename Base::ItemVector items(first, last);
+    for(size_t i = 0; i < items.size(); i++)
+    {
+        checkInterval(items[i].first);
+    }
+    Base::buildParallel(items.begin(), items.end(), threads);
+    std::vector<INode*> homeless;
+    repair(this->root_, homeless);
+}
+
+template<class Key, class Value>
+void IntervalTree<Key, Value>::erase(const interval_type& lo, const interval_type& hi)
+{
+    if(hi < lo)
+    {
+        return;
+    }
+    std::vector<INode*> homeless;
+    prepareCut(lo, &hi, true, homeless);
+    Base::erase(lo, hi);
+    repair(this->root_, homeless);
+}
+
+template<class Key, class Value>
+void IntervalTree<Key, Value>::erase(iterator first, iterator last)
+{
+    if(first == last)
+    {
+        return;
+    }
+    Node<interval_type, Value>* stop = this->iteratorNode(last);
+    std::vector<INode*> homeless;
+    prepareCut(first->first, stop == nullptr ? nullptr : &stop->getKey(), false, homeless);
+    Base::erase(first, last);
+    repair(this->root_, homeless);
+}
+
+template<class Key, class Value>
+void IntervalTree<Key, Value>::split(const interval_type& key, IntervalTree<Key, Value>& greater)
+{
+    Base::split(key, greater);
+    std::vector<INode*> homeless;
+    ejectDirty(this->root_, homeless);
+    ejectDirty(greater.root_, homeless);
+    refillDirty(this->root_);
+    refillDirty(greater.root_);
+    for(size_t i = 0; i < homeless.size(); i++)
+    {
+        place(homeless[i]);
+    }
+}
+
+template<class Key, class Value>
+void IntervalTree<Key, Value>::merge(IntervalTree<Key, Value>& greater)
+{
+    Base::merge(greater);
+    std::vector<INode*> homeless;
+    repair(this->root_, homeless);
+}
+
+template<class Key, class Value>
+void IntervalTree<Key, Value>::rebalance()
+{
+    Base::rebalance();
+    std::vector<INode*> homeless;
+    repair(this->root_, homeless);
+}
+
+/**
+* A point query over the slots. A slot ending before point means nothing
+* left unreported below it reaches point either; a node starting after
+* point means nothing to its right starts in time.
+*/
+template<class Key, class Value>
+void IntervalTree<Key, Value>::overlapping(const Key& point, std::vector<iterator>& out) const
+{
+    stab(this->root_, point, out);
+}
+
+/**
+* An interval meets [lo, hi] either by containing lo or by starting
+* inside (lo, hi]. The first kind is a point query at lo, the second an
+* in-order walk from the first interval that starts after lo.
+*/
+template<class Key, class Value>
+void IntervalTree<Key, Value>::overlapping(const Key& lo, const Key& hi, std::vector<iterator>& out) const
+{
+    if(hi < lo)
+    {
+        return;
+    }
+    stab(this->root_, lo, out);
+
+    Node<interval_type, Value>* first = nullptr;
+    Node<interval_type, Value>* current = this->root_;
+    while(current != nullptr)
+    {
+        if(lo < current->getKey().lo)
+        {
+            first = current;
+            current = current->getLeft();
+        }
+        else
+        {
+            current = current->getRight();
+        }
+    }
+    for(current = first; current != nullptr && !(hi < current->getKey().lo); current = this->successor(current))
+    {
+        out.push_back(this->makeIterator(current));
+    }
+}
+
+/**
+* Every visited position either reports its slot, hangs off the search
+* path for point, or is a child of a position that reported, so the walk
+* is O(log n + k).
+*/
+template<class Key, class Value>
+void IntervalTree<Key, Value>::stab(Node<interval_type, Value>* position, const Key& point, std::vector<iterator>& out) const
+{
+    INode* kept = slotOf(position);
+    if(kept == nullptr || kept->getKey().hi < point)
+    {
+        return;
+    }
+    if(!(point < kept->getKey().lo))
+    {
+        out.push_back(this->makeIterator(kept));
+    }
+    INode* node = static_cast<INode*>(position);
+    if(node->inLeaf_ && !(point < node->getKey().lo) && !(node->getKey().hi < point))
+    {
+        out.push_back(this->makeIterator(node));
+    }
+    stab(node->getLeft(), point, out);
+    if(!(point < node->getKey().lo))
+    {
+        stab(node->getRight(), point, out);
+    }
+}
+
+template<class Key, class Value>
+AVLNode<Interval<Key>, Value>* IntervalTree<Key, Value>::createNode(const interval_type& key, const Value& value, AVLNode<interval_type, Value>* parent)
+{
+    return new INode(key, value, parent);
+}
+
+/**
+* The first node of a tree is linked without updatePath, so it is placed
+* here. Any other new node was placed by updatePath already.
+*/
+template<class Key, class Value>
+AVLNode<Interval<Key>, Value>* IntervalTree<Key, Value>::findOrCreateNode(const interval_type& key, const Value& value, bool& created)
+{
+    AVLNode<interval_type, Value>* node = Base::findOrCreateNode(key, value, created);
+    if(created)
+    {
+        place(static_cast<INode*>(node));
+    }
+    return node;
+}
+
+/**
+* lower was the parent and held the latest end of the pair's subtree, so
+* that slot moves up with the position. Whatever upper kept is pushed
+* back down after lower's slot is refilled from its new children.
+*/
+template<class Key, class Value>
+void IntervalTree<Key, Value>::updateAfterRotate(AVLNode<interval_type, Value>* lower, AVLNode<interval_type, Value>* upper)
+{
+    Base::updateAfterRotate(lower, upper);
+    INode* low = static_cast<INode*>(lower);
+    INode* up = static_cast<INode*>(upper);
+    INode* displaced = up->slot_;
+    keep(up, low->slot_);
+    low->slot_ = nullptr;
+    if(displaced != nullptr)
+    {
+        displaced->holder_ = nullptr;
+    }
+    pullUp(low);
+    if(displaced != nullptr)
+    {
+        pushDown(up, displaced);
+    }
+}
+
+/**
+* Called once a new node is linked and balanced, and after removals and
+* overwrites. Only a node that is not placed yet needs anything.
+*/
+template<class Key, class Value>
+void IntervalTree<Key, Value>::updatePath(AVLNode<interval_type, Value>* node)
+{
+    Base::updatePath(node);
+    place(static_cast<INode*>(node));
+}
+
+/**
+* Joins relink nodes bottom up without rotations; the slots of the nodes
+* they touch are repaired once the whole operation is done.
+*/
+template<class Key, class Value>
+void IntervalTree<Key, Value>::updateNode(AVLNode<interval_type, Value>* node)
+{
+    Base::updateNode(node);
+    static_cast<INode*>(node)->dirty_ = true;
+}
+
+/**
+* Slots belong to positions, not to nodes, so they are swapped back.
+*/
+template<class Key, class Value>
+void IntervalTree<Key, Value>::nodeSwap(AVLNode<interval_type, Value>* n1, AVLNode<interval_type, Value>* n2)
+{
+    Base::nodeSwap(n1, n2);
+    INode* a = static_cast<INode*>(n1);
+    INode* b = static_cast<INode*>(n2);
+    INode* kept = a->slot_;
+    keep(a, b->slot_);
+    keep(b, kept);
+}
+
+/**
+* Before the base unlinks node, node's interval leaves the slots, and so
+* does that of the predecessor it may be swapped with, since the
+* predecessor changes position. The slot at the position that is cut out
+* is emptied too. Rotations on the way up then see valid slots for every
+* other interval, and the two set aside are placed again at the end.
+*/
+template<class Key, class Value>
+void IntervalTree<Key, Value>::removeNode(Node<interval_type, Value>* found)
+{
+    INode* node = static_cast<INode*>(found);
+    eject(node);
+    INode* cut = node;
+    INode* moved = nullptr;
+    if(node->getLeft() != nullptr && node->getRight() != nullptr)
+    {
+        moved = static_cast<INode*>(this->predecessor(node));
+        eject(moved);
+        cut = moved;
+    }
+    INode* orphan = cut->slot_;
+    cut->slot_ = nullptr;
+    if(orphan != nullptr)
+    {
+        orphan->holder_ = nullptr;
+    }
+
+    Base::removeNode(found);
+
+    if(moved != nullptr)
+    {
+        place(moved);
+    }
+    if(orphan != nullptr)
+    {
+        place(orphan);
+    }
+}
+
+/**
+* Adds the slot rules to the AVL ones: a slot ends no earlier than its
+* children's slots or the interval waiting in the leaf, an empty slot has
+* nothing at all below it, and a kept interval lies in the subtree.
+* Nodes a join relinked are skipped until their repair.
+*/
+template<class Key, class Value>
+bool IntervalTree<Key, Value>::checkNode(Node<interval_type, Value>* node, int leftHeight, int rightHeight) const
+{
+    if(!Base::checkNode(node, leftHeight, rightHeight))
+    {
+        return false;
+    }
+    INode* position = static_cast<INode*>(node);
+    if(position->dirty_)
+    {
+        return true;
+    }
+    if(position->holder_ != nullptr && (position->inLeaf_ || position->holder_->slot_ != position))
+    {
+        return false;
+    }
+    INode* kept = position->slot_;
+    INode* left = slotOf(position->getLeft());
+    INode* right = slotOf(position->getRight());
+    if(kept == nullptr)
+    {
+        return !position->inLeaf_ && left == nullptr && right == nullptr;
+    }
+    if(kept->holder_ != position ||
+       (position->inLeaf_ && kept->getKey().hi < position->getKey().hi) ||
+       (left != nullptr && kept->getKey().hi < left->getKey().hi) ||
+       (right != nullptr && kept->getKey().hi < right->getKey().hi))
+    {
+        return false;
+    }
+    Node<interval_type, Value>* above = kept;
+    while(above != nullptr && above != position)
+    {
+        above = above->getParent();
+    }
+    return above == position;
+}
+
+template<class Key, class Value>
+IntervalNode<Key, Value>* IntervalTree<Key, Value>::slotOf(Node<interval_type, Value>* position)
+{
+    return position == nullptr ? nullptr : static_cast<INode*>(position)->slot_;
+}
+
+template<class Key, class Value>
+void IntervalTree<Key, Value>::keep(INode* position, INode* item)
+{
+    position->slot_ = item;
+    if(item != nullptr)
+    {
+        item->holder_ = position;
+        item->inLeaf_ = false;
+    }
+}
+
+/**
+* Carries item down towards its own node. At each position the later
+* ending of item and the slot stays, and the other goes on; an item that
+* reaches its own node with the slot still later waits in the leaf.
+*/
+template<class Key, class Value>
+void IntervalTree<Key, Value>::pushDown(INode* position, INode* item)
+{
+    while(true)
+    {
+        INode* kept = position->slot_;
+        if(kept == nullptr)
+        {
+            keep(position, item);
+            return;
+        }
+        if(kept->getKey().hi < item->getKey().hi)
+        {
+            keep(position, item);
+            kept->holder_ = nullptr;
+            item = kept;
+        }
+        if(item == position)
+        {
+            item->inLeaf_ = true;
+            return;
+        }
+        position = static_cast<INode*>(item->getKey() < position->getKey() ? position->getLeft() : position->getRight());
+    }
+}
+
+/**
+* Moves the latest of the children's slots and the waiting interval into
+* position, then refills whichever child gave one up.
+*/
+template<class Key, class Value>
+void IntervalTree<Key, Value>::pullUp(INode* position)
+{
+    while(position != nullptr)
+    {
+        INode* best = position->inLeaf_ ? position : nullptr;
+        INode* from = nullptr;
+        INode* children[2] = { static_cast<INode*>(position->getLeft()), static_cast<INode*>(position->getRight()) };
+        for(int i = 0; i < 2; i++)
+        {
+            INode* candidate = slotOf(children[i]);
+            if(candidate != nullptr && (best == nullptr || best->getKey().hi < candidate->getKey().hi))
+            {
+                best = candidate;
+                from = children[i];
+            }
+        }
+        keep(position, best);
+        position = from;
+    }
+}
+
+template<class Key, class Value>
+void IntervalTree<Key, Value>::eject(INode* item)
+{
+    INode* at = item->holder_;
+    item->holder_ = nullptr;
+    item->inLeaf_ = false;
+    if(at != nullptr)
+    {
+        at->slot_ = nullptr;
+        pullUp(at);
+    }
+}
+
+/**
+* Finds item's root through the parent links, so it also works for the
+* greater tree of a split.
+*/
+template<class Key, class Value>
+void IntervalTree<Key, Value>::place(INode* item)
+{
+    if(item->holder_ != nullptr || item->inLeaf_)
+    {
+        return;
+    }
+    Node<interval_type, Value>* root = item;
+    while(root->getParent() != nullptr)
+    {
+        root = root->getParent();
+    }
+    pushDown(static_cast<INode*>(root), item);
+}
+
+/**
+* Runs before the base cuts [lo, hi] out. Surviving intervals kept at a
+* doomed position are set aside, and a doomed interval kept at a
+* surviving position leaves an empty slot there; that position lies on a
+* split path, so the repair refills it.
+*/
+template<class Key, class Value>
+void IntervalTree<Key, Value>::prepareCut(const interval_type& lo, const interval_type* hi, bool hiInclusive, std::vector<INode*>& homeless)
+{
+    Node<interval_type, Value>* first = nullptr;
+    Node<interval_type, Value>* current = this->root_;
+    while(current != nullptr)
+    {
+        if(current->getKey() < lo)
+        {
+            current = current->getRight();
+        }
+        else
+        {
+            first = current;
+            current = current->getLeft();
+        }
+    }
+
+    std::vector<INode*> doomed;
+    for(current = first; current != nullptr; current = this->successor(current))
+    {
+        if(hi != nullptr && (hiInclusive ? *hi < current->getKey() : !(current->getKey() < *hi)))
+        {
+            break;
+        }
+        doomed.push_back(static_cast<INode*>(current));
+    }
+    for(size_t i = 0; i < doomed.size(); i++)
+    {
+        INode* node = doomed[i];
+        INode* kept = node->slot_;
+        if(kept != nullptr && (kept->getKey() < lo ||
+           (hi != nullptr && (hiInclusive ? *hi < kept->getKey() : !(kept->getKey() < *hi)))))
+        {
+            kept->holder_ = nullptr;
+            homeless.push_back(kept);
+        }
+        node->slot_ = nullptr;
+        if(node->holder_ != nullptr)
+        {
+            node->holder_->slot_ = nullptr;
+            node->holder_ = nullptr;
+        }
+    }
+}
+
+/**
+* Empties the slots of the relinked nodes, which form the top of the tree
+* since every join relinks its way up to the root. Intervals of relinked
+* nodes will wait in their leaves; any other is set aside.
+*/
+template<class Key, class Value>
+void IntervalTree<Key, Value>::ejectDirty(Node<interval_type, Value>* position, std::vector<INode*>& homeless)
+{
+    INode* node = static_cast<INode*>(position);
+    if(node == nullptr || !node->dirty_)
+    {
+        return;
+    }
+    INode* kept = node->slot_;
+    node->slot_ = nullptr;
+    if(kept != nullptr)
+    {
+        kept->holder_ = nullptr;
+        if(!kept->dirty_)
+        {
+            homeless.push_back(kept);
+        }
+    }
+    ejectDirty(node->getLeft(), homeless);
+    ejectDirty(node->getRight(), homeless);
+}
+
+/**
+* Refills the emptied slots bottom up. Untouched subtrees below are valid
+* apart from the set-aside intervals, so each refill is one pullUp.
+*/
+template<class Key, class Value>
+void IntervalTree<Key, Value>::refillDirty(Node<interval_type, Value>* position)
+{
+    INode* node = static_cast<INode*>(position);
+    if(node == nullptr || !node->dirty_)
+    {
+        return;
+    }
+    refillDirty(node->getLeft());
+    refillDirty(node->getRight());
+    node->dirty_ = false;
+    node->inLeaf_ = node->holder_ == nullptr;
+    pullUp(node);
+}
+
+template<class Key, class Value>
+void IntervalTree<Key, Value>::repair(Node<interval_type, Value>* root, std::vector<INode*>& homeless)
+{
+    ejectDirty(root, homeless);
+    refillDirty(root);
+    for(size_t i = 0; i < homeless.size(); i++)
+    {
+        place(homeless[i]);
+    }
+}
+
+/*
+  ----------------------------------------------
+  End implementations for the IntervalTree class.
+  ----------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,65 @@
+#include <iostream>
+#include <cstdlib>
+#include <map>
+#include "path_avl.h"
+#include "avlbst.h"
+#include "test_check.h"
+using namespace std;
+
+// contents must match the reference map exactly and in order
+bool same(PathAVLTree<int, int>& t, map<int, int>& m)
+{
+  map<int, int>::iterator mit = m.begin();
+  for(PathAVLTree<int, int>::iterator it = t.begin(); it != t.end(); ++it, ++mit) {
+    if(mit == m.end() || mit->first != it->first || mit->second != it->second) return false;
+  }
+  return mit == m.end();
+}
+
+void testAgainstMap()
+{
+  PathAVLTree<int, int> t;
+  map<int, int> m;
+  srand(104);
+  for(int i = 0; i < 20000; i++) {
+    int k = rand() % 3000;
+    if(rand() % 3 == 0) {
+      t.remove(k);
+      m.erase(k);
+    }
+    else {
+      t.insert(make_pair(k, i));
+      m[k] = i;
+    }
+  }
+  check("Random ops match map", same(t, m));
+  check("Random ops balanced", t.isBalanced());
+}
+
+void testSequential()
+{
+  PathAVLTree<int, int> t;
+  for(int i = 0; i < 100000; i++) t.insert(make_pair(i, -i));
+  check("Sequential balanced", t.isBalanced() && t[777] == -777);
+  for(int i = 0; i < 100000; i += 2) t.remove(i);
+  check("Remove evens balanced", t.isBalanced() && t.find(10) == t.end());
+
+  PathAVLTree<int, int>::iterator it = t.find(99);
+  ++it;
+  check("Iterate from find", it != t.end() && it->first == 101);
+}
+
+void testFootprint()
+{
+  cout << "bytes per int->int node: PathAVLNode " << sizeof(PathAVLNode<int, int>)
+       << ", AVLNode " << sizeof(AVLNode<int, int>) << endl;
+  check("Smaller than AVLNode", sizeof(PathAVLNode<int, int>) < sizeof(AVLNode<int, int>));
+}
+
+int main()
+{
+  testAgainstMap();
+  testSequential();
+  testFootprint();
+  return failures;
+}
@@ -0,0 +1,567 @@
+#ifndef PATH_AVL_H
+#define PATH_AVL_H
+
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <algorithm>
+
+/**
+* A node for PathAVLTree. There is no parent link and no vtable, only the
+* item, two children and the balance.
+*/
+template <typename Key, typename Value>
+struct PathAVLNode
+{
+    PathAVLNode(const Key& key, const Value& value) :
+        item(key, value), left(nullptr), right(nullptr), balance(0)
+    {}
+
+    std::pair<const Key, Value> item;
+    PathAVLNode<Key, Value>* left;
+    PathAVLNode<Key, Value>* right;
+    int8_t balance;
+};
+
+/**
+* An AVL tree without parent pointers. insert and remove record their
+* descent on a fixed size stack and retrace from it, and the iterator
+* keeps its own stack of ancestors. Each node saves the 8 byte parent link
+* and rotations write four links instead of six.
+*/
+template <class Key, class Value>
+class PathAVLTree
+{
+public:
+    // An AVL tree of height 96 needs more nodes than fit in memory.
+    static const int MAX_HEIGHT = 96;
+
+    PathAVLTree();
+    ~PathAVLTree();
+    // The nodes are owned raw, so trees are not copied.
+    PathAVLTree(const PathAVLTree&) = delete;
+    PathAVLTree& operator=(const PathAVLTree&) = delete;
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool isBalanced() const;
+    bool empty() const;
+
+    /**
+    * In-order iterator. It holds the path from the root to the current
+    * node, so copying one costs O(height).
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        std::pair<const Key,Value>& operator*() const;
+        std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class PathAVLTree<Key, Value>;
+        void pushLeftSpine(PathAVLNode<Key, Value>* node);
+        std::vector<PathAVLNode<Key, Value>*> path_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    // Add helper functions here
+    PathAVLNode<Key, Value>* internalFind(const Key& key) const;
+    static PathAVLNode<Key, Value>* rotateLeft(PathAVLNode<Key, Value>* node);  // both return the new subtree root
+    static PathAVLNode<Key, Value>* rotateRight(PathAVLNode<Key, Value>* node);
+    static PathAVLNode<Key, Value>* rebalance(PathAVLNode<Key, Value>* node, bool& heightChanged);
+    void setChild(PathAVLNode<Key, Value>** path, bool* wentRight, int level, PathAVLNode<Key, Value>* child);
+    void clearNodes(PathAVLNode<Key, Value>* node);
+    int checkHeight(PathAVLNode<Key, Value>* node) const; // height, or -1 if unbalanced
+
+protected:
+    PathAVLNode<Key, Value>* root_;
+};
+
+/*
+  ----------------------------------------------------------
+  Begin implementations for the PathAVLTree::iterator class.
+  ----------------------------------------------------------
+*/
+
+template<class Key, class Value>
+PathAVLTree<Key, Value>::iterator::iterator()
+{
+
+}
+
+template<class Key, class Value>
+std::pair<const Key,Value>& PathAVLTree<Key, Value>::iterator::operator*() const
+{
+    return path_.back()->item;
+}
+
+template<class Key, class Value>
+std::pair<const Key,Value>* PathAVLTree<Key, Value>::iterator::operator->() const
+{
+    return &(path_.back()->item);
+}
+
+template<class Key, class Value>
+bool PathAVLTree<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    if(path_.empty() || rhs.path_.empty())
+    {
+        return path_.empty() == rhs.path_.empty();
+    }
+    return path_.back() == rhs.path_.back();
+}
+
+template<class Key, class Value>
+bool PathAVLTree<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* Pushes node and its chain of left children.
+*/
+template<class Key, class Value>
+void PathAVLTree<Key, Value>::iterator::pushLeftSpine(PathAVLNode<Key, Value>* node)
+{
+    while(node != nullptr)
+    {
+        path_.push_back(node);
+        node = node->left;
+    }
+}
+
+/**
+* Goes down into the right subtree if there is one, otherwise pops up past
+* every ancestor we were the right child of.
+*/
+template<class Key, class Value>
+typename PathAVLTree<Key, Value>::iterator& PathAVLTree<Key, Value>::iterator::operator++()
+{
+    PathAVLNode<Key, Value>* current = path_.back();
+    if(current->right != nullptr)
+    {
+        pushLeftSpine(current->right);
+        return *this;
+    }
+
+    path_.pop_back();
+    while(!path_.empty() && path_.back()->right == current)
+    {
+        current = path_.back();
+        path_.pop_back();
+    }
+    return *this;
+}
+
+/*
+  --------------------------------------------------------
+  End implementations for the PathAVLTree::iterator class.
+  --------------------------------------------------------
+*/
+
+/*
+  ------------------------------------------------
+  Begin implementations for the PathAVLTree class.
+  ------------------------------------------------
+*/
+
+template<class Key, class Value>
+PathAVLTree<Key, Value>::PathAVLTree() : root_(nullptr)
+{
+
+}
+
+template<class Key, class Value>
+PathAVLTree<Key, Value>::~PathAVLTree()
+{
+    clear();
+}
+
+template<class Key, class Value>
+bool PathAVLTree<Key, Value>::empty() const
+{
+    return root_ == nullptr;
+}
+
+template<class Key, class Value>
+void PathAVLTree<Key, Value>::clear()
+{
+    clearNodes(root_);
+    root_ = nullptr;
+}
+
+template<class Key, class Value>
+void PathAVLTree<Key, Value>::clearNodes(PathAVLNode<Key, Value>* node)
+{
+    if(node == nullptr)
+    {
+        return;
+    }
+    clearNodes(node->left);
+    clearNodes(node->right);
+    delete node;
+}
+
+template<class Key, class Value>
+PathAVLNode<Key, Value>* PathAVLTree<Key, Value>::internalFind(const Key& key) const
+{
+    PathAVLNode<Key, Value>* current = root_;
+    while(current != nullptr)
+    {
+        if(key < current->item.first)
+        {
+            current = current->left;
+        }
+        else if(current->item.first < key)
+        {
+            current = current->right;
+        }
+        else
+        {
+            return current;
+        }
+    }
+    return nullptr;
+}
+
+template<class Key, class Value>
+PathAVLNode<Key, Value>* PathAVLTree<Key, Value>::rotateLeft(PathAVLNode<Key, Value>* node)
+{
+    PathAVLNode<Key, Value>* x = node->right;
+    node->right = x->left;
+    x->left = node;
+    return x;
+}
+
+template<class Key, class Value>
+PathAVLNode<Key, Value>* PathAVLTree<Key, Value>::rotateRight(PathAVLNode<Key, Value>* node)
+{
+    PathAVLNode<Key, Value>* x = node->left;
+    node->left = x->right;
+    x->right = node;
+    return x;
+}
+
+/**
+* Fixes a node whose balance has reached +-2 and returns the new subtree
+* root. heightChanged is false only for the single rotation over a
+* balanced child, which can only happen on removal.
+*/
+template<class Key, class Value>
+PathAVLNode<Key, Value>* PathAVLTree<Key, Value>::rebalance(PathAVLNode<Key, Value>* node, bool& heightChanged)
+{
+    heightChanged = true;
+    if(node->balance == -2)
+    {
+        PathAVLNode<Key, Value>* child = node->left;
+        if(child->balance == 1) // zig-zag
+        {
+            PathAVLNode<Key, Value>* grandchild = child->right;
+            int8_t g = grandchild->balance;
+            node->left = rotateLeft(child);
+            rotateRight(node);
+            child->balance = (g == 1) ? -1 : 0;
+            node->balance = (g == -1) ? 1 : 0;
+            grandchild->balance = 0;
+            return grandchild;
+        }
+
+        rotateRight(node);
+        if(child->balance == 0)
+        {
+            node->balance = -1;
+            child->balance = 1;
+            heightChanged = false;
+        }
+        else
+        {
+            node->balance = 0;
+            child->balance = 0;
+        }
+        return child;
+    }
+    else
+    {
+        PathAVLNode<Key, Value>* child = node->right;
+        if(child->balance == -1) // zig-zag
+        {
+            PathAVLNode<Key, Value>* grandchild = child->left;
+            int8_t g = grandchild->balance;
+            node->right = rotateRight(child);
+            rotateLeft(node);
+            child->balance = (g == -1) ? 1 : 0;
+            node->balance = (g == 1) ? -1 : 0;
+            grandchild->balance = 0;
+            return grandchild;
+        }
+
+        rotateLeft(node);
+        if(child->balance == 0)
+        {
+            node->balance = 1;
+            child->balance = -1;
+            heightChanged = false;
+        }
+        else
+        {
+            node->balance = 0;
+            child->balance = 0;
+        }
+        return child;
+    }
+}
+
+/**
+* Points the link that leads to level of the recorded path at child. Level
+* 0 is the root.
+*/
+template<class Key, class Value>
+void PathAVLTree<Key, Value>::setChild(PathAVLNode<Key, Value>** path, bool* wentRight, int level, PathAVLNode<Key, Value>* child)
+{
+    if(level == 0)
+    {
+        root_ = child;
+    }
+    else if(wentRight[level - 1])
+    {
+        path[level - 1]->right = child;
+    }
+    else
+    {
+        path[level - 1]->left = child;
+    }
+}
+
+/*
+ * Recall: If key is already in the tree, you should
+ * overwrite the current value with the updated value.
+ */
+template<class Key, class Value>
+void PathAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    PathAVLNode<Key, Value>* path[MAX_HEIGHT];
+    bool wentRight[MAX_HEIGHT];
+    int depth = 0;
+
+    PathAVLNode<Key, Value>* current = root_;
+    while(current != nullptr)
+    {
+        path[depth] = current;
+        if(keyValuePair.first < current->item.first)
+        {
+            wentRight[depth++] = false;
+            current = current->left;
+        }
+        else if(current->item.first < keyValuePair.first)
+        {
+            wentRight[depth++] = true;
+            current = current->right;
+        }
+        else
+        {
+            current->item.second = keyValuePair.second;
+            return;
+        }
+    }
+
+    setChild(path, wentRight, depth, new PathAVLNode<Key, Value>(keyValuePair.first, keyValuePair.second));
+
+    // retrace, the subtree below path[i] grew on the wentRight[i] side
+    for(int i = depth - 1; i >= 0; i--)
+    {
+        PathAVLNode<Key, Value>* node = path[i];
+        node->balance += wentRight[i] ? 1 : -1;
+        if(node->balance == 0)
+        {
+            return;
+        }
+        if(node->balance == 2 || node->balance == -2)
+        {
+            bool heightChanged;
+            setChild(path, wentRight, i, rebalance(node, heightChanged));
+            return;
+        }
+    }
+}
+
+/*
+ * A node with two children is replaced by its predecessor. Nodes are
+ * relinked, never copied, and the descent to the predecessor is recorded
+ * on the same stack so the retrace covers it.
+ */
+template<class Key, class Value>
+void PathAVLTree<Key, Value>::remove(const Key& key)
+{
+    PathAVLNode<Key, Value>* path[MAX_HEIGHT];
+    bool wentRight[MAX_HEIGHT];
+    int depth = 0;
+
+    PathAVLNode<Key, Value>* node = root_;
+    while(node != nullptr && (key < node->item.first || node->item.first < key))
+    {
+        path[depth] = node;
+        wentRight[depth++] = node->item.first < key;
+        node = wentRight[depth - 1] ? node->right : node->left;
+    }
+    if(node == nullptr)
+    {
+        return;
+    }
+
+    int nodeLevel = depth;
+    if(node->left == nullptr || node->right == nullptr)
+    {
+        setChild(path, wentRight, nodeLevel, (node->left != nullptr) ? node->left : node->right);
+    }
+    else
+    {
+        path[depth] = node;
+        wentRight[depth++] = false;
+        PathAVLNode<Key, Value>* pred = node->left;
+        while(pred->right != nullptr)
+        {
+            path[depth] = pred;
+            wentRight[depth++] = true;
+            pred = pred->right;
+        }
+
+        // unhook pred, then put it where node was
+        setChild(path, wentRight, depth, pred->left);
+        pred->left = node->left;
+        pred->right = node->right;
+        pred->balance = node->balance;
+        setChild(path, wentRight, nodeLevel, pred);
+        path[nodeLevel] = pred;
+    }
+    delete node;
+
+    // retrace, the subtree below path[i] shrank on the wentRight[i] side
+    for(int i = depth - 1; i >= 0; i--)
+    {
+        PathAVLNode<Key, Value>* current = path[i];
+        current->balance += wentRight[i] ? -1 : 1;
+        if(current->balance == 1 || current->balance == -1)
+        {
+            return;
+        }
+        if(current->balance == 2 || current->balance == -2)
+        {
+            bool heightChanged;
+            setChild(path, wentRight, i, rebalance(current, heightChanged));
+            if(!heightChanged)
+            {
+                return;
+            }
+        }
+    }
+}
+
+template<class Key, class Value>
+int PathAVLTree<Key, Value>::checkHeight(PathAVLNode<Key, Value>* node) const
+{
+    if(node == nullptr)
+    {
+        return 0;
+    }
+    int left = checkHeight(node->left);
+    int right = checkHeight(node->right);
+    if(left < 0 || right < 0 || std::abs(left - right) > 1)
+    {
+        return -1;
+    }
+    return 1 + std::max(left, right);
+}
+
+template<class Key, class Value>
+bool PathAVLTree<Key, Value>::isBalanced() const
+{
+    return checkHeight(root_) >= 0;
+}
+
+template<class Key, class Value>
+typename PathAVLTree<Key, Value>::iterator PathAVLTree<Key, Value>::begin() const
+{
+    iterator it;
+    it.pushLeftSpine(root_);
+    return it;
+}
+
+template<class Key, class Value>
+typename PathAVLTree<Key, Value>::iterator PathAVLTree<Key, Value>::end() const
+{
+    return iterator();
+}
+
+/**
+* Returns an iterator to the item with the given key, or end(). The
+* descent doubles as the iterator's ancestor stack.
+*/
+template<class Key, class Value>
+typename PathAVLTree<Key, Value>::iterator PathAVLTree<Key, Value>::find(const Key& key) const
+{
+    iterator it;
+    PathAVLNode<Key, Value>* current = root_;
+    while(current != nullptr)
+    {
+        it.path_.push_back(current);
+        if(key < current->item.first)
+        {
+            current = current->left;
+        }
+        else if(current->item.first < key)
+        {
+            current = current->right;
+        }
+        else
+        {
+            return it;
+        }
+    }
+    return iterator();
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<class Key, class Value>
+Value& PathAVLTree<Key, Value>::operator[](const Key& key)
+{
+    PathAVLNode<Key, Value>* node = internalFind(key);
+    if(node == nullptr) throw std::out_of_range("Invalid key");
+    return node->item.second;
+}
+
+template<class Key, class Value>
+Value const & PathAVLTree<Key, Value>::operator[](const Key& key) const
+{
+    PathAVLNode<Key, Value>* node = internalFind(key);
+    if(node == nullptr) throw std::out_of_range("Invalid key");
+    return node->item.second;
+}
+
+/*
+  ----------------------------------------------
+  End implementations for the PathAVLTree class.
+  ----------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,108 @@
+#include <iostream>
+#include <cstdlib>
+#include <map>
+#include <vector>
+#include <thread>
+#include "sharded_avl.h"
+#include "test_check.h"
+using namespace std;
+
+typedef ShardedAVLMap<int, int> Sharded;
+
+// every item in order, via forEach
+vector<pair<int, int> > contents(const Sharded& m)
+{
+  vector<pair<int, int> > out;
+  m.forEach([&out](const int& k, const int& v) { out.push_back(make_pair(k, v)); });
+  return out;
+}
+
+void testBasic()
+{
+  vector<int> bounds;
+  bounds.push_back(100);
+  bounds.push_back(200);
+  Sharded m(bounds);
+  for(int i = 0; i < 300; i += 7) m.insert(make_pair(i, i * 10));
+  int v = 0;
+  check("Get across shards", m.get(105, v) && v == 1050 && m.get(7, v) && !m.get(8, v));
+  check("Three shards", m.shardCount() == 3 && m.size() == 43);
+
+  vector<pair<int, int> > out;
+  m.rangeQuery(90, 210, out);
+  bool ok = out.size() == 18 && out.front().first == 91 && out.back().first == 210;
+  for(size_t i = 1; ok && i < out.size(); i++) ok = out[i - 1].first < out[i].first;
+  check("Range spans shards", ok);
+
+  m.remove(105);
+  check("Remove", !m.contains(105) && m.size() == 42);
+
+  bool threw = false;
+  try {
+    vector<int> bad(2, 5);
+    Sharded b(bad);
+  }
+  catch(std::invalid_argument&) {
+    threw = true;
+  }
+  check("Unsorted bounds throw", threw);
+}
+
+void testSplitMerge()
+{
+  Sharded m;
+  map<int, int> ref;
+  for(int i = 0; i < 1000; i++) {
+    m.insert(make_pair(i * 3, i));
+    ref[i * 3] = i;
+  }
+  check("Split", m.splitShard(0) && m.splitShard(2990) && m.shardCount() == 3);
+  vector<size_t> split = m.shardSizes();
+  check("Split sizes add up", split[0] + split[1] + split[2] == 1000 && split[0] > 0 && split[2] > 0);
+  check("Merge", m.mergeShard(0) && m.shardCount() == 2 && !m.mergeShard(2990));
+  vector<pair<int, int> > all = contents(m);
+  check("Contents survive", all == vector<pair<int, int> >(ref.begin(), ref.end()));
+
+  Sharded grow(64);
+  for(int i = 0; i < 5000; i++) grow.insert(make_pair((i * 7919) % 5000, i));
+  vector<size_t> sizes = grow.shardSizes();
+  bool capped = grow.size() == 5000 && sizes.size() > 1;
+  for(size_t i = 0; i < sizes.size(); i++) capped = capped && sizes[i] <= 64;
+  check("Auto split caps shard size", capped);
+}
+
+void testConcurrent()
+{
+  Sharded m(256);
+  vector<thread> writers;
+  for(int t = 0; t < 4; t++) {
+    writers.push_back(thread([&m, t]() {
+      for(int i = 0; i < 20000; i++) {
+        int k = (i * 7919 % 20000) * 4 + t; // each thread owns distinct keys
+        m.insert(make_pair(k, t));
+        if(i % 5 == 0) m.remove(k);
+      }
+    }));
+  }
+  thread resizer([&m]() {
+    for(int i = 0; i < 200; i++) {
+      m.mergeShard(i * 400);
+      m.splitShard(i * 400);
+    }
+  });
+  for(size_t t = 0; t < writers.size(); t++) writers[t].join();
+  resizer.join();
+
+  vector<pair<int, int> > all = contents(m);
+  bool ordered = all.size() == m.size();
+  for(size_t i = 1; ordered && i < all.size(); i++) ordered = all[i - 1].first < all[i].first;
+  check("Concurrent writers and resizes", ordered && m.size() == 64000);
+}
+
+int main()
+{
+  testBasic();
+  testSplitMerge();
+  testConcurrent();
+  return failures;
+}
@@ -0,0 +1,483 @@
+#ifndef SHARDED_AVL_H
+#define SHARDED_AVL_H
+
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include "augmented_avl.h"
+
+/**
+* An ordered map split by key range across several AVLTree shards, each
+* behind its own mutex, so writers to different shards do not contend.
+* Shard i holds the keys in [bound i - 1, bound i); the first and last
+* shards are open ended.
+*
+* The shard layout is an immutable directory swapped atomically whenever
+* a shard is split or merged, so lookups never wait for a resize. A
+* lookup that raced with one notices, after locking its shard, that the
+* shard no longer covers its key and retries.
+*
+* Ordered walks and range queries visit one shard at a time under that
+* shard's lock: each shard's part is consistent, the walk as a whole is
+* not a snapshot. Key must be default constructible and copyable.
+*/
+template <class Key, class Value>
+class ShardedAVLMap
+{
+public:
+    // maxShardSize > 0 splits any shard that grows past it.
+    explicit ShardedAVLMap(size_t maxShardSize = 0);
+    // Starts with one shard per gap between the (sorted, distinct) bounds.
+    ShardedAVLMap(const std::vector<Key>& bounds, size_t maxShardSize = 0);
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    bool get(const Key& key, Value& value) const; // copies the value out
+    bool contains(const Key& key) const;
+    size_t size() const;
+    bool empty() const;
+
+    // Appends, in key order, every item with lo <= key <= hi.
+    void rangeQuery(const Key& lo, const Key& hi, std::vector<std::pair<Key, Value> >& out) const;
+    // Calls fn(key, value) on every item in key order, holding that item's
+    // shard lock; fn must not call back into the map.
+    template<class Fn>
+    void forEach(Fn fn) const;
+
+    // Splits the shard holding key around its middle (its tree's root).
+    // Returns false if that shard has fewer than two items.
+    bool splitShard(const Key& key);
+    // Merges the shard holding key into one with its right neighbour.
+    // Returns false if it is the last shard.
+    bool mergeShard(const Key& key);
+    size_t shardCount() const;
+    std::vector<size_t> shardSizes() const;
+
+protected:
+    // The tree of one shard, with the extras the map needs from it. Each
+    // node counts its subtree, so a split knows how many items it moved.
+    class ShardTree : public AugmentedAVLTree<Key, Value, CountAggregate>
+    {
+    public:
+        bool put(const std::pair<const Key, Value>& keyValuePair); // true if the key is new
+        bool erase(const Key& key);                              // true if the key was there
+        const Key& middleKey() const;                            // root key, tree must not be empty
+        template<class Fn>
+        void visit(const Key* lo, const Key* hi, Fn& fn);        // in order, nullptr bounds are open
+    };
+
+    struct Shard
+    {
+        Shard() : size(0), hasLower(false), hasUpper(false) {}
+        bool covers(const Key* key) const; // nullptr stands for below every key
+
+        std::mutex mutex;
+        ShardTree tree;
+        size_t size;
+        // Current bounds, changed only under mutex. A shard merged away
+        // covers nothing.
+        bool hasLower;
+        bool hasUpper;
+        Key lower;
+        Key upper;
+    };
+
+    // Immutable once published. bounds[i] is the lower bound of shards[i + 1].
+    struct Directory
+    {
+        std::vector<Key> bounds;
+        std::vector<std::shared_ptr<Shard> > shards;
+        size_t locate(const Key* key) const;
+    };
+
+    // Add helper functions here
+    bool splitAbove(const Key& key, size_t limit); // splitShard, if the shard holds more than limit items
+    std::shared_ptr<Shard> lockShard(const Key* key, std::unique_lock<std::mutex>& lock) const;
+    std::shared_ptr<const Directory> directory() const;
+    template<class Fn>
+    void walk(const Key* lo, const Key* hi, Fn& fn) const;
+
+protected:
+    std::shared_ptr<const Directory> directory_; // read and replaced with atomic_load/atomic_store
+    std::mutex resizeMutex_;                     // serializes splits and merges
+    size_t maxShardSize_;
+};
+
+/*
+  ------------------------------------------------------------
+  Begin implementations for the ShardedAVLMap helper classes.
+  ------------------------------------------------------------
+*/
+
+template<class Key, class Value>
+bool ShardedAVLMap<Key, Value>::ShardTree::put(const std::pair<const Key, Value>& keyValuePair)
+{
+    bool created;
+    AVLNode<Key, Value>* node = this->findOrCreateNode(keyValuePair.first, keyValuePair.second, created);
+    if(!created)
+    {
+        node->setValue(keyValuePair.second);
+    }
+    return created;
+}
+
+template<class Key, class Value>
+bool ShardedAVLMap<Key, Value>::ShardTree::erase(const Key& key)
+{
+    Node<Key, Value>* node = this->internalFind(key);
+    if(node == nullptr)
+    {
+        return false;
+    }
+    this->removeNode(node);
+    return true;
+}
+
+template<class Key, class Value>
+const Key& ShardedAVLMap<Key, Value>::ShardTree::middleKey() const
+{
+    return this->root_->getKey();
+}
+
+template<class Key, class Value>
+template<class Fn>
+void ShardedAVLMap<Key, Value>::ShardTree::visit(const Key* lo, const Key* hi, Fn& fn)
+{
+    this->visitParallel(static_cast<AVLNode<Key, Value>*>(this->root_), lo, hi, fn, 1);
+}
+
+template<class Key, class Value>
+bool ShardedAVLMap<Key, Value>::Shard::covers(const Key* key) const
+{
+    if(key == nullptr)
+    {
+        return !hasLower; // only the first shard, which is never merged away
+    }
+    return (!hasLower || !(*key < lower)) && (!hasUpper || *key < upper);
+}
+
+/**
+* The shard whose range holds key: the number of bounds <= key.
+*/
+template<class Key, class Value>
+size_t ShardedAVLMap<Key, Value>::Directory::locate(const Key* key) const
+{
+    if(key == nullptr)
+    {
+        return 0;
+    }
+    return std::upper_bound(bounds.begin(), bounds.end(), *key) - bounds.begin();
+}
+
+/*
+  ----------------------------------------------------------
+  End implementations for the ShardedAVLMap helper classes.
+  ----------------------------------------------------------
+*/
+
+/*
+  -------------------------------------------------
+  Begin implementations for the ShardedAVLMap class.
+  -------------------------------------------------
+*/
+
+template<class Key, class Value>
+ShardedAVLMap<Key, Value>::ShardedAVLMap(size_t maxShardSize) : maxShardSize_(maxShardSize)
+{
+    std::shared_ptr<Directory> dir(new Directory);
+    dir->shards.push_back(std::shared_ptr<Shard>(new Shard));
+    directory_ = dir;
+}
+
+template<class Key, class Value>
+ShardedAVLMap<Key, Value>::ShardedAVLMap(const std::vector<Key>& bounds, size_t maxShardSize) :
+    maxShardSize_(maxShardSize)
+{
+    std::shared_ptr<Directory> dir(new Directory);
+    dir->bounds = bounds;
+    for(size_t i = 0; i <= bounds.size(); i++)
+    {
+        if(i > 0 && i < bounds.size() && !(bounds[i - 1] < bounds[i]))
+        {
+            throw std::invalid_argument("ShardedAVLMap bounds must be sorted and distinct");
+        }
+        std::shared_ptr<Shard> shard(new Shard);
+        shard->hasLower = i > 0;
+        shard->hasUpper = i < bounds.size();
+        if(shard->hasLower)
+        {
+            shard->lower = bounds[i - 1];
+        }
+        if(shard->hasUpper)
+        {
+            shard->upper = bounds[i];
+        }
+        dir->shards.push_back(shard);
+    }
+    directory_ = dir;
+}
+
+template<class Key, class Value>
+std::shared_ptr<const typename ShardedAVLMap<Key, Value>::Directory> ShardedAVLMap<Key, Value>::directory() const
+{
+    return std::atomic_load(&directory_);
+}
+
+/**
+* Locks and returns the shard that covers key, retrying if a split or
+* merge moved key elsewhere between the directory read and the lock.
+*/
+template<class Key, class Value>
+std::shared_ptr<typename ShardedAVLMap<Key, Value>::Shard>
+ShardedAVLMap<Key, Value>::lockShard(const Key* key, std::unique_lock<std::mutex>& lock) const
+{
+    while(true)
+    {
+        std::shared_ptr<const Directory> dir = directory();
+        std::shared_ptr<Shard> shard = dir->shards[dir->locate(key)];
+        lock = std::unique_lock<std::mutex>(shard->mutex);
+        if(shard->covers(key))
+        {
+            return shard;
+        }
+        lock.unlock();
+    }
+}
+
+template<class Key, class Value>
+void ShardedAVLMap<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    bool tooBig;
+    {
+        std::unique_lock<std::mutex> lock;
+        std::shared_ptr<Shard> shard = lockShard(&keyValuePair.first, lock);
+        if(shard->tree.put(keyValuePair))
+        {
+            shard->size++;
+        }
+        tooBig = maxShardSize_ > 0 && shard->size > maxShardSize_;
+    }
+    if(tooBig)
+    {
+        splitAbove(keyValuePair.first, maxShardSize_); // another insert may have split it already
+    }
+}
+
+template<class Key, class Value>
+void ShardedAVLMap<Key, Value>::remove(const Key& key)
+{
+    std::unique_lock<std::mutex> lock;
+    std::shared_ptr<Shard> shard = lockShard(&key, lock);
+    if(shard->tree.erase(key))
+    {
+        shard->size--;
+    }
+}
+
+template<class Key, class Value>
+bool ShardedAVLMap<Key, Value>::get(const Key& key, Value& value) const
+{
+    std::unique_lock<std::mutex> lock;
+    std::shared_ptr<Shard> shard = lockShard(&key, lock);
+    typename AVLTree<Key, Value>::iterator it = shard->tree.find(key);
+    if(it == shard->tree.end())
+    {
+        return false;
+    }
+    value = it->second;
+    return true;
+}
+
+template<class Key, class Value>
+bool ShardedAVLMap<Key, Value>::contains(const Key& key) const
+{
+    std::unique_lock<std::mutex> lock;
+    std::shared_ptr<Shard> shard = lockShard(&key, lock);
+    return shard->tree.find(key) != shard->tree.end();
+}
+
+template<class Key, class Value>
+size_t ShardedAVLMap<Key, Value>::size() const
+{
+    std::vector<size_t> sizes = shardSizes();
+    size_t total = 0;
+    for(size_t i = 0; i < sizes.size(); i++)
+    {
+        total += sizes[i];
+    }
+    return total;
+}
+
+template<class Key, class Value>
+bool ShardedAVLMap<Key, Value>::empty() const
+{
+    return size() == 0;
+}
+
+template<class Key, class Value>
+void ShardedAVLMap<Key, Value>::rangeQuery(const Key& lo, const Key& hi, std::vector<std::pair<Key, Value> >& out) const
+{
+    if(hi < lo)
+    {
+        return;
+    }
+    auto collect = [&out](const Key& key, const Value& value) { out.push_back(std::make_pair(key, value)); };
+    walk(&lo, &hi, collect);
+}
+
+template<class Key, class Value>
+template<class Fn>
+void ShardedAVLMap<Key, Value>::forEach(Fn fn) const
+{
+    walk(nullptr, nullptr, fn);
+}
+
+/**
+* Moves a cursor through the key space one shard at a time. Each step
+* locks the shard covering the cursor, visits its keys from the cursor
+* up to hi, then moves the cursor to that shard's upper bound. Going by
+* key rather than by directory slot means a shard split or merged during
+* the walk is neither skipped nor visited twice.
+*/
+template<class Key, class Value>
+template<class Fn>
+void ShardedAVLMap<Key, Value>::walk(const Key* lo, const Key* hi, Fn& fn) const
+{
+    Key cursor;
+    const Key* from = lo;
+    while(true)
+    {
+        std::unique_lock<std::mutex> lock;
+        std::shared_ptr<Shard> shard = lockShard(from, lock);
+        auto visit = [&fn](const Key& key, Value& value) { fn(key, static_cast<const Value&>(value)); };
+        shard->tree.visit(from, hi, visit);
+
+        if(!shard->hasUpper || (hi != nullptr && *hi < shard->upper))
+        {
+            return;
+        }
+        cursor = shard->upper;
+        from = &cursor;
+    }
+}
+
+template<class Key, class Value>
+bool ShardedAVLMap<Key, Value>::splitShard(const Key& key)
+{
+    return splitAbove(key, 1);
+}
+
+/**
+* Splits the tree at its root key, which for an AVL tree leaves between a
+* third and two thirds on each side, and publishes a directory with the
+* new shard. The moved half's size is its root's count, so the whole
+* split is O(log n) and both sizes are right before anyone sees the new
+* shard.
+*/
+template<class Key, class Value>
+bool ShardedAVLMap<Key, Value>::splitAbove(const Key& key, size_t limit)
+{
+    std::lock_guard<std::mutex> resize(resizeMutex_);
+    std::shared_ptr<const Directory> dir = directory();
+    size_t index = dir->locate(&key);
+    std::shared_ptr<Shard> shard = dir->shards[index];
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    if(shard->size <= limit)
+    {
+        return false;
+    }
+
+    Key at = shard->tree.middleKey();
+    if(shard->tree.begin()->first == at)
+    {
+        // a two item tree can have the smaller key at the root
+        typename AVLTree<Key, Value>::iterator second = shard->tree.begin();
+        ++second;
+        at = second->first;
+    }
+
+    std::shared_ptr<Shard> upper(new Shard);
+    shard->tree.split(at, upper->tree);
+    upper->size = upper->tree.aggregate();
+    shard->size -= upper->size;
+    upper->hasLower = true;
+    upper->lower = at;
+    upper->hasUpper = shard->hasUpper;
+    upper->upper = shard->upper;
+    shard->hasUpper = true;
+    shard->upper = at;
+
+    std::shared_ptr<Directory> next(new Directory(*dir));
+    next->bounds.insert(next->bounds.begin() + index, at);
+    next->shards.insert(next->shards.begin() + index + 1, upper);
+    std::atomic_store(&directory_, std::shared_ptr<const Directory>(next));
+    return true;
+}
+
+/**
+* Moves everything in the right neighbour into the shard holding key and
+* drops the neighbour from the directory. The neighbour is left covering
+* nothing, so anyone who still reaches it retries.
+*/
+template<class Key, class Value>
+bool ShardedAVLMap<Key, Value>::mergeShard(const Key& key)
+{
+    std::lock_guard<std::mutex> resize(resizeMutex_);
+    std::shared_ptr<const Directory> dir = directory();
+    size_t index = dir->locate(&key);
+    if(index + 1 >= dir->shards.size())
+    {
+        return false;
+    }
+    std::shared_ptr<Shard> left = dir->shards[index];
+    std::shared_ptr<Shard> right = dir->shards[index + 1];
+    std::lock_guard<std::mutex> leftLock(left->mutex);
+    std::lock_guard<std::mutex> rightLock(right->mutex);
+
+    left->tree.merge(right->tree);
+    left->size += right->size;
+    left->hasUpper = right->hasUpper;
+    left->upper = right->upper;
+    right->size = 0;
+    right->hasUpper = true;
+    right->upper = right->lower; // empty range
+
+    std::shared_ptr<Directory> next(new Directory(*dir));
+    next->bounds.erase(next->bounds.begin() + index);
+    next->shards.erase(next->shards.begin() + index + 1);
+    std::atomic_store(&directory_, std::shared_ptr<const Directory>(next));
+    return true;
+}
+
+template<class Key, class Value>
+size_t ShardedAVLMap<Key, Value>::shardCount() const
+{
+    return directory()->shards.size();
+}
+
+template<class Key, class Value>
+std::vector<size_t> ShardedAVLMap<Key, Value>::shardSizes() const
+{
+    std::shared_ptr<const Directory> dir = directory();
+    std::vector<size_t> sizes;
+    for(size_t i = 0; i < dir->shards.size(); i++)
+    {
+        std::lock_guard<std::mutex> lock(dir->shards[i]->mutex);
+        sizes.push_back(dir->shards[i]->size);
+    }
+    return sizes;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the ShardedAVLMap class.
+  -----------------------------------------------
+*/
+
+#endif
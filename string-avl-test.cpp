@@ -0,0 +1,134 @@
+#include <iostream>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+#include "string_avl.h"
+#include "test_check.h"
+using namespace std;
+
+// Keys over a tiny alphabet that includes 0 and 0xff bytes, with long
+// shared prefixes and keys that are prefixes of each other.
+string randomKey()
+{
+  static const char alphabet[] = { 'a', 'b', '\0', '\xff' };
+  string key = rand() % 2 ? "https://example.com/" : "";
+  int len = rand() % 12;
+  for(int i = 0; i < len; i++) key += alphabet[rand() % 4];
+  return key;
+}
+
+bool sameItems(const StringAVLTree<int>& tree, const map<string, int>& m)
+{
+  map<string, int>::const_iterator mi = m.begin();
+  for(StringAVLTree<int>::iterator it = tree.begin(); it != tree.end(); ++it, ++mi) {
+    if(mi == m.end() || it->first != mi->first || it->second != mi->second) return false;
+  }
+  return mi == m.end();
+}
+
+void testAgainstMap()
+{
+  StringAVLTree<int> tree;
+  map<string, int> m;
+  srand(49);
+  bool findsOk = true;
+  for(int i = 0; i < 20000; i++) {
+    string key = randomKey();
+    int op = rand() % 4;
+    if(op == 0) {
+      tree.remove(key);
+      m.erase(key);
+    }
+    else if(op == 1) {
+      StringAVLTree<int>::iterator it = tree.find(key);
+      map<string, int>::iterator mi = m.find(key);
+      findsOk = findsOk && (it == tree.end()) == (mi == m.end()) && (mi == m.end() || it->second == mi->second);
+      findsOk = findsOk && (tree.tryGet(key) == nullptr) == (mi == m.end());
+    }
+    else {
+      tree.insert(make_pair(key, i));
+      m[key] = i;
+    }
+  }
+  check("Finds match", findsOk);
+  check("Items match", sameItems(tree, m));
+  check("Balanced", tree.isBalanced() && tree.verify());
+}
+
+void testSharedPrefixes()
+{
+  StringAVLTree<int> tree;
+  map<string, int> m;
+  string base(200, 'x');
+  for(int i = 0; i < 1000; i++) {
+    string key = base + to_string((i * 7919) % 1000);
+    tree.insert(make_pair(key, i));
+    m[key] = i;
+  }
+  bool ok = true;
+  for(int i = 0; i < 1100; i++) {
+    string key = base + to_string(i);
+    ok = ok && (tree.tryGet(key) != nullptr) == (m.count(key) == 1);
+  }
+  check("Long prefixes", ok && sameItems(tree, m));
+
+  bool threw = false;
+  try {
+    tree[base + "missing"];
+  }
+  catch(std::out_of_range&) {
+    threw = true;
+  }
+  check("Missing key throws", threw && tree[base + "7"] == m[base + "7"]);
+}
+
+void testPrefixRange()
+{
+  StringAVLTree<int> tree;
+  map<string, int> m;
+  srand(490);
+  for(int i = 0; i < 3000; i++) {
+    string key = randomKey();
+    tree.insert(make_pair(key, i));
+    m[key] = i;
+  }
+
+  bool ok = true;
+  for(int q = 0; q < 300; q++) {
+    string prefix = randomKey().substr(0, rand() % 24);
+    pair<StringAVLTree<int>::iterator, StringAVLTree<int>::iterator> range = tree.prefixRange(prefix);
+    map<string, int>::iterator mi = m.lower_bound(prefix);
+    StringAVLTree<int>::iterator it = range.first;
+    for(; it != range.second; ++it, ++mi) {
+      ok = ok && mi != m.end() && it->first == mi->first && it->first.compare(0, prefix.size(), prefix) == 0;
+    }
+    ok = ok && (mi == m.end() || mi->first.compare(0, prefix.size(), prefix) != 0);
+  }
+  check("Prefix ranges", ok);
+
+  pair<StringAVLTree<int>::iterator, StringAVLTree<int>::iterator> all = tree.prefixRange("");
+  pair<StringAVLTree<int>::iterator, StringAVLTree<int>::iterator> none = tree.prefixRange("zzz");
+  check("Empty and missing prefixes", all.first == tree.begin() && all.second == tree.end() && none.first == none.second);
+}
+
+void testInsertPaths()
+{
+  StringAVLTree<int> tree;
+  tree.getOrInsert("b", 1)++;
+  tree.getOrInsert("b", 5)++;
+  tree.upsert("a", 10, plus<int>());
+  tree.upsert("a", 5, plus<int>());
+  tree.insert(make_pair(string("c"), 3)); // appended under the rightmost node
+  tree.erase(tree.find("b"));
+  check("Insert paths", tree.begin()->second == 15 && !tree.tryGet("b") && tree["c"] == 3 && tree.verify());
+}
+
+int main()
+{
+  testAgainstMap();
+  testSharedPrefixes();
+  testPrefixRange();
+  testInsertPaths();
+  return failures;
+}
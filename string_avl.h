@@ -0,0 +1,502 @@
+#ifndef STRING_AVL_H
+#define STRING_AVL_H
+
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <algorithm>
+#include "avlbst.h"
+
+/**
+* An AVLNode with a string key that also caches a window of 8 key bytes,
+* packed big endian and zero padded, starting at the node's offset. The
+* offset is where the keys around the node stop sharing a prefix, so the
+* window holds the bytes a search reaching the node actually has to
+* compare. Comparing two packed windows as integers orders the keys
+* whenever they differ, without touching the key's character buffer,
+* which for keys past the small string limit is a separate allocation.
+*/
+template <typename Value>
+class StringAVLNode : public AVLNode<std::string, Value>
+{
+public:
+    static const size_t WINDOW_BYTES = 8;
+
+    StringAVLNode(const std::string& key, const Value& value, AVLNode<std::string, Value>* parent);
+    virtual ~StringAVLNode();
+
+    uint64_t getWindow() const;
+    size_t getOffset() const;
+    void setOffset(size_t offset); // repacks the window
+
+    static uint64_t packWindow(const std::string& key, size_t offset);
+
+protected:
+    uint64_t window_;
+    uint32_t offset_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the StringAVLNode class.
+  -------------------------------------------------
+*/
+
+template<typename Value>
+const size_t StringAVLNode<Value>::WINDOW_BYTES;
+
+/**
+* Offset 0, the key's first bytes, is right for any position in the tree.
+*/
+template<typename Value>
+StringAVLNode<Value>::StringAVLNode(const std::string& key, const Value& value, AVLNode<std::string, Value>* parent) :
+    AVLNode<std::string, Value>(key, value, parent), window_(packWindow(key, 0)), offset_(0)
+{
+
+}
+
+template<typename Value>
+StringAVLNode<Value>::~StringAVLNode()
+{
+
+}
+
+template<typename Value>
+uint64_t StringAVLNode<Value>::getWindow() const
+{
+    return window_;
+}
+
+template<typename Value>
+size_t StringAVLNode<Value>::getOffset() const
+{
+    return offset_;
+}
+
+template<typename Value>
+void StringAVLNode<Value>::setOffset(size_t offset)
+{
+    if(offset != offset_)
+    {
+        offset_ = (uint32_t)offset;
+        window_ = packWindow(this->getKey(), offset);
+    }
+}
+
+/**
+* The byte at offset lands in the top 8 bits, so integer order is byte
+* order. A key ending inside the window is padded with zeros; that only
+* ties it with keys that continue with zero bytes, and ties fall back to
+* the full compare.
+*/
+template<typename Value>
+uint64_t StringAVLNode<Value>::packWindow(const std::string& key, size_t offset)
+{
+    const char* bytes = key.data() + offset;
+    uint64_t packed = 0;
+    if(key.size() >= offset + WINDOW_BYTES)
+    {
+        std::memcpy(&packed, bytes, WINDOW_BYTES);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        packed = __builtin_bswap64(packed);
+#endif
+        return packed;
+    }
+    size_t n = key.size() > offset ? key.size() - offset : 0;
+    for(size_t i = 0; i < n; i++)
+    {
+        packed |= (uint64_t)(unsigned char)bytes[i] << (8 * (WINDOW_BYTES - 1 - i));
+    }
+    return packed;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the StringAVLNode class.
+  -----------------------------------------------
+*/
+
+/**
+* An AVL tree keyed by std::string that is tuned for long keys sharing
+* long prefixes (paths, URLs, composite keys).
+*
+* The descent remembers how many leading bytes the search key shares with
+* the nearest smaller and larger keys seen so far. Every key below lies
+* between them and so shares at least the smaller of the two, and those
+* bytes are never compared again: a lookup compares O(length + height)
+* bytes instead of O(length * height), with one three-way compare per
+* level where AVLTree makes up to two.
+*
+* A new node's window offset is that shared length at the point it was
+* inserted, which is exactly what later searches will have matched on
+* arriving there, so most steps are decided by the window alone.
+* Rotations and removes can only widen a node's bounds, and lower its
+* offset to match. Any offset up to what the search has matched is
+* correct; a node whose window starts past it, e.g. one placed by a join
+* or a rebuild, just falls back to comparing the key's bytes.
+*
+* find, tryGet, operator[], remove and everything built on insert use the
+* fast descent. Order is the same as std::string's operator<.
+*/
+template <class Value>
+class StringAVLTree : public AVLTree<std::string, Value>
+{
+public:
+    typedef typename AVLTree<std::string, Value>::iterator iterator;
+
+    virtual void remove(const std::string& key);
+
+    iterator find(const std::string& key) const;
+    Value& operator[](const std::string& key);
+    Value const & operator[](const std::string& key) const;
+    Value* tryGet(const std::string& key);
+    const Value* tryGet(const std::string& key) const;
+
+    // First item with a key >= key, or end().
+    iterator lowerBound(const std::string& key) const;
+    // The items whose keys start with prefix, as [first, second) in order.
+    std::pair<iterator, iterator> prefixRange(const std::string& prefix) const;
+
+protected:
+    typedef StringAVLNode<Value> StringNode;
+
+    virtual AVLNode<std::string, Value>* createNode(const std::string& key, const Value& value, AVLNode<std::string, Value>* parent);
+    virtual AVLNode<std::string, Value>* findOrCreateNode(const std::string& key, const Value& value, bool& created);
+    virtual void updateAfterRotate(AVLNode<std::string, Value>* lower, AVLNode<std::string, Value>* upper);
+    virtual void nodeSwap(AVLNode<std::string, Value>* n1, AVLNode<std::string, Value>* n2);
+    virtual void removeNode(Node<std::string, Value>* node);
+
+    // Add helper functions here
+    // Three-way compare of key against node's key. The first known bytes
+    // are taken as equal; matched is set to the length of their common prefix.
+    static int compareKey(const std::string& key, StringNode* node, size_t known, size_t& matched);
+    // The node holding key, or nullptr. On a miss parent and goLeft say
+    // where key would be attached and shared is how much of key the
+    // neighbours there have in common with it.
+    StringNode* descend(const std::string& key, StringNode*& parent, bool& goLeft, size_t& shared) const;
+    StringNode* lowerBoundNode(const std::string& key) const;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the StringAVLTree class.
+  -------------------------------------------------
+*/
+
+template<class Value>
+AVLNode<std::string, Value>* StringAVLTree<Value>::createNode(const std::string& key, const Value& value, AVLNode<std::string, Value>* parent)
+{
+    return new StringNode(key, value, parent);
+}
+
+/**
+* Upper takes over lower's old place and bounds, which are at least as
+* wide as its own were. Lower's bounds only narrow.
+*/
+template<class Value>
+void StringAVLTree<Value>::updateAfterRotate(AVLNode<std::string, Value>* lower, AVLNode<std::string, Value>* upper)
+{
+    StringNode* up = static_cast<StringNode*>(upper);
+    up->setOffset(std::min(up->getOffset(), static_cast<StringNode*>(lower)->getOffset()));
+}
+
+/**
+* Each node takes the other's place, so both get the smaller offset.
+*/
+template<class Value>
+void StringAVLTree<Value>::nodeSwap(AVLNode<std::string, Value>* n1, AVLNode<std::string, Value>* n2)
+{
+    AVLTree<std::string, Value>::nodeSwap(n1, n2);
+    StringNode* a = static_cast<StringNode*>(n1);
+    StringNode* b = static_cast<StringNode*>(n2);
+    size_t offset = std::min(a->getOffset(), b->getOffset());
+    a->setOffset(offset);
+    b->setOffset(offset);
+}
+
+/**
+* The child of the node that is unlinked moves up into its place. With
+* two children that node is the predecessor, after the swap.
+*/
+template<class Value>
+void StringAVLTree<Value>::removeNode(Node<std::string, Value>* found)
+{
+    StringNode* gone = static_cast<StringNode*>(found);
+    size_t offset = gone->getOffset();
+    if(gone->getLeft() != nullptr && gone->getRight() != nullptr)
+    {
+        gone = static_cast<StringNode*>(this->predecessor(gone));
+        offset = std::min(offset, gone->getOffset());
+    }
+    StringNode* child = static_cast<StringNode*>(gone->getLeft() != nullptr ? gone->getLeft() : gone->getRight());
+    if(child != nullptr)
+    {
+        child->setOffset(std::min(child->getOffset(), offset));
+    }
+    AVLTree<std::string, Value>::removeNode(found);
+}
+
+/**
+* When the node's window starts within the known bytes it decides the
+* compare if the windows differ, and their first differing byte bounds
+* the match. Otherwise, or if they tie, the scan resumes past whatever is
+* known to be equal.
+*/
+template<class Value>
+int StringAVLTree<Value>::compareKey(const std::string& key, StringNode* node, size_t known, size_t& matched)
+{
+    const std::string& nodeKey = node->getKey();
+    size_t common = std::min(key.size(), nodeKey.size());
+    size_t offset = node->getOffset();
+    if(offset <= known && known < offset + StringNode::WINDOW_BYTES)
+    {
+        uint64_t keyWindow = StringNode::packWindow(key, offset);
+        uint64_t nodeWindow = node->getWindow();
+        if(keyWindow != nodeWindow)
+        {
+            uint64_t diff = keyWindow ^ nodeWindow;
+            size_t same = 0;
+            while(!(diff & ((uint64_t)0xff << (8 * (StringNode::WINDOW_BYTES - 1 - same)))))
+            {
+                same++;
+            }
+            matched = std::min(offset + same, common);
+            return keyWindow < nodeWindow ? -1 : 1;
+        }
+        known = std::min(common, offset + StringNode::WINDOW_BYTES);
+    }
+
+    const char* a = key.data();
+    const char* b = nodeKey.data();
+    size_t i = known;
+    while(i < common && a[i] == b[i])
+    {
+        i++;
+    }
+    matched = i;
+    if(i < common)
+    {
+        return (unsigned char)a[i] < (unsigned char)b[i] ? -1 : 1;
+    }
+    if(key.size() == nodeKey.size())
+    {
+        return 0;
+    }
+    return key.size() < nodeKey.size() ? -1 : 1;
+}
+
+/**
+* lowMatch and highMatch are the prefixes key shares with the last node
+* we went right from and the last one we went left from. Until both
+* sides have been seen nothing is known.
+*/
+template<class Value>
+typename StringAVLTree<Value>::StringNode*
+StringAVLTree<Value>::descend(const std::string& key, StringNode*& parent, bool& goLeft, size_t& shared) const
+{
+    size_t lowMatch = 0;
+    size_t highMatch = 0;
+    StringNode* current = static_cast<StringNode*>(this->root_);
+    parent = nullptr;
+    goLeft = false;
+
+    while(current != nullptr)
+    {
+        size_t matched;
+        int cmp = compareKey(key, current, std::min(lowMatch, highMatch), matched);
+        if(cmp == 0)
+        {
+            break;
+        }
+        parent = current;
+        goLeft = cmp < 0;
+        if(goLeft)
+        {
+            highMatch = matched;
+            current = static_cast<StringNode*>(current->getLeft());
+        }
+        else
+        {
+            lowMatch = matched;
+            current = static_cast<StringNode*>(current->getRight());
+        }
+    }
+    shared = std::min(lowMatch, highMatch);
+    return current;
+}
+
+template<class Value>
+typename StringAVLTree<Value>::StringNode*
+StringAVLTree<Value>::lowerBoundNode(const std::string& key) const
+{
+    size_t lowMatch = 0;
+    size_t highMatch = 0;
+    StringNode* current = static_cast<StringNode*>(this->root_);
+    StringNode* best = nullptr;
+
+    while(current != nullptr)
+    {
+        size_t matched;
+        int cmp = compareKey(key, current, std::min(lowMatch, highMatch), matched);
+        if(cmp == 0)
+        {
+            return current;
+        }
+        if(cmp < 0)
+        {
+            best = current;
+            highMatch = matched;
+            current = static_cast<StringNode*>(current->getLeft());
+        }
+        else
+        {
+            lowMatch = matched;
+            current = static_cast<StringNode*>(current->getRight());
+        }
+    }
+    return best;
+}
+
+/**
+* Same contract as AVLTree's, including the append shortcut, but with the
+* prefix-skipping descent. The new leaf's bounds are the last nodes the
+* descent turned at, so the length key shares with both is its offset.
+*/
+template<class Value>
+AVLNode<std::string, Value>* StringAVLTree<Value>::findOrCreateNode(const std::string& key, const Value& value, bool& created)
+{
+    created = true;
+    if(this->root_ == nullptr)
+    {
+        this->root_ = createNode(key, value, nullptr);
+        this->rightmost_ = static_cast<AVLNode<std::string, Value>*>(this->root_);
+        return this->rightmost_;
+    }
+
+    size_t matched;
+    if(compareKey(key, static_cast<StringNode*>(this->rightmost_), 0, matched) > 0)
+    {
+        AVLNode<std::string, Value>* newNode = createNode(key, value, this->rightmost_);
+        this->attachNode(this->rightmost_, newNode, false);
+        return newNode;
+    }
+
+    StringNode* parent;
+    bool goLeft;
+    size_t shared;
+    StringNode* found = descend(key, parent, goLeft, shared);
+    if(found != nullptr)
+    {
+        created = false;
+        return found;
+    }
+    StringNode* newNode = static_cast<StringNode*>(createNode(key, value, parent));
+    newNode->setOffset(shared);
+    this->attachNode(parent, newNode, goLeft);
+    return newNode;
+}
+
+template<class Value>
+void StringAVLTree<Value>::remove(const std::string& key)
+{
+    StringNode* parent;
+    bool goLeft;
+    size_t shared;
+    StringNode* found = descend(key, parent, goLeft, shared);
+    if(found == nullptr)
+    {
+        return;
+    }
+    this->removeNode(found);
+}
+
+template<class Value>
+typename StringAVLTree<Value>::iterator StringAVLTree<Value>::find(const std::string& key) const
+{
+    StringNode* parent;
+    bool goLeft;
+    size_t shared;
+    return this->makeIterator(descend(key, parent, goLeft, shared));
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<class Value>
+Value& StringAVLTree<Value>::operator[](const std::string& key)
+{
+    Value* value = tryGet(key);
+    if(value == nullptr) throw std::out_of_range("Invalid key");
+    return *value;
+}
+
+template<class Value>
+Value const & StringAVLTree<Value>::operator[](const std::string& key) const
+{
+    const Value* value = tryGet(key);
+    if(value == nullptr) throw std::out_of_range("Invalid key");
+    return *value;
+}
+
+template<class Value>
+Value* StringAVLTree<Value>::tryGet(const std::string& key)
+{
+    StringNode* parent;
+    bool goLeft;
+    size_t shared;
+    StringNode* node = descend(key, parent, goLeft, shared);
+    return node == nullptr ? nullptr : &node->getValue();
+}
+
+template<class Value>
+const Value* StringAVLTree<Value>::tryGet(const std::string& key) const
+{
+    StringNode* parent;
+    bool goLeft;
+    size_t shared;
+    StringNode* node = descend(key, parent, goLeft, shared);
+    return node == nullptr ? nullptr : &node->getValue();
+}
+
+template<class Value>
+typename StringAVLTree<Value>::iterator StringAVLTree<Value>::lowerBound(const std::string& key) const
+{
+    return this->makeIterator(lowerBoundNode(key));
+}
+
+/**
+* The range ends at the first key not starting with prefix, which is the
+* lower bound of prefix with its last byte below 0xff incremented and the
+* 0xff bytes after it dropped. A prefix of only 0xff bytes runs to end().
+*/
+template<class Value>
+std::pair<typename StringAVLTree<Value>::iterator, typename StringAVLTree<Value>::iterator>
+StringAVLTree<Value>::prefixRange(const std::string& prefix) const
+{
+    iterator first = lowerBound(prefix);
+    std::string limit(prefix);
+    while(!limit.empty() && (unsigned char)limit[limit.size() - 1] == 0xff)
+    {
+        limit.erase(limit.size() - 1);
+    }
+    if(limit.empty())
+    {
+        return std::make_pair(first, this->end());
+    }
+    limit[limit.size() - 1] = (char)((unsigned char)limit[limit.size() - 1] + 1);
+    return std::make_pair(first, lowerBound(limit));
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the StringAVLTree class.
+  -----------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <iostream>
+#include <string>
+
+/*
+ * The result helper shared by the test drivers. Each check prints its
+ * message and 1 or 0, and main returns failures, so a driver exits
+ * non-zero exactly when a check failed.
+ */
+
+static int failures = 0;
+
+static void check(const std::string& msg, bool ok)
+{
+    std::cout << msg << ": " << ok << std::endl;
+    if(!ok) failures++;
+}
+
+#endif
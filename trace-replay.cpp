@@ -0,0 +1,96 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include "tree_trace.h"
+using namespace std;
+
+// usage: trace-replay trace [bst|avl|map|all]
+//
+// Loads a trace written by TracedTree/TraceWriter and replays it against
+// each container, printing throughput and per-op latency percentiles.
+
+const char* OP_NAMES[TRACE_OP_END] = { "", "insert", "remove", "find", "begin", "advance", "clear" };
+
+void printLatency(const string& name, const TraceLatency& latency)
+{
+  cout << "  " << left << setw(10) << name << right << setw(10) << latency.count << fixed << setprecision(0)
+       << setw(9) << latency.p50 << setw(9) << latency.p90 << setw(9) << latency.p99
+       << setw(10) << latency.p999 << setw(11) << latency.max << endl;
+}
+
+void printStats(const string& name, const TraceReplayStats& stats)
+{
+  cout << name << ": " << stats.records << " records in " << fixed << setprecision(1) << stats.totalMs << " ms, "
+       << setprecision(2) << (stats.records / stats.totalMs / 1000) << " M records/s, "
+       << stats.findHits << " find hits, " << stats.steps << " steps" << endl;
+  cout << "  " << left << setw(10) << "ns" << right << setw(10) << "count" << setw(9) << "p50" << setw(9) << "p90"
+       << setw(9) << "p99" << setw(10) << "p99.9" << setw(11) << "max" << endl;
+  for(int op = TRACE_INSERT; op < TRACE_OP_END; op++) {
+    if(stats.perOp[op].count != 0) printLatency(OP_NAMES[op], stats.perOp[op]);
+  }
+  printLatency("all", stats.all);
+}
+
+template<typename Key, typename Value>
+int replay(const string& path, const string& which)
+{
+  vector<TraceRecord<Key, Value> > records;
+  if(!readTrace(path, records)) cout << "trace ends in a partial record, replaying the rest" << endl;
+  if(which == "all" || which == "bst") {
+    BinarySearchTree<Key, Value> tree;
+    printStats("BinarySearchTree", replayTrace(records, tree));
+  }
+  if(which == "all" || which == "avl") {
+    AVLTree<Key, Value> tree;
+    printStats("AVLTree", replayTrace(records, tree));
+  }
+  if(which == "all" || which == "map") {
+    map<Key, Value> tree;
+    printStats("std::map", replayTrace(records, tree));
+  }
+  return 0;
+}
+
+template<typename Key>
+int replayValues(const string& path, const string& which, uint8_t valueCode)
+{
+  switch(valueCode) {
+    case TraceTypeCode<int>::CODE: return replay<Key, int>(path, which);
+    case TraceTypeCode<long long>::CODE: return replay<Key, long long>(path, which);
+    case TraceTypeCode<string>::CODE: return replay<Key, string>(path, which);
+  }
+  cout << "unsupported value type " << (int)valueCode << endl;
+  return 1;
+}
+
+int main(int argc, char* argv[])
+{
+  if(argc < 2) {
+    cout << "usage: trace-replay trace [bst|avl|map|all]" << endl;
+    return 1;
+  }
+  string which = argc > 2 ? argv[2] : "all";
+  if(which != "all" && which != "bst" && which != "avl" && which != "map") {
+    cout << "unknown container " << which << endl;
+    return 1;
+  }
+  try {
+    ifstream in(argv[1], ios::binary);
+    uint8_t keyCode, valueCode;
+    readTraceHeader(in, keyCode, valueCode);
+    switch(keyCode) {
+      case TraceTypeCode<int>::CODE: return replayValues<int>(argv[1], which, valueCode);
+      case TraceTypeCode<long long>::CODE: return replayValues<long long>(argv[1], which, valueCode);
+      case TraceTypeCode<string>::CODE: return replayValues<string>(argv[1], which, valueCode);
+    }
+    cout << "unsupported key type " << (int)keyCode << endl;
+  }
+  catch(std::exception& e) {
+    cout << e.what() << endl;
+  }
+  return 1;
+}
@@ -0,0 +1,86 @@
+#include <iostream>
+#include <cstdlib>
+#include "treap.h"
+#include "test_check.h"
+using namespace std;
+
+// in-order keys must be strictly increasing
+template<typename Key, typename Value>
+bool sorted(Treap<Key, Value>& t)
+{
+  bool first = true;
+  Key prev = Key();
+  for(typename Treap<Key, Value>::iterator it = t.begin(); it != t.end(); ++it) {
+    if(!first && !(prev < it->first)) return false;
+    prev = it->first;
+    first = false;
+  }
+  return true;
+}
+
+template<typename Key, typename Value>
+int count(Treap<Key, Value>& t)
+{
+  int n = 0;
+  for(typename Treap<Key, Value>::iterator it = t.begin(); it != t.end(); ++it) n++;
+  return n;
+}
+
+void testInsertRemove()
+{
+  Treap<int, int> t;
+  for(int i = 0; i < 1000; i++) t.insert(make_pair(i, i * 2));
+  t.insert(make_pair(10, -1));
+  check("Insert sorted", sorted(t) && count(t) == 1000);
+  check("Overwrite", t[10] == -1);
+
+  for(int i = 0; i < 1000; i += 2) t.remove(i);
+  check("Remove evens", sorted(t) && count(t) == 500 && t.find(4) == t.end() && t[5] == 10);
+}
+
+void testSplitMerge()
+{
+  Treap<int, int> t, greater;
+  for(int i = 0; i < 200; i++) t.insert(make_pair((i * 37) % 200, i));
+
+  t.split(120, greater);
+  check("Split sizes", count(t) == 120 && count(greater) == 80);
+  check("Split order", sorted(t) && sorted(greater) &&
+        greater.begin()->first == 120 && greater.find(119) == greater.end());
+
+  t.merge(greater);
+  check("Merge", sorted(t) && count(t) == 200 && greater.empty());
+
+  Treap<int, int> overlap;
+  overlap.insert(make_pair(5, 5));
+  bool threw = false;
+  try {
+    t.merge(overlap);
+  }
+  catch(std::invalid_argument&) {
+    threw = true;
+  }
+  check("Merge overlap throws", threw && count(t) == 200);
+}
+
+// Filter while scanning, checked against the priorities after every erase.
+void testEraseIterator()
+{
+  Treap<int, int> t;
+  for(int i = 0; i < 1000; i++) t.insert(make_pair((i * 37) % 1000, i));
+  t.setVerifyEachOp(true);
+  Treap<int, int>::iterator it = t.begin();
+  while(it != t.end()) {
+    if(it->first % 3 == 0) it = t.erase(it);
+    else ++it;
+  }
+  check("Erase iterator", sorted(t) && count(t) == 666 && t.verify() && t.find(3) == t.end());
+}
+
+int main()
+{
+  testInsertRemove();
+  testSplitMerge();
+  testEraseIterator();
+  return failures;
+}
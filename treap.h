@@ -0,0 +1,385 @@
+#ifndef TREAP_H
+#define TREAP_H
+
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstdint>
+#include <functional>
+#include "bst.h"
+
+/**
+* A randomized search tree. Balance comes from a heap order on
+* priorities instead of a balance field: every node's priority is at
+* least as large as its children's. The priority is derived from a hash
+* of the key, so a Treap uses plain Node objects and carries no extra
+* data per node.
+*
+* Because a treap is fully determined by its set of keys, whole trees
+* can be split and merged along a single root-to-leaf path.
+*/
+template <class Key, class Value>
+class Treap : public BinarySearchTree<Key, Value>
+{
+public:
+    virtual void insert (const std::pair<const Key, Value> &new_item);
+    virtual void remove(const Key& key);
+    // A treap's shape is fixed by its keys' priorities, so this does nothing.
+    virtual void rebalance();
+
+    // Moves every item with a key >= key into greater (which is cleared first).
+    void split(const Key& key, Treap<Key, Value>& greater);
+    // Appends every item of greater, whose keys must all be larger than ours.
+    void merge(Treap<Key, Value>& greater);
+
+protected:
+    // Add helper functions here
+    static size_t priority(const Key& key); // hashed, so nothing is stored per node
+    Node<Key, Value>* getLargestNode() const;
+
+    // verify hooks: no child may outrank its parent
+    virtual bool checkNode(Node<Key, Value>* node, int leftHeight, int rightHeight) const;
+    virtual bool checkPathNode(Node<Key, Value>* node) const;
+    static bool heapOrdered(Node<Key, Value>* node);
+    virtual void removeNode(Node<Key, Value>* node);
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the Treap class.
+  -------------------------------------------------
+*/
+
+/**
+* Mixes the key's hash (splitmix64 finalizer) so that keys with trivial
+* hashes, e.g. sequential integers, still get well spread priorities.
+*/
+template<class Key, class Value>
+size_t Treap<Key, Value>::priority(const Key& key)
+{
+    uint64_t h = static_cast<uint64_t>(std::hash<Key>()(key));
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return static_cast<size_t>(h);
+}
+
+/**
+* Returns the node holding the largest key, or nullptr if empty.
+*/
+template<class Key, class Value>
+Node<Key, Value>* Treap<Key, Value>::getLargestNode() const
+{
+    Node<Key, Value>* node = this->root_;
+    while(node != nullptr && node->getRight() != nullptr)
+    {
+        node = node->getRight();
+    }
+    return node;
+}
+
+/**
+* Deliberately empty. The hashed priorities fix the treap's shape: every
+* set of keys has exactly one heap-ordered tree, expected O(log n) deep.
+* The base class's DSW rebuild would break heap order, and verify() and
+* later inserts would then fail. The override keeps rebalance() safe
+* through a BinarySearchTree reference.
+*/
+template<class Key, class Value>
+void Treap<Key, Value>::rebalance()
+{
+    // nothing to do: the shape is already the only heap-ordered one
+}
+
+template<class Key, class Value>
+bool Treap<Key, Value>::checkNode(Node<Key, Value>* node, int leftHeight, int rightHeight) const
+{
+    return heapOrdered(node);
+}
+
+/**
+* A rotation moves the old parent under a path node, so the children of
+* path nodes are checked as well.
+*/
+template<class Key, class Value>
+bool Treap<Key, Value>::checkPathNode(Node<Key, Value>* node) const
+{
+    return heapOrdered(node) && (node->getLeft() == nullptr || heapOrdered(node->getLeft())) &&
+           (node->getRight() == nullptr || heapOrdered(node->getRight()));
+}
+
+template<class Key, class Value>
+bool Treap<Key, Value>::heapOrdered(Node<Key, Value>* node)
+{
+    size_t prio = priority(node->getKey());
+    return (node->getLeft() == nullptr || priority(node->getLeft()->getKey()) <= prio) &&
+           (node->getRight() == nullptr || priority(node->getRight()->getKey()) <= prio);
+}
+
+/*
+ * Inserts as a leaf like the plain BST, then rotates the new node up
+ * while its priority beats its parent's. If the key is already in the
+ * tree the value is overwritten.
+ */
+template<class Key, class Value>
+void Treap<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+{
+    if(this->root_ == nullptr)
+    {
+        this->root_ = new Node<Key, Value>(new_item.first, new_item.second, nullptr);
+        return;
+    }
+
+    Node<Key, Value>* current = this->root_;
+    Node<Key, Value>* parent = nullptr;
+
+    while(current != nullptr)
+    {
+        parent = current;
+        if(new_item.first < current->getKey())
+        {
+            current = current->getLeft();
+        }
+        else if(new_item.first > current->getKey())
+        {
+            current = current->getRight();
+        }
+        else
+        {
+            current->setValue(new_item.second);
+            return;
+        }
+    }
+
+    Node<Key, Value>* newNode = new Node<Key, Value>(new_item.first, new_item.second, parent);
+    if(new_item.first < parent->getKey())
+    {
+        parent->setLeft(newNode);
+    }
+    else
+    {
+        parent->setRight(newNode);
+    }
+
+    // restore heap order, the expected number of rotations is below 2
+    size_t prio = priority(newNode->getKey());
+    while(newNode->getParent() != nullptr && prio > priority(newNode->getParent()->getKey()))
+    {
+        parent = newNode->getParent();
+        if(parent->getLeft() == newNode)
+        {
+            this->rotateRight(parent);
+        }
+        else
+        {
+            this->rotateLeft(parent);
+        }
+    }
+    if(this->verifyEachOp_)
+    {
+        this->verifyPath(newNode, "Treap::insert");
+    }
+}
+
+template<class Key, class Value>
+void Treap<Key, Value>::remove(const Key& key)
+{
+    Node<Key, Value>* node = this->internalFind(key);
+    if(node == nullptr)
+    {
+        return;
+    }
+    removeNode(node);
+}
+
+/*
+ * Rotates the node down towards its higher priority child until it has
+ * at most one child, then splices it out. No predecessor swap is needed.
+ */
+template<class Key, class Value>
+void Treap<Key, Value>::removeNode(Node<Key, Value>* node)
+{
+
+    while(node->getLeft() != nullptr && node->getRight() != nullptr)
+    {
+        if(priority(node->getLeft()->getKey()) > priority(node->getRight()->getKey()))
+        {
+            this->rotateRight(node);
+        }
+        else
+        {
+            this->rotateLeft(node);
+        }
+    }
+
+    Node<Key, Value>* child = (node->getLeft() != nullptr) ? node->getLeft() : node->getRight();
+    Node<Key, Value>* parent = node->getParent();
+    if(child != nullptr)
+    {
+        child->setParent(parent);
+    }
+
+    if(parent == nullptr)
+    {
+        this->root_ = child;
+    }
+    else if(parent->getLeft() == node)
+    {
+        parent->setLeft(child);
+    }
+    else
+    {
+        parent->setRight(child);
+    }
+
+    delete node;
+    if(this->verifyEachOp_)
+    {
+        this->verifyPath(parent != nullptr ? parent : this->root_, "Treap::remove");
+    }
+}
+
+/**
+* Splits along the search path for key: nodes with smaller keys are
+* chained onto the right spine of this tree and the rest onto the left
+* spine of greater. The path is already in priority order, so no
+* rotations are needed and the cost is O(depth).
+*/
+template<class Key, class Value>
+void Treap<Key, Value>::split(const Key& key, Treap<Key, Value>& greater)
+{
+    if(&greater == this)
+    {
+        return;
+    }
+    greater.clear();
+
+    Node<Key, Value>* current = this->root_;
+    Node<Key, Value>* lessTail = nullptr;    // last node taken for this tree, right link open
+    Node<Key, Value>* greaterTail = nullptr; // last node taken for greater, left link open
+    this->root_ = nullptr;
+
+    while(current != nullptr)
+    {
+        if(current->getKey() < key)
+        {
+            if(lessTail == nullptr)
+            {
+                this->root_ = current;
+            }
+            else
+            {
+                lessTail->setRight(current);
+            }
+            current->setParent(lessTail);
+            lessTail = current;
+            current = current->getRight();
+        }
+        else
+        {
+            if(greaterTail == nullptr)
+            {
+                greater.root_ = current;
+            }
+            else
+            {
+                greaterTail->setLeft(current);
+            }
+            current->setParent(greaterTail);
+            greaterTail = current;
+            current = current->getLeft();
+        }
+    }
+
+    if(lessTail != nullptr)
+    {
+        lessTail->setRight(nullptr);
+    }
+    if(greaterTail != nullptr)
+    {
+        greaterTail->setLeft(nullptr);
+    }
+}
+
+/**
+* Zips the right spine of this tree with the left spine of greater in
+* priority order. Runs in O(depth) and leaves greater empty.
+*/
+template<class Key, class Value>
+void Treap<Key, Value>::merge(Treap<Key, Value>& greater)
+{
+    if(&greater == this || greater.root_ == nullptr)
+    {
+        return;
+    }
+
+    Node<Key, Value>* largest = getLargestNode();
+    Node<Key, Value>* smallest = greater.getSmallestNode();
+    if(largest != nullptr && !(largest->getKey() < smallest->getKey()))
+    {
+        throw std::invalid_argument("Treap::merge keys overlap");
+    }
+
+    Node<Key, Value>* a = this->root_;
+    Node<Key, Value>* b = greater.root_;
+    Node<Key, Value>* parent = nullptr;
+    bool attachRight = false;
+    this->root_ = nullptr;
+    greater.root_ = nullptr;
+
+    while(a != nullptr || b != nullptr)
+    {
+        Node<Key, Value>* next;
+        if(b == nullptr || (a != nullptr && priority(a->getKey()) > priority(b->getKey())))
+        {
+            next = a;
+        }
+        else
+        {
+            next = b;
+        }
+
+        if(parent == nullptr)
+        {
+            this->root_ = next;
+        }
+        else if(attachRight)
+        {
+            parent->setRight(next);
+        }
+        else
+        {
+            parent->setLeft(next);
+        }
+        next->setParent(parent);
+
+        // once one side runs out the other is attached whole
+        if(a == nullptr || b == nullptr)
+        {
+            break;
+        }
+
+        parent = next;
+        if(next == a)
+        {
+            attachRight = true;
+            a = a->getRight();
+        }
+        else
+        {
+            attachRight = false;
+            b = b->getLeft();
+        }
+    }
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the Treap class.
+  -----------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,662 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <thread>
+#include <fstream>
+#include <functional>
+#include "bst.h"
+#include "avlbst.h"
+#include "treap.h"
+#include "compact_avl.h"
+#include "path_avl.h"
+#include "interval_tree.h"
+#include "durable_avl.h"
+#include "string_avl.h"
+#include "tree_export.h"
+using namespace std;
+
+// Wall clock timer, started on construction.
+class BenchTimer
+{
+public:
+  BenchTimer() : start_(chrono::steady_clock::now()) {}
+  double ms() const
+  {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start_).count();
+  }
+private:
+  chrono::steady_clock::time_point start_;
+};
+
+void report(const string& name, size_t ops, double ms)
+{
+  cout << "  " << left << setw(36) << name << right << fixed << setprecision(1)
+       << setw(10) << ms << " ms" << setw(10) << (ms * 1e6 / ops) << " ns/op" << endl;
+}
+
+// 0..n-1 in random order, same sequence on every run
+vector<int> shuffledKeys(size_t n, unsigned seed = 104)
+{
+  vector<int> keys(n);
+  for(size_t i = 0; i < n; i++) keys[i] = (int)i;
+  shuffle(keys.begin(), keys.end(), mt19937(seed));
+  return keys;
+}
+
+// Insert then remove every key, timing each phase separately.
+template<typename Tree>
+void benchWriteMix(const string& name, const vector<int>& insertOrder, const vector<int>& removeOrder)
+{
+  Tree tree;
+  BenchTimer insertTimer;
+  for(size_t i = 0; i < insertOrder.size(); i++) {
+    tree.insert(make_pair(insertOrder[i], insertOrder[i]));
+  }
+  report(name + " insert", insertOrder.size(), insertTimer.ms());
+
+  BenchTimer removeTimer;
+  for(size_t i = 0; i < removeOrder.size(); i++) {
+    tree.remove(removeOrder[i]);
+  }
+  report(name + " remove", removeOrder.size(), removeTimer.ms());
+}
+
+void benchTreapWrites(size_t n)
+{
+  vector<int> ins = shuffledKeys(n, 1), rem = shuffledKeys(n, 2);
+  cout << "random writes, n = " << n << endl;
+  benchWriteMix<AVLTree<int, int> >("AVLTree", ins, rem);
+  benchWriteMix<Treap<int, int> >("Treap", ins, rem);
+
+  vector<int> seq(n);
+  for(size_t i = 0; i < n; i++) seq[i] = (int)i;
+  cout << "sequential writes, n = " << n << endl;
+  benchWriteMix<AVLTree<int, int> >("AVLTree", seq, seq);
+  benchWriteMix<Treap<int, int> >("Treap", seq, seq);
+}
+
+// Time-ordered ingest: plain insert (right-edge fast path), end() hint,
+// and a hint that trails the previous insert.
+void benchAppend(size_t n)
+{
+  cout << "sequential ingest, n = " << n << endl;
+  {
+    AVLTree<int, int> tree;
+    BenchTimer timer;
+    for(size_t i = 0; i < n; i++) tree.insert(make_pair((int)i, (int)i));
+    report("AVLTree insert(pair)", n, timer.ms());
+  }
+  {
+    AVLTree<int, int> tree;
+    BenchTimer timer;
+    for(size_t i = 0; i < n; i++) tree.insert(tree.end(), make_pair((int)i, (int)i));
+    report("AVLTree insert(end(), pair)", n, timer.ms());
+  }
+  {
+    // descending keys, each one lands right before the previous
+    AVLTree<int, int> tree;
+    AVLTree<int, int>::iterator hint = tree.end();
+    BenchTimer timer;
+    for(size_t i = n; i > 0; i--) hint = tree.insert(hint, make_pair((int)i, (int)i));
+    report("AVLTree insert(prev, pair) desc", n, timer.ms());
+  }
+  {
+    Treap<int, int> tree;
+    BenchTimer timer;
+    for(size_t i = 0; i < n; i++) tree.insert(make_pair((int)i, (int)i));
+    report("Treap insert(pair)", n, timer.ms());
+  }
+}
+
+// Random insert and lookup on the pointer based and the index based AVL
+// tree. Lookups touch fewer cache lines when nodes are denser.
+template<typename Tree>
+void benchInsertFind(const string& name, const vector<int>& keys, const vector<int>& probes)
+{
+  Tree tree;
+  BenchTimer insertTimer;
+  for(size_t i = 0; i < keys.size(); i++) tree.insert(make_pair(keys[i], keys[i]));
+  report(name + " insert", keys.size(), insertTimer.ms());
+
+  long sum = 0;
+  BenchTimer findTimer;
+  for(size_t i = 0; i < probes.size(); i++) sum += tree.find(probes[i])->second;
+  report(name + " find", probes.size(), findTimer.ms());
+  if(sum == 42) cout << "";
+}
+
+void benchCompact(size_t n)
+{
+  vector<int> keys = shuffledKeys(n, 3), probes = shuffledKeys(n, 4);
+  cout << "int -> int node size: AVLNode " << sizeof(AVLNode<int, int>)
+       << " bytes + allocator overhead, compact pool 20 bytes" << endl;
+  cout << "random insert/find, n = " << n << endl;
+  benchInsertFind<AVLTree<int, int> >("AVLTree", keys, probes);
+  benchInsertFind<CompactAVLTree<int, int> >("CompactAVLTree", keys, probes);
+}
+
+// Write path with and without parent pointers: random insert, find and
+// remove, plus a full in-order scan.
+template<typename Tree>
+void benchReadWrite(const string& name, const vector<int>& keys, const vector<int>& probes)
+{
+  benchInsertFind<Tree>(name, keys, probes);
+
+  Tree tree;
+  for(size_t i = 0; i < keys.size(); i++) tree.insert(make_pair(keys[i], keys[i]));
+  long sum = 0;
+  BenchTimer scanTimer;
+  for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it) sum += it->second;
+  report(name + " scan", keys.size(), scanTimer.ms());
+
+  BenchTimer removeTimer;
+  for(size_t i = 0; i < probes.size(); i++) tree.remove(probes[i]);
+  report(name + " remove", probes.size(), removeTimer.ms());
+  if(sum == 42) cout << "";
+}
+
+void benchParentless(size_t n)
+{
+  vector<int> keys = shuffledKeys(n, 5), probes = shuffledKeys(n, 6);
+  cout << "int -> int node size: AVLNode " << sizeof(AVLNode<int, int>)
+       << ", PathAVLNode " << sizeof(PathAVLNode<int, int>) << endl;
+  cout << "random ops, n = " << n << endl;
+  benchReadWrite<AVLTree<int, int> >("AVLTree", keys, probes);
+  benchReadWrite<PathAVLTree<int, int> >("PathAVLTree", keys, probes);
+}
+
+// Stabbing queries on n random short intervals, against a linear scan
+// over the same intervals.
+void benchStabbing(size_t n)
+{
+  const int span = 1 << 30;
+  mt19937 rng(7);
+  vector<Interval<int> > all;
+  IntervalTree<int, int> tree;
+  BenchTimer buildTimer;
+  for(size_t i = 0; i < n; i++) {
+    int lo = (int)(rng() % span);
+    Interval<int> interval(lo, lo + (int)(rng() % 1000));
+    tree.insert(make_pair(interval, (int)i));
+    all.push_back(interval);
+  }
+  cout << "stabbing queries, n = " << n << endl;
+  report("IntervalTree insert", n, buildTimer.ms());
+
+  const size_t queries = 100000, scans = 20;
+  size_t hits = 0;
+  vector<IntervalTree<int, int>::iterator> out;
+  BenchTimer queryTimer;
+  for(size_t q = 0; q < queries; q++) {
+    out.clear();
+    tree.overlapping((int)(rng() % span), out);
+    hits += out.size();
+  }
+  report("IntervalTree overlapping(point)", queries, queryTimer.ms());
+
+  BenchTimer scanTimer;
+  for(size_t q = 0; q < scans; q++) {
+    int point = (int)(rng() % span);
+    for(size_t i = 0; i < all.size(); i++) {
+      if(all[i].lo <= point && point <= all[i].hi) hits++;
+    }
+  }
+  report("linear scan", scans, scanTimer.ms());
+  cout << "  (" << hits << " hits)" << endl;
+}
+
+// Drops the middle tenth of n sequential keys, as one range erase and as
+// a loop of remove on an identical tree.
+void benchRangeErase(size_t n)
+{
+  int lo = (int)(n / 2), hi = lo + (int)(n / 10) - 1;
+  AVLTree<int, int> ranged, looped;
+  for(size_t i = 0; i < n; i++) {
+    ranged.insert(make_pair((int)i, (int)i));
+    looped.insert(make_pair((int)i, (int)i));
+  }
+  cout << "erase " << (hi - lo + 1) << " contiguous keys, n = " << n << endl;
+
+  BenchTimer rangeTimer;
+  ranged.erase(lo, hi);
+  report("AVLTree erase(lo, hi)", hi - lo + 1, rangeTimer.ms());
+
+  BenchTimer loopTimer;
+  for(int k = lo; k <= hi; k++) looped.remove(k);
+  report("AVLTree remove loop", hi - lo + 1, loopTimer.ms());
+}
+
+// Building from n unsorted pairs: a loop of insert against buildParallel
+// at increasing thread counts.
+void benchBuild(size_t n)
+{
+  vector<int> keys = shuffledKeys(n, 8);
+  vector<pair<int, int> > items(n);
+  for(size_t i = 0; i < n; i++) items[i] = make_pair(keys[i], (int)i);
+  cout << "build from unsorted input, n = " << n
+       << ", hardware threads = " << thread::hardware_concurrency() << endl;
+
+  {
+    AVLTree<int, int> tree;
+    BenchTimer timer;
+    for(size_t i = 0; i < n; i++) tree.insert(items[i]);
+    report("AVLTree insert loop", n, timer.ms());
+  }
+  for(unsigned threads = 1; threads <= 16; threads *= 2) {
+    AVLTree<int, int> tree;
+    BenchTimer timer;
+    tree.buildParallel(items.begin(), items.end(), threads);
+    report("AVLTree buildParallel, " + to_string(threads) + " threads", n, timer.ms());
+  }
+}
+
+// Summing every value: iterator loop against parallelReduce, and a value
+// rewrite with parallelTransformValues, at increasing thread counts.
+void benchParallelScan(size_t n)
+{
+  AVLTree<int, long> tree;
+  for(size_t i = 0; i < n; i++) tree.insert(make_pair((int)i, (long)i));
+  cout << "scan, n = " << n << ", hardware threads = " << thread::hardware_concurrency() << endl;
+
+  long sum = 0;
+  BenchTimer loopTimer;
+  for(AVLTree<int, long>::iterator it = tree.begin(); it != tree.end(); ++it) sum += it->second;
+  report("AVLTree iterator sum", n, loopTimer.ms());
+
+  for(unsigned threads = 1; threads <= 16; threads *= 2) {
+    BenchTimer reduceTimer;
+    sum += tree.parallelReduce(0L, [](long a, long b) { return a + b; }, threads);
+    report("AVLTree parallelReduce, " + to_string(threads) + " threads", n, reduceTimer.ms());
+    BenchTimer transformTimer;
+    tree.parallelTransformValues([](const int&, const long& v) { return v + 1; }, threads);
+    report("AVLTree parallelTransformValues, " + to_string(threads), n, transformTimer.ms());
+  }
+  if(sum == 42) cout << "";
+}
+
+// Batches of random lookups on a tree much larger than the last level
+// cache: a loop of find against findMany.
+void benchFindMany(size_t n)
+{
+  vector<int> keys = shuffledKeys(n, 9);
+  AVLTree<int, int> tree;
+  for(size_t i = 0; i < n; i++) tree.insert(make_pair(keys[i], keys[i]));
+  cout << "batched lookups, n = " << n << endl;
+
+  // batch 1 is a plain iterative descent with nothing to overlap, which
+  // separates the prefetching gain from the cost of find's recursion
+  mt19937 rng(10);
+  const size_t total = 2000000;
+  for(size_t batch = 1; batch <= 1024; batch *= (batch == 1 ? 16 : 8)) {
+    vector<int> probes(batch);
+    vector<AVLTree<int, int>::iterator> out;
+    long sum = 0;
+
+    double loopMs = 0, manyMs = 0;
+    for(size_t done = 0; done < total; done += batch) {
+      for(size_t i = 0; i < batch; i++) probes[i] = (int)(rng() % n);
+      BenchTimer loopTimer;
+      for(size_t i = 0; i < batch; i++) sum += tree.find(probes[i])->second;
+      loopMs += loopTimer.ms();
+      for(size_t i = 0; i < batch; i++) probes[i] = (int)(rng() % n);
+      BenchTimer manyTimer;
+      tree.findMany(probes, out);
+      for(size_t i = 0; i < batch; i++) sum += out[i]->second;
+      manyMs += manyTimer.ms();
+    }
+    report("find loop, batch " + to_string(batch), total, loopMs);
+    report("findMany, batch " + to_string(batch), total, manyMs);
+    if(sum == 42) cout << "";
+  }
+}
+
+// Sorted inserts, which leave a plain BST as a linked list, into the
+// scapegoat mode and the AVL tree, then finds on the result.
+void benchScapegoat(size_t n)
+{
+  vector<int> probes = shuffledKeys(n, 12);
+  cout << "sorted inserts, n = " << n << endl;
+  for(int mode = 0; mode < 2; mode++) {
+    BinarySearchTree<int, int>* tree = mode == 0 ? new BinarySearchTree<int, int>(0.7) : new AVLTree<int, int>();
+    string name = mode == 0 ? "scapegoat 0.7" : "AVLTree";
+    BenchTimer insertTimer;
+    for(size_t i = 0; i < n; i++) tree->insert(make_pair((int)i, (int)i));
+    report(name + " insert", n, insertTimer.ms());
+    long sum = 0;
+    BenchTimer findTimer;
+    for(size_t i = 0; i < n; i++) sum += tree->find(probes[i])->second;
+    report(name + " find", n, findTimer.ms());
+    if(sum == 42) cout << "";
+    delete tree;
+  }
+  BinarySearchTree<int, int> plain;
+  size_t small = min(n, (size_t)20000);
+  for(size_t i = 0; i < small; i++) plain.insert(make_pair((int)i, (int)i));
+  BenchTimer rebalanceTimer;
+  plain.rebalance();
+  report("plain BST rebalance, n = " + to_string(small), small, rebalanceTimer.ms());
+}
+
+// One shape walk over a big AVL tree, on one thread and on several.
+void benchShape(size_t n)
+{
+  AVLTree<int, int> tree;
+  for(size_t i = 0; i < n; i++) tree.insert(make_pair((int)i, (int)i));
+  cout << "shape analysis, n = " << n << endl;
+  for(unsigned threads = 1; threads <= 4; threads *= 2) {
+    BenchTimer timer;
+    TreeShape shape = tree.shape(threads);
+    report("shape, " + to_string(threads) + " threads", n, timer.ms());
+    if(shape.nodes != n) cout << "wrong node count" << endl;
+  }
+  BenchTimer timer;
+  bool balanced = tree.isBalanced();
+  report("isBalanced", n, timer.ms());
+  if(!balanced) cout << "not balanced" << endl;
+}
+
+// Dumps a large tree in each export format to a file.
+void benchExport(size_t n)
+{
+  vector<pair<int, int> > items;
+  for(size_t i = 0; i < n; i++) items.push_back(make_pair((int)i, (int)i));
+  AVLTree<int, int> tree;
+  tree.buildParallel(items.begin(), items.end(), 1);
+  cout << "export, n = " << n << endl;
+  const char* names[] = { "DOT", "JSON", "summary" };
+  for(int format = EXPORT_DOT; format <= EXPORT_SUMMARY; format++) {
+    ofstream out("tree-bench.out", ios::binary);
+    BenchTimer timer;
+    exportTree(out, TreeRootAccess::root(tree), BstNodeAccess(), (ExportFormat)format);
+    report(string("export ") + names[format] + ", " + to_string(out.tellp() >> 20) + " MB", n, timer.ms());
+  }
+  std::remove("tree-bench.out");
+}
+
+// Random inserts and removes with and without the per-op path checks,
+// then one full verify() pass over the result.
+void benchVerify(size_t n)
+{
+  vector<int> keys = shuffledKeys(n, 44);
+  cout << "invariant checks, n = " << n << endl;
+  for(int checked = 0; checked < 2; checked++) {
+    AVLTree<int, int> tree;
+    tree.setVerifyEachOp(checked == 1);
+    string name = checked ? "checked" : "unchecked";
+    BenchTimer insertTimer;
+    for(size_t i = 0; i < n; i++) tree.insert(make_pair(keys[i], keys[i]));
+    report(name + " insert", n, insertTimer.ms());
+    BenchTimer removeTimer;
+    for(size_t i = 0; i < n; i += 2) tree.remove(keys[i]);
+    report(name + " remove", n / 2, removeTimer.ms());
+    if(checked) {
+      BenchTimer verifyTimer;
+      bool valid = tree.verify();
+      report("verify", n - n / 2, verifyTimer.ms());
+      if(!valid) cout << "invalid tree" << endl;
+    }
+  }
+}
+
+// Counter increments over n / 10 keys: find then insert (two descents),
+// operator[] with the miss caught, and upsert.
+void benchUpsert(size_t n)
+{
+  vector<int> keys(n);
+  mt19937 rng(47);
+  for(size_t i = 0; i < n; i++) keys[i] = (int)(rng() % (n / 10 + 1));
+  cout << "counter increments, n = " << n << endl;
+  {
+    AVLTree<int, int> tree;
+    BenchTimer timer;
+    for(size_t i = 0; i < n; i++) {
+      AVLTree<int, int>::iterator it = tree.find(keys[i]);
+      tree.insert(make_pair(keys[i], it == tree.end() ? 1 : it->second + 1));
+    }
+    report("find + insert", n, timer.ms());
+  }
+  {
+    AVLTree<int, int> tree;
+    BenchTimer timer;
+    for(size_t i = 0; i < n; i++) {
+      try {
+        tree[keys[i]]++;
+      }
+      catch(std::out_of_range&) {
+        tree.insert(make_pair(keys[i], 1));
+      }
+    }
+    report("operator[] + insert on miss", n, timer.ms());
+  }
+  {
+    AVLTree<int, int> tree;
+    BenchTimer timer;
+    for(size_t i = 0; i < n; i++) tree.upsert(keys[i], 1, plus<int>());
+    report("upsert", n, timer.ms());
+  }
+  {
+    AVLTree<int, int> tree;
+    BenchTimer timer;
+    for(size_t i = 0; i < n; i++) tree.getOrInsert(keys[i], 0)++;
+    report("getOrInsert", n, timer.ms());
+  }
+}
+
+// Filter-while-scanning: drop every other key, by erase(iterator) and by
+// collecting the keys and calling remove on each.
+void benchEraseScan(size_t n)
+{
+  vector<int> keys = shuffledKeys(n, 48);
+  cout << "filter scan, n = " << n << endl;
+  {
+    AVLTree<int, int> tree;
+    for(size_t i = 0; i < n; i++) tree.insert(make_pair(keys[i], keys[i]));
+    BenchTimer timer;
+    AVLTree<int, int>::iterator it = tree.begin();
+    while(it != tree.end()) {
+      if(it->first % 2 == 1) it = tree.erase(it);
+      else ++it;
+    }
+    report("erase(iterator)", n, timer.ms());
+  }
+  {
+    AVLTree<int, int> tree;
+    for(size_t i = 0; i < n; i++) tree.insert(make_pair(keys[i], keys[i]));
+    BenchTimer timer;
+    vector<int> doomed;
+    for(AVLTree<int, int>::iterator it = tree.begin(); it != tree.end(); ++it) {
+      if(it->first % 2 == 1) doomed.push_back(it->first);
+    }
+    for(size_t i = 0; i < doomed.size(); i++) tree.remove(doomed[i]);
+    report("scan + remove(key)", n, timer.ms());
+  }
+}
+
+// String keys: URL-like keys sharing a 40 byte prefix, and short random
+// keys that differ early, in AVLTree<string> and StringAVLTree.
+template<typename Tree>
+void benchStringTree(const string& name, const vector<string>& keys, const vector<string>& probes)
+{
+  Tree tree;
+  BenchTimer insertTimer;
+  for(size_t i = 0; i < keys.size(); i++) tree.insert(make_pair(keys[i], (int)i));
+  report(name + " insert", keys.size(), insertTimer.ms());
+  long sum = 0;
+  BenchTimer findTimer;
+  for(size_t i = 0; i < probes.size(); i++) sum += tree.find(probes[i])->second;
+  report(name + " find", probes.size(), findTimer.ms());
+  if(sum == 42) cout << "";
+}
+
+void benchStrings(size_t n)
+{
+  vector<int> ids = shuffledKeys(n, 49);
+  vector<string> urls(n), shorts(n);
+  mt19937 rng(49);
+  for(size_t i = 0; i < n; i++) {
+    char id[16];
+    snprintf(id, sizeof(id), "%08d", ids[i]);
+    urls[i] = string("https://cdn.example.com/assets/v2/images/") + id;
+    shorts[i] = string(id);
+    for(size_t j = 0; j < shorts[i].size(); j++) shorts[i][j] = (char)('a' + rng() % 26);
+  }
+  vector<string> urlProbes(urls), shortProbes(shorts);
+  shuffle(urlProbes.begin(), urlProbes.end(), rng);
+  shuffle(shortProbes.begin(), shortProbes.end(), rng);
+  cout << "string keys, n = " << n << endl;
+  benchStringTree<AVLTree<string, int> >("AVLTree, shared prefix", urls, urlProbes);
+  benchStringTree<StringAVLTree<int> >("StringAVLTree, shared prefix", urls, urlProbes);
+  benchStringTree<AVLTree<string, int> >("AVLTree, short keys", shorts, shortProbes);
+  benchStringTree<StringAVLTree<int> >("StringAVLTree, short keys", shorts, shortProbes);
+}
+
+// Large values: a 200 byte value next to every key, inline in AVLNode
+// and in the compact pool, or moved out of the pool by ColdValueSlots.
+// No hardware counters here, so the miss saving shows up as find time.
+struct BigValue
+{
+  BigValue(int v = 0) { words[0] = v; }
+  int words[50];
+};
+
+ostream& operator<<(ostream& out, const BigValue& v)
+{
+  return out << v.words[0];
+}
+
+template<typename Tree>
+void benchBigValues(const string& name, const vector<int>& keys, const vector<int>& probes)
+{
+  Tree tree;
+  BenchTimer insertTimer;
+  for(size_t i = 0; i < keys.size(); i++) tree.insert(make_pair(keys[i], BigValue(keys[i])));
+  report(name + " insert", keys.size(), insertTimer.ms());
+  long sum = 0;
+  BenchTimer findTimer;
+  for(size_t i = 0; i < probes.size(); i++) sum += tree.find(probes[i])->second.words[0];
+  report(name + " find", probes.size(), findTimer.ms());
+  if(sum == 42) cout << "";
+}
+
+void benchColdValues(size_t n)
+{
+  vector<int> keys = shuffledKeys(n, 50), probes = shuffledKeys(n, 51);
+  cout << "int -> 200 byte value, random insert/find, n = " << n << endl;
+  benchBigValues<AVLTree<int, BigValue> >("AVLTree", keys, probes);
+  benchBigValues<CompactAVLTree<int, BigValue> >("CompactAVLTree", keys, probes);
+  benchBigValues<CompactAVLTree<int, BigValue, ColdValueSlots<int, BigValue> > >("CompactAVLTree, cold values", keys, probes);
+}
+
+// Durable writes: a text log synced after every op, as the service did
+// before, against the group-committed WAL.
+void benchWal(size_t n)
+{
+  const char* path = "tree-bench.wal";
+  vector<int> keys = shuffledKeys(n, 11);
+  cout << "durable inserts, n = " << n << endl;
+
+  {
+    std::remove(path);
+    AVLTree<int, int> tree;
+    int fd = ::open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    BenchTimer timer;
+    for(size_t i = 0; i < n; i++) {
+      tree.insert(make_pair(keys[i], keys[i]));
+      string line = "insert " + to_string(keys[i]) + " " + to_string(keys[i]) + "\n";
+      if(::write(fd, line.data(), line.size()) < 0 || ::fdatasync(fd) != 0) return;
+    }
+    report("text log, fsync per op", n, timer.ms());
+    ::close(fd);
+  }
+
+  const unsigned threadCounts[] = { 1, 8, 64 };
+  for(size_t c = 0; c < sizeof(threadCounts) / sizeof(threadCounts[0]); c++) {
+    unsigned threads = threadCounts[c];
+    std::remove(path);
+    std::remove("tree-bench.wal.snapshot");
+    size_t commits;
+    BenchTimer timer;
+    {
+      DurableAVLTree<int, int> tree(path);
+      vector<thread> writers;
+      for(unsigned t = 0; t < threads; t++) {
+        writers.push_back(thread([&tree, &keys, t, threads, n]() {
+          for(size_t i = t; i < n; i += threads) tree.insert(make_pair(keys[i], keys[i]));
+        }));
+      }
+      for(size_t t = 0; t < writers.size(); t++) writers[t].join();
+      commits = tree.commits();
+    }
+    report("WAL, " + to_string(threads) + " waiting writers, " + to_string(commits) + " syncs", n, timer.ms());
+  }
+
+  std::remove(path);
+  {
+    BenchTimer timer;
+    DurableAVLTree<int, int> tree(path, false);
+    for(size_t i = 0; i < n; i++) tree.insert(make_pair(keys[i], keys[i]));
+    tree.flush();
+    report("WAL, no wait, flush at end", n, timer.ms());
+  }
+  {
+    BenchTimer timer;
+    DurableAVLTree<int, int> tree(path);
+    report("replay", n, timer.ms());
+  }
+  std::remove(path);
+  std::remove("tree-bench.wal.snapshot");
+}
+
+struct Bench
+{
+  const char* name;
+  void (*run)(size_t n);
+  size_t defaultSize;
+};
+
+Bench benches[] = {
+  { "treap", benchTreapWrites, 1000000 },
+  { "append", benchAppend, 1000000 },
+  { "compact", benchCompact, 4000000 },
+  { "parentless", benchParentless, 1000000 },
+  { "stabbing", benchStabbing, 10000000 },
+  { "rangeerase", benchRangeErase, 10000000 },
+  { "build", benchBuild, 4000000 },
+  { "pscan", benchParallelScan, 4000000 },
+  { "findmany", benchFindMany, 4000000 },
+  { "scapegoat", benchScapegoat, 1000000 },
+  { "shape", benchShape, 4000000 },
+  { "export", benchExport, 10000000 },
+  { "verify", benchVerify, 1000000 },
+  { "upsert", benchUpsert, 2000000 },
+  { "erasescan", benchEraseScan, 2000000 },
+  { "strings", benchStrings, 1000000 },
+  { "coldvalues", benchColdValues, 1000000 },
+  { "wal", benchWal, 20000 },
+};
+
+int main(int argc, char* argv[])
+{
+  // usage: tree-bench [name|all] [n]
+  const char* which = argc > 1 ? argv[1] : "all";
+  size_t n = argc > 2 ? strtoul(argv[2], NULL, 10) : 0;
+
+  bool ran = false;
+  for(size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+    if(strcmp(which, "all") == 0 || strcmp(which, benches[i].name) == 0) {
+      benches[i].run(n ? n : benches[i].defaultSize);
+      ran = true;
+    }
+  }
+  if(!ran) {
+    cout << "unknown benchmark " << which << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,75 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "avlbst.h"
+#include "tree_export.h"
+#include "test_check.h"
+using namespace std;
+
+size_t countOf(const string& text, const string& what)
+{
+  size_t count = 0;
+  for(size_t at = text.find(what); at != string::npos; at = text.find(what, at + 1)) count++;
+  return count;
+}
+
+void testSmallTree()
+{
+  AVLTree<int, string> tree;
+  tree.insert(make_pair(2, string("two")));
+  tree.insert(make_pair(1, string("a \"one\"")));
+  tree.insert(make_pair(3, string("three")));
+
+  ostringstream json;
+  exportTree(json, TreeRootAccess::root(tree), BstNodeAccess(), EXPORT_JSON);
+  check("JSON", json.str() ==
+    "{\"key\":2,\"value\":\"two\",\"left\":{\"key\":1,\"value\":\"a \\\"one\\\"\",\"left\":null,\"right\":null},"
+    "\"right\":{\"key\":3,\"value\":\"three\",\"left\":null,\"right\":null}}\n");
+
+  ostringstream dot;
+  exportTree(dot, TreeRootAccess::root(tree), BstNodeAccess(), EXPORT_DOT);
+  check("DOT", dot.str().find("n0 [label=\"2: two\"];") != string::npos &&
+               dot.str().find("n0:sw -> n1;") != string::npos && dot.str().find("n0:se -> n2;") != string::npos);
+
+  ostringstream cut;
+  exportTree(cut, TreeRootAccess::root(tree), BstNodeAccess(), EXPORT_JSON, 0);
+  check("JSON cut at depth 0", cut.str() == "{\"key\":2,\"value\":\"two\",\"truncated\":true}\n");
+
+  ostringstream empty;
+  exportTree(empty, TreeRootAccess::root(AVLTree<int, int>()), BstNodeAccess(), EXPORT_JSON);
+  check("Empty tree", empty.str() == "null\n");
+}
+
+void testLargeTrees()
+{
+  AVLTree<int, int> tree;
+  for(int i = 0; i < 100000; i++) tree.insert(make_pair(i, i));
+  ostringstream dot;
+  exportTree(dot, TreeRootAccess::root(tree), BstNodeAccess(), EXPORT_DOT);
+  check("DOT has every node and edge", countOf(dot.str(), "[label=") == 100000 && countOf(dot.str(), "->") == 99999);
+
+  ostringstream summary;
+  exportTree(summary, TreeRootAccess::root(tree), BstNodeAccess(), EXPORT_SUMMARY);
+  check("Summary", summary.str().find("nodes: 100000\nheight: 17\n") == 0 &&
+                   countOf(summary.str(), "  depth ") == 16);
+
+  // a chain of half a million right children, which no recursive printer survives
+  vector<Node<int, int>*> chain;
+  chain.push_back(new Node<int, int>(0, 0, nullptr));
+  for(int i = 1; i < 500000; i++) {
+    chain.push_back(new Node<int, int>(i, i, chain.back()));
+    chain[i - 1]->setRight(chain.back());
+  }
+  ostringstream json;
+  exportTree(json, chain[0], BstNodeAccess(), EXPORT_JSON);
+  check("Deep chain JSON", countOf(json.str(), "{") == 500000 && countOf(json.str(), "}") == 500000);
+  for(size_t i = 0; i < chain.size(); i++) delete chain[i];
+}
+
+int main()
+{
+  testSmallTree();
+  testLargeTrees();
+  return failures;
+}
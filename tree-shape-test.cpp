@@ -0,0 +1,124 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include "equal-paths.h"
+#include "tree_shape.h"
+#include "test_check.h"
+using namespace std;
+
+// Recursive reference, only used on shallow trees.
+void reference(Node* n, int depth, TreeShape& s, int& height)
+{
+  if(n == NULL) { height = 0; return; }
+  int lh, rh;
+  reference(n->left, depth + 1, s, lh);
+  reference(n->right, depth + 1, s, rh);
+  s.nodes++;
+  if(n->left == NULL && n->right == NULL) {
+    s.minLeafDepth = s.minLeafDepth < 0 ? depth : min(s.minLeafDepth, depth);
+    s.maxLeafDepth = max(s.maxLeafDepth, depth);
+  }
+  if(abs(lh - rh) > 1) s.balanced = false;
+  height = 1 + max(lh, rh);
+}
+
+bool same(const TreeShape& a, const TreeShape& b)
+{
+  return a.nodes == b.nodes && a.height == b.height && a.minLeafDepth == b.minLeafDepth &&
+         a.maxLeafDepth == b.maxLeafDepth && a.equalLeafDepths == b.equalLeafDepths &&
+         a.balanced == b.balanced && a.complete == b.complete;
+}
+
+// Random tree of n nodes, more or less bushy depending on the rng.
+Node* randomTree(int n, mt19937& rng, vector<Node*>& all)
+{
+  if(n == 0) return NULL;
+  int left = rng() % n;
+  Node* node = new Node(n);
+  all.push_back(node);
+  node->left = randomTree(left, rng, all);
+  node->right = randomTree(n - 1 - left, rng, all);
+  return node;
+}
+
+// Perfect tree with the given number of levels.
+Node* perfectTree(int levels, vector<Node*>& all)
+{
+  if(levels == 0) return NULL;
+  Node* node = new Node(levels, perfectTree(levels - 1, all), perfectTree(levels - 1, all));
+  all.push_back(node);
+  return node;
+}
+
+void freeAll(vector<Node*>& all)
+{
+  for(size_t i = 0; i < all.size(); i++) delete all[i];
+  all.clear();
+}
+
+void testAgainstReference()
+{
+  mt19937 rng(3);
+  vector<Node*> all;
+  vector<Node*> forest;
+  vector<TreeShape> expected;
+  bool sequential = true, parallel = true;
+  for(int t = 0; t < 200; t++) {
+    Node* root = (t % 5 == 0) ? perfectTree(t % 11, all) : randomTree(rng() % 300, rng, all);
+    TreeShape ref;
+    int height;
+    reference(root, 0, ref, height);
+    ref.height = height;
+    ref.equalLeafDepths = ref.minLeafDepth == ref.maxLeafDepth;
+    sequential = sequential && same(analyzeShape(root, MemberChildren()), ref);
+    parallel = parallel && same(analyzeShapeParallel(root, MemberChildren(), 4), ref);
+    forest.push_back(root);
+    expected.push_back(ref);
+  }
+  check("Matches recursive reference", sequential);
+  check("Parallel matches reference", parallel);
+
+  vector<TreeShape> shapes;
+  analyzeForest(forest, MemberChildren(), 4, shapes);
+  bool forestOk = shapes.size() == expected.size();
+  for(size_t i = 0; forestOk && i < shapes.size(); i++) forestOk = same(shapes[i], expected[i]);
+  check("Forest matches reference", forestOk);
+  freeAll(all);
+}
+
+void testDeepAndEarlyExit()
+{
+  // a million node chain, far past what the recursive version survives
+  vector<Node*> all;
+  Node* root = NULL;
+  for(int i = 0; i < 1000000; i++) {
+    root = new Node(i, NULL, root);
+    all.push_back(root);
+  }
+  TreeShape deep = analyzeShape(root, MemberChildren());
+  check("Deep chain", deep.height == 1000000 && deep.nodes == 1000000 && !deep.balanced && equalPaths(root));
+  check("Deep chain in parallel", analyzeShapeParallel(root, MemberChildren(), 4).height == 1000000);
+
+  // give the chain a second leaf right under the root
+  root->left = new Node(-1);
+  all.push_back(root->left);
+  TreeShape early = analyzeShape(root, MemberChildren(), SHAPE_STOP_UNEQUAL_LEAVES);
+  check("Early exit on unequal leaves", !early.complete && !early.equalLeafDepths && !equalPaths(root));
+  TreeShape unbalanced = analyzeShapeParallel(root, MemberChildren(), 4, SHAPE_STOP_UNBALANCED);
+  check("Early exit on imbalance", !unbalanced.complete && !unbalanced.balanced);
+  freeAll(all);
+
+  Node* perfect = perfectTree(16, all);
+  TreeShape full = analyzeShapeParallel(perfect, MemberChildren(), 4, SHAPE_STOP_UNEQUAL_LEAVES);
+  check("Perfect tree", full.complete && full.equalLeafDepths && full.balanced && full.nodes == 65535);
+  freeAll(all);
+}
+
+int main()
+{
+  testAgainstReference();
+  testDeepAndEarlyExit();
+  return failures;
+}
@@ -0,0 +1,105 @@
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+#include "tree_trace.h"
+#include "test_check.h"
+using namespace std;
+
+const char* TRACE_PATH = "tree-trace-test.trace";
+
+// Inserts, finds, a full scan, removes and a scan from a found key.
+// Returns the number of finds that hit and the steps taken.
+void recordWorkload(size_t& hits, size_t& steps)
+{
+  TracedTree<int, int> traced(TRACE_PATH);
+  hits = 0;
+  steps = 0;
+  for(int i = 0; i < 1000; i++) traced.insert(make_pair((i * 37) % 1000, i));
+  for(int i = 0; i < 1500; i += 3) {
+    if(traced.find(i) != traced.end()) hits++;
+  }
+  for(TracedTree<int, int>::iterator it = traced.begin(); it != traced.end(); ++it) steps++;
+  for(int i = 0; i < 1000; i += 2) traced.remove(i);
+  TracedTree<int, int>::iterator it = traced.find(501);
+  if(it != traced.end()) hits++;
+  for(int i = 0; i < 10 && it != traced.end(); i++, ++it) steps++;
+  traced.clear();
+  traced.insert(make_pair(7, 7));
+}
+
+void testRoundTrip()
+{
+  size_t hits, steps;
+  recordWorkload(hits, steps);
+
+  vector<TraceRecord<int, int> > records;
+  bool complete = readTrace(TRACE_PATH, records);
+  // 1000 inserts, 500 finds, begin + one run, 500 removes, find + one run,
+  // clear and an insert
+  check("Record count", complete && records.size() == 1000 + 500 + 2 + 500 + 2 + 2);
+  check("Advance runs", records[1501].op == TRACE_ADVANCE && records[1501].count == 1000 &&
+                        records[2003].op == TRACE_ADVANCE && records[2003].count == 10);
+  check("Keys kept", records[1].op == TRACE_INSERT && records[1].key == 37 && records[1].value == 1 &&
+                     records[1000].op == TRACE_FIND && records[1000].key == 0);
+
+  ifstream in(TRACE_PATH, ios::binary | ios::ate);
+  check("Compact", (size_t)in.tellg() == TRACE_HEADER_SIZE + 1000 * 9 + 500 * 5 + 1 + 5 + 500 * 5 + 5 + 5 + 1 + 9);
+
+  BinarySearchTree<int, int> bst;
+  AVLTree<int, int> avl;
+  map<int, int> ref;
+  TraceReplayStats bstStats = replayTrace(records, bst);
+  TraceReplayStats avlStats = replayTrace(records, avl);
+  TraceReplayStats mapStats = replayTrace(records, ref);
+  check("Replays agree", bstStats.findHits == hits && avlStats.findHits == hits && mapStats.findHits == hits &&
+                         bstStats.steps == steps && avlStats.steps == steps && mapStats.steps == steps);
+  check("Final state", avl.begin()->first == 7 && ref.size() == 1 && bst.begin()->second == 7);
+  check("Latencies", avlStats.records == records.size() && avlStats.perOp[TRACE_INSERT].count == 1001 &&
+                     avlStats.all.p50 <= avlStats.all.p99 && avlStats.all.p99 <= avlStats.all.max);
+}
+
+void testTypeCheck()
+{
+  {
+    TraceWriter<string, int> writer(TRACE_PATH);
+    writer.insert("a", 1);
+  }
+  vector<TraceRecord<int, int> > records;
+  bool threw = false;
+  try {
+    readTrace(TRACE_PATH, records);
+  }
+  catch(std::runtime_error&) {
+    threw = true;
+  }
+  vector<TraceRecord<string, int> > strings;
+  readTrace(TRACE_PATH, strings);
+  check("Type check", threw && strings.size() == 1 && strings[0].key == "a");
+}
+
+void testTornTail()
+{
+  {
+    TraceWriter<int, int> writer(TRACE_PATH);
+    for(int i = 0; i < 10; i++) writer.insert(i, i);
+  }
+  {
+    ofstream out(TRACE_PATH, ios::binary | ios::app);
+    out.write("\x01\x05", 2); // an insert cut off mid key
+  }
+  vector<TraceRecord<int, int> > records;
+  bool complete = readTrace(TRACE_PATH, records);
+  check("Torn tail", !complete && records.size() == 10);
+}
+
+int main()
+{
+  testRoundTrip();
+  testTypeCheck();
+  testTornTail();
+  std::remove(TRACE_PATH);
+  return failures;
+}
@@ -0,0 +1,650 @@
+#ifndef TREE_EXPORT_H
+#define TREE_EXPORT_H
+
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <random>
+#include <type_traits>
+#include "tree_shape.h"
+
+enum ExportFormat
+{
+    EXPORT_DOT,     // Graphviz
+    EXPORT_JSON,    // nested {"key", "value", "left", "right"} objects
+    EXPORT_SUMMARY  // statistics, depth histogram, top levels and a sample
+};
+
+/**
+* Node accessors for the exporter: children plus the key, and the value
+* when HAS_VALUE is set. BstNodeAccess reads BinarySearchTree nodes;
+* MemberKeyAccess reads structs with left/right/key members.
+*/
+struct BstNodeAccess : public GetterChildren
+{
+    static const bool HAS_VALUE = true;
+    template<class NodePtr>
+    auto key(NodePtr node) const -> decltype(node->getKey()) { return node->getKey(); }
+    template<class NodePtr>
+    auto value(NodePtr node) const -> decltype(node->getValue()) { return node->getValue(); }
+};
+
+struct MemberKeyAccess : public MemberChildren
+{
+    static const bool HAS_VALUE = false;
+    template<class NodePtr>
+    auto key(NodePtr node) const -> decltype(node->key) { return node->key; }
+    template<class NodePtr>
+    int value(NodePtr) const { return 0; }
+};
+
+/**
+* Reaches the root of a BinarySearchTree (or a tree derived from it) so it
+* can be passed to exportTree; bst.h only declares it a friend.
+*/
+struct TreeRootAccess
+{
+    template<class Tree>
+    static auto root(const Tree& tree) -> decltype(tree.root_) { return tree.root_; }
+};
+
+/**
+* Streams a tree to an ostream as DOT, JSON or a summary. Every format
+* walks the tree iteratively with a stack of one root-to-node path, so
+* memory is O(depth) (plus the sample and outline for summaries) however
+* big the tree is. Output is assembled in a buffer and handed to the
+* stream in bufferSize chunks rather than a line at a time.
+*
+* maxDepth >= 0 cuts the DOT and JSON output below that depth (the root
+* is depth 0); a cut subtree shows up as a "..." node or "truncated".
+*/
+template <class NodePtr, class Access>
+class TreeExporter
+{
+public:
+    TreeExporter(std::ostream& out, const Access& access, size_t bufferSize = 1 << 16);
+    ~TreeExporter(); // flushes
+
+    void write(NodePtr root, ExportFormat format, int maxDepth = -1);
+    void writeDot(NodePtr root, int maxDepth = -1);
+    void writeJson(NodePtr root, int maxDepth = -1);
+    // Shape statistics, node and leaf counts per depth, the first
+    // outlineDepth levels as an indented outline, and samples nodes picked
+    // uniformly at random (reservoir sampling) with their depths.
+    void writeSummary(NodePtr root, size_t samples = 16, int outlineDepth = 4);
+    void flush();
+
+protected:
+    struct Frame
+    {
+        Frame(NodePtr node_, size_t id_, int depth_) : node(node_), id(id_), depth(depth_), state(0) {}
+        NodePtr node;
+        size_t id;
+        int depth;
+        int state; // JSON only: 0 opening, 1 right child next, 2 closing
+    };
+
+    enum LabelStyle { LABEL_DOT, LABEL_JSON, LABEL_TEXT };
+
+    // Add helper functions here
+    void put(const char* text);
+    void put(const std::string& text);
+    void putNumber(size_t number);
+    template<class T>
+    void putText(const T& item); // as operator<< would write it
+    template<class T>
+    void putText(const T& item, std::true_type);  // integers, formatted by hand
+    template<class T>
+    void putText(const T& item, std::false_type); // anything else, through scratch_
+    template<class T>
+    void putEscaped(const T& item, bool json);    // putText with quotes and control characters escaped
+    template<class T>
+    void putQuoted(const T& item, bool json);     // putEscaped in double quotes
+    template<class T>
+    void putJsonValue(const T& item);
+    template<class T>
+    void putJsonValue(const T& item, std::integral_constant<int, 0>); // number
+    template<class T>
+    void putJsonValue(const T& item, std::integral_constant<int, 1>); // bool
+    template<class T>
+    void putJsonValue(const T& item, std::integral_constant<int, 2>); // anything else
+    void putLabel(NodePtr node, LabelStyle style);
+    void putLabel(NodePtr node, LabelStyle style, std::true_type);
+    void putLabel(NodePtr node, LabelStyle style, std::false_type);
+    void maybeFlush();
+
+protected:
+    std::ostream& out_;
+    Access access_;
+    size_t bufferSize_;
+    std::string buffer_;
+    std::ostringstream scratch_; // reused to format keys and values
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the TreeExporter class.
+  -------------------------------------------------
+*/
+
+template<class NodePtr, class Access>
+TreeExporter<NodePtr, Access>::TreeExporter(std::ostream& out, const Access& access, size_t bufferSize) :
+    out_(out), access_(access), bufferSize_(bufferSize)
+{
+    buffer_.reserve(bufferSize + 256);
+}
+
+template<class NodePtr, class Access>
+TreeExporter<NodePtr, Access>::~TreeExporter()
+{
+    flush();
+}
+
+template<class NodePtr, class Access>
+void TreeExporter<NodePtr, Access>::write(NodePtr root, ExportFormat format, int maxDepth)
+{
+    if(format == EXPORT_DOT)
+    {
+        writeDot(root, maxDepth);
+    }
+    else if(format == EXPORT_JSON)
+    {
+        writeJson(root, maxDepth);
+    }
+    else
+    {
+        writeSummary(root);
+    }
+}
+
+/**
+* Nodes are written in pre-order and numbered as their parent finds them.
+* Edges leave from the south-west port for a left child and the
+* south-east port for a right one, so a lone child still shows its side.
+*/
+template<class NodePtr, class Access>
+void TreeExporter<NodePtr, Access>::writeDot(NodePtr root, int maxDepth)
+{
+    put("digraph tree {\n  node [shape=box];\n");
+    std::vector<Frame> stack;
+    if(root != nullptr)
+    {
+        stack.push_back(Frame(root, 0, 0));
+    }
+    size_t nextId = 1;
+    while(!stack.empty())
+    {
+        Frame frame = stack.back();
+        stack.pop_back();
+
+        put("  n");
+        putNumber(frame.id);
+        put(" [label=");
+        putLabel(frame.node, LABEL_DOT);
+        put("];\n");
+
+        NodePtr children[2] = { access_.left(frame.node), access_.right(frame.node) };
+        const char* ports[2] = { ":sw -> n", ":se -> n" };
+        bool cut = maxDepth >= 0 && frame.depth >= maxDepth;
+        for(int side = 0; side < 2; side++)
+        {
+            if(children[side] == nullptr)
+            {
+                continue;
+            }
+            size_t id = nextId++;
+            put("  n");
+            putNumber(frame.id);
+            put(ports[side]);
+            putNumber(id);
+            put(";\n");
+            if(cut)
+            {
+                put("  n");
+                putNumber(id);
+                put(" [label=\"...\", shape=plaintext];\n");
+            }
+        }
+        if(!cut)
+        {
+            // left on top, so it is written next
+            if(children[1] != nullptr)
+            {
+                stack.push_back(Frame(children[1], nextId - 1, frame.depth + 1));
+            }
+            if(children[0] != nullptr)
+            {
+                stack.push_back(Frame(children[0], nextId - (children[1] != nullptr ? 2 : 1), frame.depth + 1));
+            }
+        }
+        maybeFlush();
+    }
+    put("}\n");
+    flush();
+}
+
+template<class NodePtr, class Access>
+void TreeExporter<NodePtr, Access>::writeJson(NodePtr root, int maxDepth)
+{
+    if(root == nullptr)
+    {
+        put("null\n");
+        flush();
+        return;
+    }
+
+    std::vector<Frame> stack;
+    stack.push_back(Frame(root, 0, 0));
+    while(!stack.empty())
+    {
+        Frame& frame = stack.back();
+        NodePtr node = frame.node;
+        int depth = frame.depth;
+        if(frame.state == 0)
+        {
+            put("{");
+            putLabel(node, LABEL_JSON);
+            if(maxDepth >= 0 && depth >= maxDepth &&
+               (access_.left(node) != nullptr || access_.right(node) != nullptr))
+            {
+                put(",\"truncated\":true}");
+                stack.pop_back();
+                continue;
+            }
+            frame.state = 1;
+            put(",\"left\":");
+            NodePtr left = access_.left(node);
+            if(left == nullptr)
+            {
+                put("null");
+            }
+            else
+            {
+                stack.push_back(Frame(left, 0, depth + 1));
+            }
+        }
+        else if(frame.state == 1)
+        {
+            frame.state = 2;
+            put(",\"right\":");
+            NodePtr right = access_.right(node);
+            if(right == nullptr)
+            {
+                put("null");
+            }
+            else
+            {
+                stack.push_back(Frame(right, 0, depth + 1));
+            }
+        }
+        else
+        {
+            put("}");
+            stack.pop_back();
+        }
+        maybeFlush();
+    }
+    put("\n");
+    flush();
+}
+
+/**
+* One pre-order walk collects the per-depth counts, the outline and the
+* sample; the text is written once the walk is done.
+*/
+template<class NodePtr, class Access>
+void TreeExporter<NodePtr, Access>::writeSummary(NodePtr root, size_t samples, int outlineDepth)
+{
+    std::vector<size_t> nodesAt;
+    std::vector<size_t> leavesAt;
+    std::string outline;
+    std::vector<std::pair<std::string, int> > sample;
+    std::mt19937_64 rng(0x5eed);
+    size_t seen = 0;
+
+    // the outline and sample are formatted through the main buffer
+    std::string saved;
+    saved.swap(buffer_);
+
+    std::vector<Frame> stack;
+    if(root != nullptr)
+    {
+        stack.push_back(Frame(root, 0, 0));
+    }
+    while(!stack.empty())
+    {
+        Frame frame = stack.back();
+        stack.pop_back();
+        NodePtr left = access_.left(frame.node);
+        NodePtr right = access_.right(frame.node);
+        size_t depth = static_cast<size_t>(frame.depth);
+        if(nodesAt.size() <= depth)
+        {
+            nodesAt.resize(depth + 1, 0);
+            leavesAt.resize(depth + 1, 0);
+        }
+        nodesAt[depth]++;
+        if(left == nullptr && right == nullptr)
+        {
+            leavesAt[depth]++;
+        }
+
+        if(frame.depth < outlineDepth)
+        {
+            buffer_.assign(2 * depth + 2, ' ');
+            putLabel(frame.node, LABEL_TEXT);
+            outline += buffer_;
+            outline += '\n';
+        }
+
+        seen++;
+        size_t slot = (sample.size() < samples) ? sample.size() : static_cast<size_t>(rng() % seen);
+        if(slot < samples)
+        {
+            buffer_.clear();
+            putLabel(frame.node, LABEL_TEXT);
+            if(slot == sample.size())
+            {
+                sample.push_back(std::make_pair(buffer_, frame.depth));
+            }
+            else
+            {
+                sample[slot] = std::make_pair(buffer_, frame.depth);
+            }
+        }
+
+        if(right != nullptr)
+        {
+            stack.push_back(Frame(right, 0, frame.depth + 1));
+        }
+        if(left != nullptr)
+        {
+            stack.push_back(Frame(left, 0, frame.depth + 1));
+        }
+    }
+    buffer_.swap(saved);
+
+    put("nodes: ");
+    putNumber(seen);
+    put("\nheight: ");
+    putNumber(nodesAt.size());
+    int minLeaf = -1;
+    int maxLeaf = -1;
+    for(size_t d = 0; d < leavesAt.size(); d++)
+    {
+        if(leavesAt[d] > 0)
+        {
+            minLeaf = (minLeaf < 0) ? static_cast<int>(d) : minLeaf;
+            maxLeaf = static_cast<int>(d);
+        }
+    }
+    put("\nleaf depths: ");
+    putText(minLeaf);
+    put(" - ");
+    putText(maxLeaf);
+    put("\n\ndepth  nodes  leaves\n");
+    for(size_t d = 0; d < nodesAt.size(); d++)
+    {
+        putNumber(d);
+        put("  ");
+        putNumber(nodesAt[d]);
+        put("  ");
+        putNumber(leavesAt[d]);
+        put("\n");
+        maybeFlush();
+    }
+    put("\ntop ");
+    putText(outlineDepth);
+    put(" levels:\n");
+    put(outline);
+    put("\nsample:\n");
+    for(size_t i = 0; i < sample.size(); i++)
+    {
+        put("  depth ");
+        putText(sample[i].second);
+        put("  ");
+        put(sample[i].first);
+        put("\n");
+    }
+    flush();
+}
+
+template<class NodePtr, class Access>
+void TreeExporter<NodePtr, Access>::flush()
+{
+    if(!buffer_.empty())
+    {
+        out_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        buffer_.clear();
+    }
+    out_.flush();
+}
+
+template<class NodePtr, class Access>
+void TreeExporter<NodePtr, Access>::put(const char* text)
+{
+    buffer_ += text;
+}
+
+template<class NodePtr, class Access>
+void TreeExporter<NodePtr, Access>::put(const std::string& text)
+{
+    buffer_ += text;
+}
+
+/**
+* Node ids and counts are the bulk of a large export, so they skip the
+* stream machinery.
+*/
+template<class NodePtr, class Access>
+void TreeExporter<NodePtr, Access>::putNumber(size_t number)
+{
+    char digits[24];
+    int length = 0;
+    do
+    {
+        digits[length++] = static_cast<char>('0' + number % 10);
+        number /= 10;
+    } while(number != 0);
+    while(length > 0)
+    {
+        buffer_ += digits[--length];
+    }
+}
+
+template<class NodePtr, class Access>
+template<class T>
+void TreeExporter<NodePtr, Access>::putText(const T& item)
+{
+    // bool and the char types stream as text, so they take the slow path
+    putText(item, std::integral_constant<bool, std::is_integral<T>::value && (sizeof(T) > 1)>());
+}
+
+template<class NodePtr, class Access>
+template<class T>
+void TreeExporter<NodePtr, Access>::putText(const T& item, std::true_type)
+{
+    if(item < 0)
+    {
+        buffer_ += '-';
+        putNumber(static_cast<size_t>(-static_cast<long long>(item)));
+    }
+    else
+    {
+        putNumber(static_cast<size_t>(item));
+    }
+}
+
+template<class NodePtr, class Access>
+template<class T>
+void TreeExporter<NodePtr, Access>::putText(const T& item, std::false_type)
+{
+    scratch_.str(std::string());
+    scratch_ << item;
+    buffer_ += scratch_.str();
+}
+
+template<class NodePtr, class Access>
+template<class T>
+void TreeExporter<NodePtr, Access>::putEscaped(const T& item, bool json)
+{
+    if(std::is_arithmetic<T>::value && sizeof(T) > 1)
+    {
+        putText(item); // nothing to escape
+        return;
+    }
+    scratch_.str(std::string());
+    scratch_ << item;
+    const std::string text = scratch_.str();
+    for(size_t i = 0; i < text.size(); i++)
+    {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if(c == '"' || c == '\\')
+        {
+            buffer_ += '\\';
+            buffer_ += static_cast<char>(c);
+        }
+        else if(c == '\n')
+        {
+            buffer_ += "\\n";
+        }
+        else if(c < 0x20)
+        {
+            const char* hex = "0123456789abcdef";
+            buffer_ += json ? "\\u00" : "\\x";
+            buffer_ += hex[c >> 4];
+            buffer_ += hex[c & 15];
+        }
+        else
+        {
+            buffer_ += static_cast<char>(c);
+        }
+    }
+}
+
+template<class NodePtr, class Access>
+template<class T>
+void TreeExporter<NodePtr, Access>::putQuoted(const T& item, bool json)
+{
+    buffer_ += '"';
+    putEscaped(item, json);
+    buffer_ += '"';
+}
+
+// Numbers go in bare, anything else (chars included) as a string.
+template<class NodePtr, class Access>
+template<class T>
+void TreeExporter<NodePtr, Access>::putJsonValue(const T& item)
+{
+    typedef typename std::decay<T>::type Plain;
+    static const int kind = std::is_same<Plain, bool>::value ? 1 :
+        (std::is_arithmetic<Plain>::value && !std::is_same<Plain, char>::value) ? 0 : 2;
+    putJsonValue(item, std::integral_constant<int, kind>());
+}
+
+template<class NodePtr, class Access>
+template<class T>
+void TreeExporter<NodePtr, Access>::putJsonValue(const T& item, std::integral_constant<int, 0>)
+{
+    putText(item);
+}
+
+template<class NodePtr, class Access>
+template<class T>
+void TreeExporter<NodePtr, Access>::putJsonValue(const T& item, std::integral_constant<int, 1>)
+{
+    put(item ? "true" : "false");
+}
+
+template<class NodePtr, class Access>
+template<class T>
+void TreeExporter<NodePtr, Access>::putJsonValue(const T& item, std::integral_constant<int, 2>)
+{
+    putQuoted(item, true);
+}
+
+/**
+* DOT: "key: value" as one quoted label. JSON: the "key" and "value"
+* members. Text: key: value as is.
+*/
+template<class NodePtr, class Access>
+void TreeExporter<NodePtr, Access>::putLabel(NodePtr node, LabelStyle style)
+{
+    putLabel(node, style, std::integral_constant<bool, Access::HAS_VALUE>());
+}
+
+template<class NodePtr, class Access>
+void TreeExporter<NodePtr, Access>::putLabel(NodePtr node, LabelStyle style, std::true_type)
+{
+    if(style == LABEL_JSON)
+    {
+        put("\"key\":");
+        putJsonValue(access_.key(node));
+        put(",\"value\":");
+        putJsonValue(access_.value(node));
+        return;
+    }
+    if(style == LABEL_DOT)
+    {
+        buffer_ += '"';
+        putEscaped(access_.key(node), false);
+        put(": ");
+        putEscaped(access_.value(node), false);
+        buffer_ += '"';
+    }
+    else
+    {
+        putText(access_.key(node));
+        put(": ");
+        putText(access_.value(node));
+    }
+}
+
+template<class NodePtr, class Access>
+void TreeExporter<NodePtr, Access>::putLabel(NodePtr node, LabelStyle style, std::false_type)
+{
+    if(style == LABEL_JSON)
+    {
+        put("\"key\":");
+        putJsonValue(access_.key(node));
+    }
+    else if(style == LABEL_DOT)
+    {
+        putQuoted(access_.key(node), false);
+    }
+    else
+    {
+        putText(access_.key(node));
+    }
+}
+
+template<class NodePtr, class Access>
+void TreeExporter<NodePtr, Access>::maybeFlush()
+{
+    if(buffer_.size() >= bufferSize_)
+    {
+        out_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        buffer_.clear();
+    }
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the TreeExporter class.
+  -----------------------------------------------
+*/
+
+/**
+* Writes the tree at root in the given format.
+*/
+template<class NodePtr, class Access>
+void exportTree(std::ostream& out, NodePtr root, const Access& access, ExportFormat format, int maxDepth = -1)
+{
+    TreeExporter<NodePtr, Access> exporter(out, access);
+    exporter.write(root, format, maxDepth);
+}
+
+#endif
@@ -0,0 +1,460 @@
+#ifndef TREE_SHAPE_H
+#define TREE_SHAPE_H
+
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+/**
+* Shape statistics of a binary tree, all gathered by one walk.
+*/
+struct TreeShape
+{
+    TreeShape() :
+        nodes(0), height(0), minLeafDepth(-1), maxLeafDepth(-1),
+        equalLeafDepths(true), balanced(true), complete(true)
+    {}
+
+    size_t nodes;
+    int height;           // in nodes, 0 for an empty tree
+    int minLeafDepth;     // in edges from the root, -1 for an empty tree
+    int maxLeafDepth;
+    bool equalLeafDepths; // every leaf is at the same depth
+    bool balanced;        // child heights differ by at most 1 at every node
+    bool complete;        // false if the walk stopped early, see ShapeStop
+};
+
+/**
+* Lets a walk stop at the first node that decides one answer. The result
+* then has complete == false and only that answer (false) is meaningful.
+*/
+enum ShapeStop
+{
+    SHAPE_STOP_NEVER,
+    SHAPE_STOP_UNEQUAL_LEAVES,
+    SHAPE_STOP_UNBALANCED
+};
+
+/**
+* Child accessors, so one walk serves several node types: MemberChildren
+* for plain structs with left/right members, GetterChildren for nodes
+* with getLeft()/getRight().
+*/
+struct MemberChildren
+{
+    template<class NodePtr>
+    NodePtr left(NodePtr node) const { return node->left; }
+    template<class NodePtr>
+    NodePtr right(NodePtr node) const { return node->right; }
+};
+
+struct GetterChildren
+{
+    template<class NodePtr>
+    NodePtr left(NodePtr node) const { return node->getLeft(); }
+    template<class NodePtr>
+    NodePtr right(NodePtr node) const { return node->getRight(); }
+};
+
+/**
+* The walks behind analyzeShape and friends. Nodes are visited in post
+* order with an explicit stack, so a tree of any depth costs O(height)
+* heap memory and no call stack.
+*/
+template <class NodePtr, class Children>
+class TreeShapeWalker
+{
+public:
+    // Runs of this many nodes between checks of the shared cancel flag.
+    static const size_t CANCEL_CHECK_INTERVAL = 1024;
+
+    TreeShapeWalker(const Children& children, ShapeStop stop);
+
+    TreeShape analyze(NodePtr root);
+    TreeShape analyzeParallel(NodePtr root, unsigned threads);
+    void analyzeForest(const std::vector<NodePtr>& roots, unsigned threads, std::vector<TreeShape>& out);
+
+protected:
+    // The children seen so far of a node whose walk is in progress.
+    struct Parts
+    {
+        Parts() : leftHeight(0), rightHeight(0), anyChild(false) {}
+        void add(const TreeShape& child, bool isLeft);
+        TreeShape finish() const; // the node itself, once its children are in
+
+        TreeShape children;
+        int leftHeight;
+        int rightHeight;
+        bool anyChild;
+    };
+
+    struct Frame
+    {
+        explicit Frame(NodePtr node_) : node(node_), state(0) {}
+        NodePtr node;
+        int state; // 0 left not yet visited, 1 right not yet visited, 2 done
+        Parts parts;
+    };
+
+    // The top of a tree split up for analyzeParallel.
+    struct TopEntry
+    {
+        TopEntry(NodePtr node_, int depth_) : node(node_), depth(depth_), left(-1), right(-1), expanded(false) {}
+        NodePtr node;
+        int depth;
+        long left;  // indexes of the children's entries, -1 if none
+        long right;
+        bool expanded;
+        TreeShape shape;
+    };
+
+    // Add helper functions here
+    TreeShape walk(NodePtr root, int depth, std::atomic<int>& firstLeaf);
+    bool failed(const TreeShape& shape, int depth, std::atomic<int>& firstLeaf);
+    TreeShape stopped() const;
+
+protected:
+    Children children_;
+    ShapeStop stop_;
+    std::atomic<bool> cancel_; // set by the first walk that fails, the rest then give up
+};
+
+/*
+  ----------------------------------------------------
+  Begin implementations for the TreeShapeWalker class.
+  ----------------------------------------------------
+*/
+
+template<class NodePtr, class Children>
+const size_t TreeShapeWalker<NodePtr, Children>::CANCEL_CHECK_INTERVAL;
+
+template<class NodePtr, class Children>
+void TreeShapeWalker<NodePtr, Children>::Parts::add(const TreeShape& child, bool isLeft)
+{
+    if(!anyChild)
+    {
+        children = child;
+        children.minLeafDepth = child.minLeafDepth + 1;
+        children.maxLeafDepth = child.maxLeafDepth + 1;
+        anyChild = true;
+    }
+    else
+    {
+        children.nodes += child.nodes;
+        children.minLeafDepth = std::min(children.minLeafDepth, child.minLeafDepth + 1);
+        children.maxLeafDepth = std::max(children.maxLeafDepth, child.maxLeafDepth + 1);
+        children.balanced = children.balanced && child.balanced;
+    }
+    if(isLeft)
+    {
+        leftHeight = child.height;
+    }
+    else
+    {
+        rightHeight = child.height;
+    }
+}
+
+template<class NodePtr, class Children>
+TreeShape TreeShapeWalker<NodePtr, Children>::Parts::finish() const
+{
+    TreeShape shape;
+    shape.nodes = 1;
+    shape.height = 1;
+    shape.minLeafDepth = 0;
+    shape.maxLeafDepth = 0;
+    if(anyChild)
+    {
+        shape = children;
+        shape.nodes++;
+        shape.height = 1 + std::max(leftHeight, rightHeight);
+        shape.balanced = children.balanced && std::abs(leftHeight - rightHeight) <= 1;
+    }
+    shape.equalLeafDepths = shape.minLeafDepth == shape.maxLeafDepth;
+    return shape;
+}
+
+template<class NodePtr, class Children>
+TreeShapeWalker<NodePtr, Children>::TreeShapeWalker(const Children& children, ShapeStop stop) :
+    children_(children), stop_(stop), cancel_(false)
+{
+
+}
+
+template<class NodePtr, class Children>
+TreeShape TreeShapeWalker<NodePtr, Children>::analyze(NodePtr root)
+{
+    std::atomic<int> firstLeaf(-1);
+    return walk(root, 0, firstLeaf);
+}
+
+/**
+* Expands the top of the tree breadth first until there are a few
+* subtrees per thread, walks those subtrees on the threads, then folds
+* the top back together from the bottom. Every leaf depth is checked
+* against one shared first leaf depth, so an uneven tree is caught by
+* whichever thread meets the evidence first.
+*/
+template<class NodePtr, class Children>
+TreeShape TreeShapeWalker<NodePtr, Children>::analyzeParallel(NodePtr root, unsigned threads)
+{
+    if(threads <= 1 || root == nullptr)
+    {
+        return analyze(root);
+    }
+
+    std::vector<TopEntry> top;
+    top.push_back(TopEntry(root, 0));
+    size_t wanted = static_cast<size_t>(threads) * 8;
+    size_t expanded = 0;
+    for(size_t i = 0; i < top.size() && top.size() - expanded < wanted; i++)
+    {
+        NodePtr left = children_.left(top[i].node);
+        NodePtr right = children_.right(top[i].node);
+        top[i].expanded = true;
+        expanded++;
+        if(left != nullptr)
+        {
+            top[i].left = static_cast<long>(top.size());
+            top.push_back(TopEntry(left, top[i].depth + 1));
+        }
+        if(right != nullptr)
+        {
+            top[i].right = static_cast<long>(top.size());
+            top.push_back(TopEntry(right, top[i].depth + 1));
+        }
+    }
+
+    std::vector<size_t> frontier;
+    for(size_t i = 0; i < top.size(); i++)
+    {
+        if(!top[i].expanded)
+        {
+            frontier.push_back(i);
+        }
+    }
+
+    std::atomic<int> firstLeaf(-1);
+    std::atomic<size_t> next(0);
+    auto work = [this, &top, &frontier, &firstLeaf, &next]()
+    {
+        size_t i;
+        while((i = next.fetch_add(1)) < frontier.size() && !cancel_.load())
+        {
+            TopEntry& entry = top[frontier[i]];
+            entry.shape = walk(entry.node, entry.depth, firstLeaf);
+        }
+    };
+    std::vector<std::thread> workers;
+    for(unsigned t = 1; t < threads && t < frontier.size(); t++)
+    {
+        workers.push_back(std::thread(work));
+    }
+    work();
+    for(size_t t = 0; t < workers.size(); t++)
+    {
+        workers[t].join();
+    }
+
+    for(size_t i = top.size(); i-- > 0; )
+    {
+        if(cancel_.load())
+        {
+            return stopped();
+        }
+        if(!top[i].expanded)
+        {
+            continue;
+        }
+        Parts parts;
+        if(top[i].left >= 0)
+        {
+            parts.add(top[top[i].left].shape, true);
+        }
+        if(top[i].right >= 0)
+        {
+            parts.add(top[top[i].right].shape, false);
+        }
+        top[i].shape = parts.finish();
+        if(failed(top[i].shape, top[i].depth, firstLeaf))
+        {
+            return stopped();
+        }
+    }
+    return top[0].shape;
+}
+
+/**
+* Hands whole trees to the threads; each tree is walked on its own, and
+* a stop in one tree does not affect the others.
+*/
+template<class NodePtr, class Children>
+void TreeShapeWalker<NodePtr, Children>::analyzeForest(const std::vector<NodePtr>& roots, unsigned threads,
+    std::vector<TreeShape>& out)
+{
+    out.assign(roots.size(), TreeShape());
+    std::atomic<size_t> next(0);
+    auto work = [this, &roots, &out, &next]()
+    {
+        TreeShapeWalker<NodePtr, Children> walker(children_, stop_);
+        size_t i;
+        while((i = next.fetch_add(1)) < roots.size())
+        {
+            walker.cancel_.store(false);
+            out[i] = walker.analyze(roots[i]);
+        }
+    };
+    std::vector<std::thread> workers;
+    for(unsigned t = 1; t < threads && t < roots.size(); t++)
+    {
+        workers.push_back(std::thread(work));
+    }
+    work();
+    for(size_t t = 0; t < workers.size(); t++)
+    {
+        workers[t].join();
+    }
+}
+
+/**
+* Post order walk of the subtree at root, which sits depth edges below
+* the real root. A node is folded into its parent's Parts as soon as both
+* its children are done, so the stack only ever holds one root-to-node
+* path.
+*/
+template<class NodePtr, class Children>
+TreeShape TreeShapeWalker<NodePtr, Children>::walk(NodePtr root, int depth, std::atomic<int>& firstLeaf)
+{
+    if(root == nullptr)
+    {
+        return TreeShape();
+    }
+
+    std::vector<Frame> stack;
+    stack.push_back(Frame(root));
+    size_t steps = 0;
+    while(true)
+    {
+        if(++steps % CANCEL_CHECK_INTERVAL == 0 && cancel_.load(std::memory_order_relaxed))
+        {
+            return stopped();
+        }
+
+        Frame& frame = stack.back();
+        if(frame.state == 0)
+        {
+            frame.state = 1;
+            NodePtr left = children_.left(frame.node);
+            if(left != nullptr)
+            {
+                stack.push_back(Frame(left));
+            }
+            continue;
+        }
+        if(frame.state == 1)
+        {
+            frame.state = 2;
+            NodePtr right = children_.right(frame.node);
+            if(right != nullptr)
+            {
+                stack.push_back(Frame(right));
+            }
+            continue;
+        }
+
+        TreeShape shape = frame.parts.finish();
+        if(failed(shape, depth + static_cast<int>(stack.size()) - 1, firstLeaf))
+        {
+            return stopped();
+        }
+        NodePtr node = frame.node;
+        stack.pop_back();
+        if(stack.empty())
+        {
+            return shape;
+        }
+        stack.back().parts.add(shape, children_.left(stack.back().node) == node);
+    }
+}
+
+/**
+* Checks a finished subtree against the stop condition. Leaves are also
+* compared with the first leaf depth seen anywhere in the walk.
+*/
+template<class NodePtr, class Children>
+bool TreeShapeWalker<NodePtr, Children>::failed(const TreeShape& shape, int depth, std::atomic<int>& firstLeaf)
+{
+    bool fail = false;
+    if(stop_ == SHAPE_STOP_UNEQUAL_LEAVES)
+    {
+        fail = !shape.equalLeafDepths;
+        if(!fail && shape.nodes == 1)
+        {
+            int expected = -1;
+            fail = !firstLeaf.compare_exchange_strong(expected, depth) && expected != depth;
+        }
+    }
+    else if(stop_ == SHAPE_STOP_UNBALANCED)
+    {
+        fail = !shape.balanced;
+    }
+    if(fail)
+    {
+        cancel_.store(true);
+    }
+    return fail;
+}
+
+template<class NodePtr, class Children>
+TreeShape TreeShapeWalker<NodePtr, Children>::stopped() const
+{
+    TreeShape shape;
+    shape.complete = false;
+    shape.equalLeafDepths = stop_ != SHAPE_STOP_UNEQUAL_LEAVES;
+    shape.balanced = stop_ != SHAPE_STOP_UNBALANCED;
+    return shape;
+}
+
+/*
+  --------------------------------------------------
+  End implementations for the TreeShapeWalker class.
+  --------------------------------------------------
+*/
+
+/**
+* Shape of the tree at root, walked on the calling thread.
+*/
+template<class NodePtr, class Children>
+TreeShape analyzeShape(NodePtr root, const Children& children, ShapeStop stop = SHAPE_STOP_NEVER)
+{
+    TreeShapeWalker<NodePtr, Children> walker(children, stop);
+    return walker.analyze(root);
+}
+
+/**
+* Same result as analyzeShape, with the subtrees below the top few levels
+* walked on up to threads threads.
+*/
+template<class NodePtr, class Children>
+TreeShape analyzeShapeParallel(NodePtr root, const Children& children, unsigned threads,
+    ShapeStop stop = SHAPE_STOP_NEVER)
+{
+    TreeShapeWalker<NodePtr, Children> walker(children, stop);
+    return walker.analyzeParallel(root, threads);
+}
+
+/**
+* out[i] = analyzeShape(roots[i]), with the trees spread over up to
+* threads threads.
+*/
+template<class NodePtr, class Children>
+void analyzeForest(const std::vector<NodePtr>& roots, const Children& children, unsigned threads,
+    std::vector<TreeShape>& out, ShapeStop stop = SHAPE_STOP_NEVER)
+{
+    TreeShapeWalker<NodePtr, Children> walker(children, stop);
+    walker.analyzeForest(roots, threads, out);
+}
+
+#endif
@@ -0,0 +1,621 @@
+#ifndef TREE_TRACE_H
+#define TREE_TRACE_H
+
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <chrono>
+#include "bst.h"
+#include "avlbst.h"
+#include "wal_codec.h"
+
+/**
+* The calls a trace records. A run of iterator increments is stored as
+* one TRACE_ADVANCE record with a step count.
+*/
+enum TraceOp
+{
+    TRACE_INSERT = 1,  // key, value
+    TRACE_REMOVE,      // key
+    TRACE_FIND,        // key, moves the cursor to the result
+    TRACE_BEGIN,       // moves the cursor to begin()
+    TRACE_ADVANCE,     // u32 count, steps the cursor forward
+    TRACE_CLEAR,
+    TRACE_OP_END
+};
+
+/**
+* Identifies a key or value type in the trace header, so the replay tool
+* can refuse a trace written with types it was not built for. 0 means
+* unknown; such traces can still be read back by code that names the
+* types itself.
+*/
+template <typename T>
+struct TraceTypeCode { static const uint8_t CODE = 0; };
+template <> struct TraceTypeCode<int> { static const uint8_t CODE = 1; };
+template <> struct TraceTypeCode<long> { static const uint8_t CODE = 2; };
+template <> struct TraceTypeCode<long long> { static const uint8_t CODE = 2; };
+template <> struct TraceTypeCode<unsigned> { static const uint8_t CODE = 3; };
+template <> struct TraceTypeCode<unsigned long> { static const uint8_t CODE = 4; };
+template <> struct TraceTypeCode<unsigned long long> { static const uint8_t CODE = 4; };
+template <> struct TraceTypeCode<double> { static const uint8_t CODE = 5; };
+template <> struct TraceTypeCode<std::string> { static const uint8_t CODE = 6; };
+
+// "BSTTRACE", u32 version, u8 key code, u8 value code
+static const char TRACE_MAGIC[8] = { 'B', 'S', 'T', 'T', 'R', 'A', 'C', 'E' };
+static const uint32_t TRACE_VERSION = 1;
+static const size_t TRACE_HEADER_SIZE = 14;
+
+/**
+* One decoded trace record. key and value are only meaningful for the
+* ops that carry them, count only for TRACE_ADVANCE.
+*/
+template <typename Key, typename Value>
+struct TraceRecord
+{
+    TraceRecord() : op(TRACE_CLEAR), key(), value(), count(0) {}
+    TraceOp op;
+    Key key;
+    Value value;
+    uint32_t count;
+};
+
+/**
+* Appends records to a trace file. Each record is an op byte followed by
+* its WalCodec-encoded key and value, so an int map costs 9 bytes per
+* insert and 5 per find, and a whole scan costs 6. Records are buffered
+* and written bufferSize bytes at a time; failing to open or write the
+* file throws std::runtime_error.
+*/
+template <typename Key, typename Value>
+class TraceWriter
+{
+public:
+    explicit TraceWriter(const std::string& path, size_t bufferSize = 1 << 16);
+    ~TraceWriter(); // flushes
+
+    void insert(const Key& key, const Value& value);
+    void remove(const Key& key);
+    void find(const Key& key);
+    void begin();
+    void advance(); // one iterator increment
+    void clear();
+    void flush();
+    size_t records() const;
+
+protected:
+    // Add helper functions here
+    void startRecord(TraceOp op); // closes a pending advance run first
+    void endRun();                // writes the pending advance run, if any
+    void maybeFlush();
+
+protected:
+    std::ofstream out_;
+    std::string buffer_;
+    size_t bufferSize_;
+    uint32_t pendingSteps_;
+    size_t records_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the TraceWriter class.
+  -------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+TraceWriter<Key, Value>::TraceWriter(const std::string& path, size_t bufferSize) :
+    out_(path.c_str(), std::ios::binary | std::ios::trunc), bufferSize_(bufferSize), pendingSteps_(0), records_(0)
+{
+    if(!out_)
+    {
+        throw std::runtime_error("cannot open trace " + path);
+    }
+    buffer_.reserve(bufferSize + 64);
+    buffer_.append(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    WalCodec<uint32_t>::encode(TRACE_VERSION, buffer_);
+    buffer_ += static_cast<char>(TraceTypeCode<Key>::CODE);
+    buffer_ += static_cast<char>(TraceTypeCode<Value>::CODE);
+}
+
+/**
+* Destructors must not throw, so a failed final write is dropped here;
+* call flush() first to see it.
+*/
+template<typename Key, typename Value>
+TraceWriter<Key, Value>::~TraceWriter()
+{
+    try
+    {
+        flush();
+    }
+    catch(std::exception&)
+    {
+
+    }
+}
+
+template<typename Key, typename Value>
+void TraceWriter<Key, Value>::insert(const Key& key, const Value& value)
+{
+    startRecord(TRACE_INSERT);
+    WalCodec<Key>::encode(key, buffer_);
+    WalCodec<Value>::encode(value, buffer_);
+    maybeFlush();
+}
+
+template<typename Key, typename Value>
+void TraceWriter<Key, Value>::remove(const Key& key)
+{
+    startRecord(TRACE_REMOVE);
+    WalCodec<Key>::encode(key, buffer_);
+    maybeFlush();
+}
+
+template<typename Key, typename Value>
+void TraceWriter<Key, Value>::find(const Key& key)
+{
+    startRecord(TRACE_FIND);
+    WalCodec<Key>::encode(key, buffer_);
+    maybeFlush();
+}
+
+template<typename Key, typename Value>
+void TraceWriter<Key, Value>::begin()
+{
+    startRecord(TRACE_BEGIN);
+    maybeFlush();
+}
+
+/**
+* Only counted here; the run is written when the next other record (or a
+* flush) ends it.
+*/
+template<typename Key, typename Value>
+void TraceWriter<Key, Value>::advance()
+{
+    if(pendingSteps_ == 0)
+    {
+        records_++;
+    }
+    pendingSteps_++;
+    if(pendingSteps_ == UINT32_MAX)
+    {
+        endRun();
+    }
+}
+
+template<typename Key, typename Value>
+void TraceWriter<Key, Value>::clear()
+{
+    startRecord(TRACE_CLEAR);
+    maybeFlush();
+}
+
+template<typename Key, typename Value>
+void TraceWriter<Key, Value>::flush()
+{
+    endRun();
+    if(!buffer_.empty())
+    {
+        out_.write(buffer_.data(), buffer_.size());
+        buffer_.clear();
+    }
+    out_.flush();
+    if(!out_)
+    {
+        throw std::runtime_error("trace write failed");
+    }
+}
+
+template<typename Key, typename Value>
+size_t TraceWriter<Key, Value>::records() const
+{
+    return records_;
+}
+
+template<typename Key, typename Value>
+void TraceWriter<Key, Value>::startRecord(TraceOp op)
+{
+    endRun();
+    buffer_ += static_cast<char>(op);
+    records_++;
+}
+
+template<typename Key, typename Value>
+void TraceWriter<Key, Value>::endRun()
+{
+    if(pendingSteps_ != 0)
+    {
+        buffer_ += static_cast<char>(TRACE_ADVANCE);
+        WalCodec<uint32_t>::encode(pendingSteps_, buffer_);
+        pendingSteps_ = 0;
+    }
+}
+
+template<typename Key, typename Value>
+void TraceWriter<Key, Value>::maybeFlush()
+{
+    if(buffer_.size() >= bufferSize_)
+    {
+        out_.write(buffer_.data(), buffer_.size());
+        buffer_.clear();
+        if(!out_)
+        {
+            throw std::runtime_error("trace write failed");
+        }
+    }
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the TraceWriter class.
+  -----------------------------------------------
+*/
+
+/**
+* Reads the key and value type codes from a trace header. Throws
+* std::runtime_error if the file cannot be read or is not a trace.
+*/
+inline void readTraceHeader(std::istream& in, uint8_t& keyCode, uint8_t& valueCode)
+{
+    char header[TRACE_HEADER_SIZE];
+    const char* pos = header;
+    uint32_t version = 0;
+    if(!in.read(header, sizeof(header)) || std::memcmp(header, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0)
+    {
+        throw std::runtime_error("not a tree trace");
+    }
+    pos += sizeof(TRACE_MAGIC);
+    WalCodec<uint32_t>::decode(pos, header + sizeof(header), version);
+    if(version != TRACE_VERSION)
+    {
+        throw std::runtime_error("unsupported trace version");
+    }
+    keyCode = static_cast<uint8_t>(header[12]);
+    valueCode = static_cast<uint8_t>(header[13]);
+}
+
+/**
+* Loads a whole trace into records, so that decoding stays out of the
+* replay timings. Throws std::runtime_error if the file is not a trace of
+* these types. A record cut short at the end (a writer that died before
+* flushing) ends the trace; the function returns false in that case.
+*/
+template <typename Key, typename Value>
+bool readTrace(const std::string& path, std::vector<TraceRecord<Key, Value> >& records)
+{
+    std::ifstream in(path.c_str(), std::ios::binary);
+    if(!in)
+    {
+        throw std::runtime_error("cannot open trace " + path);
+    }
+    uint8_t keyCode, valueCode;
+    readTraceHeader(in, keyCode, valueCode);
+    if(keyCode != TraceTypeCode<Key>::CODE || valueCode != TraceTypeCode<Value>::CODE)
+    {
+        throw std::runtime_error("trace was written with other key or value types");
+    }
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    records.clear();
+    const char* pos = data.data();
+    const char* end = pos + data.size();
+    while(pos < end)
+    {
+        TraceRecord<Key, Value> record;
+        int op = static_cast<unsigned char>(*pos++);
+        bool ok = true;
+        switch(op)
+        {
+        case TRACE_INSERT:
+            ok = WalCodec<Key>::decode(pos, end, record.key) && WalCodec<Value>::decode(pos, end, record.value);
+            break;
+        case TRACE_REMOVE:
+        case TRACE_FIND:
+            ok = WalCodec<Key>::decode(pos, end, record.key);
+            break;
+        case TRACE_ADVANCE:
+            ok = WalCodec<uint32_t>::decode(pos, end, record.count);
+            break;
+        case TRACE_BEGIN:
+        case TRACE_CLEAR:
+            break;
+        default:
+            throw std::runtime_error("corrupt trace record");
+        }
+        if(!ok)
+        {
+            return false;
+        }
+        record.op = static_cast<TraceOp>(op);
+        records.push_back(record);
+    }
+    return true;
+}
+
+/**
+* A tree whose insert, remove, clear, find, begin and iterator increments
+* are forwarded to a Tree (AVLTree by default, or any BinarySearchTree)
+* and recorded to a trace file. tree() gives untraced access, e.g. for
+* setup that should not be part of the workload.
+*/
+template <typename Key, typename Value, typename Tree = AVLTree<Key, Value> >
+class TracedTree
+{
+public:
+    class iterator
+    {
+    public:
+        iterator() : trace_(nullptr) {}
+
+        std::pair<const Key, Value>& operator*() const { return *it_; }
+        std::pair<const Key, Value>* operator->() const { return &*it_; }
+
+        bool operator==(const iterator& rhs) const { return it_ == rhs.it_; }
+        bool operator!=(const iterator& rhs) const { return it_ != rhs.it_; }
+
+        iterator& operator++()
+        {
+            trace_->advance();
+            ++it_;
+            return *this;
+        }
+
+    protected:
+        friend class TracedTree<Key, Value, Tree>;
+        iterator(const typename Tree::iterator& it, TraceWriter<Key, Value>* trace) : it_(it), trace_(trace) {}
+        typename Tree::iterator it_;
+        TraceWriter<Key, Value>* trace_;
+    };
+
+    explicit TracedTree(const std::string& tracePath);
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    iterator find(const Key& key);
+    iterator begin();
+    iterator end();
+    bool empty() const;
+
+    Tree& tree();
+    TraceWriter<Key, Value>& trace();
+
+protected:
+    Tree tree_;
+    TraceWriter<Key, Value> trace_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the TracedTree class.
+  -------------------------------------------------
+*/
+
+template<typename Key, typename Value, typename Tree>
+TracedTree<Key, Value, Tree>::TracedTree(const std::string& tracePath) : trace_(tracePath)
+{
+
+}
+
+template<typename Key, typename Value, typename Tree>
+void TracedTree<Key, Value, Tree>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    trace_.insert(keyValuePair.first, keyValuePair.second);
+    tree_.insert(keyValuePair);
+}
+
+template<typename Key, typename Value, typename Tree>
+void TracedTree<Key, Value, Tree>::remove(const Key& key)
+{
+    trace_.remove(key);
+    tree_.remove(key);
+}
+
+template<typename Key, typename Value, typename Tree>
+void TracedTree<Key, Value, Tree>::clear()
+{
+    trace_.clear();
+    tree_.clear();
+}
+
+template<typename Key, typename Value, typename Tree>
+typename TracedTree<Key, Value, Tree>::iterator TracedTree<Key, Value, Tree>::find(const Key& key)
+{
+    trace_.find(key);
+    return iterator(tree_.find(key), &trace_);
+}
+
+template<typename Key, typename Value, typename Tree>
+typename TracedTree<Key, Value, Tree>::iterator TracedTree<Key, Value, Tree>::begin()
+{
+    trace_.begin();
+    return iterator(tree_.begin(), &trace_);
+}
+
+/**
+* Not recorded, comparing against end() has no cost worth replaying.
+*/
+template<typename Key, typename Value, typename Tree>
+typename TracedTree<Key, Value, Tree>::iterator TracedTree<Key, Value, Tree>::end()
+{
+    return iterator(tree_.end(), &trace_);
+}
+
+template<typename Key, typename Value, typename Tree>
+bool TracedTree<Key, Value, Tree>::empty() const
+{
+    return tree_.empty();
+}
+
+template<typename Key, typename Value, typename Tree>
+Tree& TracedTree<Key, Value, Tree>::tree()
+{
+    return tree_;
+}
+
+template<typename Key, typename Value, typename Tree>
+TraceWriter<Key, Value>& TracedTree<Key, Value, Tree>::trace()
+{
+    return trace_;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the TracedTree class.
+  -----------------------------------------------
+*/
+
+/**
+* Latency distribution of one kind of record, in nanoseconds.
+*/
+struct TraceLatency
+{
+    TraceLatency() : count(0), p50(0), p90(0), p99(0), p999(0), max(0) {}
+    size_t count;
+    double p50, p90, p99, p999, max;
+};
+
+/**
+* What replayTrace measured. perOp is indexed by TraceOp; all covers
+* every record. findHits and steps depend only on the trace, so they must
+* agree between containers and serve as a check on the replay.
+*/
+struct TraceReplayStats
+{
+    TraceReplayStats() : records(0), totalMs(0), findHits(0), steps(0) {}
+    size_t records;
+    double totalMs;
+    size_t findHits;
+    size_t steps; // iterator increments actually taken
+    TraceLatency perOp[TRACE_OP_END];
+    TraceLatency all;
+};
+
+// The write calls differ between the trees and std::map, the rest is shared.
+template <typename Key, typename Value>
+void traceInsert(BinarySearchTree<Key, Value>& tree, const Key& key, const Value& value)
+{
+    tree.insert(std::make_pair(key, value));
+}
+
+template <typename Key, typename Value>
+void traceRemove(BinarySearchTree<Key, Value>& tree, const Key& key)
+{
+    tree.remove(key);
+}
+
+template <typename Key, typename Value, typename Compare, typename Alloc>
+void traceInsert(std::map<Key, Value, Compare, Alloc>& map, const Key& key, const Value& value)
+{
+    map[key] = value;
+}
+
+template <typename Key, typename Value, typename Compare, typename Alloc>
+void traceRemove(std::map<Key, Value, Compare, Alloc>& map, const Key& key)
+{
+    map.erase(key);
+}
+
+/**
+* Fills latency from the durations in ns, which it sorts.
+*/
+inline void traceLatency(std::vector<uint32_t>& ns, TraceLatency& latency)
+{
+    latency.count = ns.size();
+    if(ns.empty())
+    {
+        return;
+    }
+    std::sort(ns.begin(), ns.end());
+    latency.p50 = ns[ns.size() * 50 / 100];
+    latency.p90 = ns[ns.size() * 90 / 100];
+    latency.p99 = ns[ns.size() * 99 / 100];
+    latency.p999 = ns[ns.size() * 999 / 1000];
+    latency.max = ns.back();
+}
+
+/**
+* Re-executes records against map, which may be any BinarySearchTree or a
+* std::map with the same key and value types, timing every record on the
+* steady clock. The trace's cursor is a live iterator: TRACE_BEGIN and
+* TRACE_FIND set it and TRACE_ADVANCE steps it (stopping at end()), just
+* as the recorded program did.
+*/
+template <typename Map, typename Key, typename Value>
+TraceReplayStats replayTrace(const std::vector<TraceRecord<Key, Value> >& records, Map& map)
+{
+    typedef std::chrono::steady_clock Clock;
+    TraceReplayStats stats;
+    std::vector<std::vector<uint32_t> > perOp(TRACE_OP_END);
+    std::vector<uint32_t> all;
+    all.reserve(records.size());
+    typename Map::iterator cursor = map.end();
+
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < records.size(); i++)
+    {
+        const TraceRecord<Key, Value>& record = records[i];
+        Clock::time_point opStart = Clock::now();
+        switch(record.op)
+        {
+        case TRACE_INSERT:
+            traceInsert(map, record.key, record.value);
+            break;
+        case TRACE_REMOVE:
+            if(cursor != map.end() && !(cursor->first < record.key) && !(record.key < cursor->first))
+            {
+                cursor = map.end(); // its node is about to be freed
+            }
+            traceRemove(map, record.key);
+            break;
+        case TRACE_FIND:
+            cursor = map.find(record.key);
+            if(cursor != map.end())
+            {
+                stats.findHits++;
+            }
+            break;
+        case TRACE_BEGIN:
+            cursor = map.begin();
+            break;
+        case TRACE_ADVANCE:
+            for(uint32_t step = 0; step < record.count && cursor != map.end(); step++)
+            {
+                ++cursor;
+                stats.steps++;
+            }
+            break;
+        case TRACE_CLEAR:
+            map.clear();
+            cursor = map.end();
+            break;
+        default:
+            break;
+        }
+        uint32_t ns = static_cast<uint32_t>(std::min<long long>(UINT32_MAX,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - opStart).count()));
+        perOp[record.op].push_back(ns);
+        all.push_back(ns);
+    }
+    stats.totalMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    stats.records = records.size();
+
+    for(int op = 0; op < TRACE_OP_END; op++)
+    {
+        traceLatency(perOp[op], stats.perOp[op]);
+    }
+    traceLatency(all, stats.all);
+    return stats;
+}
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef WAL_CODEC_H
+#define WAL_CODEC_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+/**
+* How a key or value is written into a binary record, shared by the
+* write-ahead log and workload traces. The default copies the bytes of a
+* trivially copyable type; other types need a specialization, as
+* std::string has below. decode() returns false if the record is too
+* short, which replay treats as a torn write.
+*/
+template <typename T>
+struct WalCodec
+{
+    static_assert(std::is_trivially_copyable<T>::value, "WalCodec needs a specialization for this type");
+
+    static void encode(const T& item, std::string& out)
+    {
+        out.append(reinterpret_cast<const char*>(&item), sizeof(T));
+    }
+
+    static bool decode(const char*& pos, const char* end, T& item)
+    {
+        if(static_cast<size_t>(end - pos) < sizeof(T))
+        {
+            return false;
+        }
+        std::memcpy(&item, pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+};
+
+// Length prefixed.
+template <>
+struct WalCodec<std::string>
+{
+    static void encode(const std::string& item, std::string& out)
+    {
+        WalCodec<uint32_t>::encode(static_cast<uint32_t>(item.size()), out);
+        out.append(item);
+    }
+
+    static bool decode(const char*& pos, const char* end, std::string& item)
+    {
+        uint32_t length;
+        if(!WalCodec<uint32_t>::decode(pos, end, length) || static_cast<size_t>(end - pos) < length)
+        {
+            return false;
+        }
+        item.assign(pos, length);
+        pos += length;
+        return true;
+    }
+};
+
+#endif